@@ -0,0 +1,54 @@
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+using namespace std;
+
+// Bump allocator for the temporaries of one evaluation. Individual
+// deallocation is a no-op; reset() releases everything at once in O(1)
+// and keeps the blocks for reuse, so a warmed-up arena does not touch
+// the global heap.
+class Arena {
+  struct Block {
+    unique_ptr<char[]> mem;
+    size_t size;
+  };
+  static const size_t blockSize = 1 << 16;
+  vector<Block> blocks;
+  size_t cur = 0, used = 0;
+public:
+  Arena() {}
+  Arena(const Arena &) = delete;
+  Arena &operator=(const Arena &) = delete;
+
+  void *allocate(size_t n, size_t align) {
+    for(;;) {
+      if (cur < blocks.size()) {
+	size_t p = (used + align - 1) & ~(align - 1);
+	if (p + n <= blocks[cur].size) { used = p + n; return blocks[cur].mem.get() + p; }
+	cur++;
+	used = 0;
+	continue;
+      }
+      size_t s = n + align > blockSize ? n + align : blockSize;
+      blocks.push_back(Block { unique_ptr<char[]>(new char[s]), s });
+    }
+  }
+
+  void reset() { cur = 0; used = 0; }
+};
+
+template<typename T>
+struct ArenaAllocator {
+  typedef T value_type;
+  Arena *arena;
+
+  explicit ArenaAllocator(Arena &a) : arena(&a) {}
+  template<typename U> ArenaAllocator(const ArenaAllocator<U> &a) : arena(a.arena) {}
+
+  T *allocate(size_t n) { return static_cast<T *>(arena->allocate(n * sizeof(T), alignof(T))); }
+  void deallocate(T *, size_t) {}
+
+  template<typename U> bool operator==(const ArenaAllocator<U> &a) const { return arena == a.arena; }
+  template<typename U> bool operator!=(const ArenaAllocator<U> &a) const { return arena != a.arena; }
+};
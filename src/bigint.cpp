@@ -0,0 +1,595 @@
+#include <algorithm>
+#include <stdexcept>
+
+#include "modarith.hpp"
+#include "bigint.hpp"
+
+namespace {
+  // Operands shorter than this many limbs are multiplied by the schoolbook method
+  const size_t karatsubaThreshold = 32;
+
+  // Numbers shorter than this many limbs are converted to decimal by repeated
+  // division by 10^19, and longer ones are split by powers of 10^19 first
+  const size_t decimalThreshold = 32;
+
+  // Divisors shorter than this many limbs are divided by Knuth's algorithm D,
+  // and longer ones by the recursive method
+  const size_t divThreshold = 2 * karatsubaThreshold;
+
+  const uint64_t pow10_19 = 10000000000000000000ULL;
+
+  // (u1 * 2^64 + u0) / v for u1 < v, leaving the remainder in r
+  uint64_t divlu(uint64_t u1, uint64_t u0, uint64_t v, uint64_t &r) {
+#if defined(__SIZEOF_INT128__)
+    unsigned __int128 u = ((unsigned __int128)u1 << 64) | u0;
+    r = uint64_t(u % v);
+    return uint64_t(u / v);
+#else
+    // Hacker's Delight, divlu with 32-bit digits
+    const uint64_t b = uint64_t(1) << 32;
+    int s = U128::clz64(v);
+    v <<= s;
+    uint64_t vn1 = v >> 32, vn0 = v & 0xffffffff;
+    uint64_t un32 = s == 0 ? u1 : (u1 << s) | (u0 >> (64 - s)), un10 = u0 << s;
+    uint64_t un1 = un10 >> 32, un0 = un10 & 0xffffffff;
+    uint64_t q1 = un32 / vn1, rhat = un32 - q1 * vn1;
+    while(q1 >= b || q1 * vn0 > b * rhat + un1) { q1--; rhat += vn1; if (rhat >= b) break; }
+    uint64_t un21 = un32 * b + un1 - q1 * v;
+    uint64_t q0 = un21 / vn1;
+    rhat = un21 - q0 * vn1;
+    while(q0 >= b || q0 * vn0 > b * rhat + un0) { q0--; rhat += vn1; if (rhat >= b) break; }
+    r = (un21 * b + un0 - q0 * v) >> s;
+    return q1 * b + q0;
+#endif
+  }
+
+  // r[0, na + nb) = a * b, where r does not overlap the operands
+  void mulSchool(uint64_t *r, const uint64_t *a, size_t na, const uint64_t *b, size_t nb) {
+    fill(r, r + na + nb, 0);
+    for(size_t i=0;i<na;i++) {
+      uint64_t c = 0;
+      for(size_t j=0;j<nb;j++) {
+	U128 p = mul64(a[i], b[j]);
+	p.lo += r[i + j]; p.hi += p.lo < r[i + j];
+	p.lo += c; p.hi += p.lo < c;
+	r[i + j] = p.lo;
+	c = p.hi;
+      }
+      r[i + nb] = c;
+    }
+  }
+
+  // r[0, n) += a[0, na), returning the carry out of r[n-1]
+  uint64_t addInto(uint64_t *r, size_t n, const uint64_t *a, size_t na) {
+    uint64_t c = 0;
+    size_t i = 0;
+    for(;i<na;i++) {
+      uint64_t s = r[i] + a[i];
+      uint64_t c1 = s < a[i];
+      r[i] = s + c;
+      c = c1 + (r[i] < c);
+    }
+    for(;c && i<n;i++) { r[i]++; c = r[i] == 0; }
+    return c;
+  }
+
+  // r[0, n) -= a[0, na), where the result is not negative
+  void subInto(uint64_t *r, size_t n, const uint64_t *a, size_t na) {
+    uint64_t b = 0;
+    size_t i = 0;
+    for(;i<na;i++) {
+      uint64_t d = r[i] - a[i];
+      uint64_t b1 = r[i] < a[i];
+      r[i] = d - b;
+      b = b1 + (d < b);
+    }
+    for(;b && i<n;i++) { b = r[i] == 0; r[i]--; }
+  }
+
+  void mulKaratsuba(uint64_t *r, const uint64_t *a, size_t na, const uint64_t *b, size_t nb) {
+    if (na < nb) { swap(a, b); swap(na, nb); }
+    if (nb < karatsubaThreshold) { mulSchool(r, a, na, b, nb); return; }
+
+    if (2 * nb <= na) {
+      // Unbalanced operands are multiplied in pieces of the length of the shorter one
+      fill(r, r + na + nb, 0);
+      vector<uint64_t> t(2 * nb);
+      for(size_t off=0;off<na;off+=nb) {
+	size_t len = min(nb, na - off);
+	mulKaratsuba(t.data(), a + off, len, b, nb);
+	addInto(r + off, na + nb - off, t.data(), len + nb);
+      }
+      return;
+    }
+
+    // a = a1 B^h + a0, b = b1 B^h + b0, and
+    // a b = a1 b1 B^2h + ((a0 + a1)(b0 + b1) - a0 b0 - a1 b1) B^h + a0 b0
+    const size_t h = na / 2, na1 = na - h, nb1 = nb - h;
+    mulKaratsuba(r, a, h, b, h);
+    mulKaratsuba(r + 2 * h, a + h, na1, b + h, nb1);
+
+    const size_t ns = na1 + 1;
+    vector<uint64_t> sa(ns), sb(ns), z1(2 * ns);
+    copy(a + h, a + na, sa.begin());
+    sa[ns - 1] = addInto(sa.data(), ns - 1, a, h);
+    copy(b + h, b + nb, sb.begin());
+    sb[ns - 1] = addInto(sb.data(), ns - 1, b, h);
+    mulKaratsuba(z1.data(), sa.data(), ns, sb.data(), ns);
+    subInto(z1.data(), z1.size(), r, 2 * h);
+    subInto(z1.data(), z1.size(), r + 2 * h, na1 + nb1);
+
+    size_t nz = z1.size();
+    while(nz > 0 && z1[nz - 1] == 0) nz--;
+    addInto(r + h, na + nb - h, z1.data(), nz);
+  }
+
+  void trimMag(vector<uint64_t> &a) { while(!a.empty() && a.back() == 0) a.pop_back(); }
+
+  // The limbs [b, e) of a, as a number
+  vector<uint64_t> limbRange(const vector<uint64_t> &a, size_t b, size_t e) {
+    vector<uint64_t> r;
+    if (b < a.size()) r.assign(a.begin() + b, a.begin() + min(e, a.size()));
+    trimMag(r);
+    return r;
+  }
+
+  // hi B^n + lo, for lo < B^n
+  vector<uint64_t> joinLimbs(const vector<uint64_t> &hi, const vector<uint64_t> &lo, size_t n) {
+    if (hi.empty()) return lo;
+    vector<uint64_t> r(n + hi.size(), 0);
+    copy(lo.begin(), lo.end(), r.begin());
+    copy(hi.begin(), hi.end(), r.begin() + n);
+    return r;
+  }
+
+  int digitValue(char c) {
+    if ('0' <= c && c <= '9') return c - '0';
+    if ('a' <= c && c <= 'f') return c - 'a' + 10;
+    if ('A' <= c && c <= 'F') return c - 'A' + 10;
+    return 99;
+  }
+}
+
+void BigInt::trim() {
+  while(!mag.empty() && mag.back() == 0) mag.pop_back();
+  if (mag.empty()) neg = false;
+}
+
+BigInt::BigInt(int64_t v) {
+  if (v != 0) mag.push_back(v < 0 ? 0 - uint64_t(v) : uint64_t(v));
+  neg = v < 0;
+}
+
+BigInt BigInt::fromLimbs(const vector<uint64_t> &limbs, bool negative) {
+  BigInt r;
+  r.mag = limbs;
+  r.neg = negative;
+  r.trim();
+  return r;
+}
+
+size_t BigInt::bitLength() const {
+  return mag.empty() ? 0 : mag.size() * 64 - U128::clz64(mag.back());
+}
+
+bool BigInt::toInt64(int64_t &v) const {
+  if (mag.size() > 1 || (mag.size() == 1 && mag[0] > (neg ? uint64_t(1) << 63 : (uint64_t(1) << 63) - 1))) return false;
+  uint64_t u = mag.empty() ? 0 : mag[0];
+  v = neg ? int64_t(0 - u) : int64_t(u);
+  return true;
+}
+
+int BigInt::cmpMag(const vector<uint64_t> &a, const vector<uint64_t> &b) {
+  if (a.size() != b.size()) return a.size() < b.size() ? -1 : 1;
+  for(size_t i=a.size();i-- > 0;) if (a[i] != b[i]) return a[i] < b[i] ? -1 : 1;
+  return 0;
+}
+
+int BigInt::compare(const BigInt &o) const {
+  if (neg != o.neg) return neg ? -1 : 1;
+  int c = cmpMag(mag, o.mag);
+  return neg ? -c : c;
+}
+
+vector<uint64_t> BigInt::addMag(const vector<uint64_t> &a, const vector<uint64_t> &b) {
+  const vector<uint64_t> &l = a.size() >= b.size() ? a : b, &s = a.size() >= b.size() ? b : a;
+  vector<uint64_t> r(l.size() + 1);
+  copy(l.begin(), l.end(), r.begin());
+  addInto(r.data(), r.size(), s.data(), s.size());
+  return r;
+}
+
+vector<uint64_t> BigInt::subMag(const vector<uint64_t> &a, const vector<uint64_t> &b) {
+  vector<uint64_t> r = a;
+  subInto(r.data(), r.size(), b.data(), b.size());
+  return r;
+}
+
+vector<uint64_t> BigInt::mulMag(const vector<uint64_t> &a, const vector<uint64_t> &b) {
+  if (a.empty() || b.empty()) return vector<uint64_t>();
+  vector<uint64_t> r(a.size() + b.size());
+  mulKaratsuba(r.data(), a.data(), a.size(), b.data(), b.size());
+  return r;
+}
+
+// Divisors of divThreshold limbs or more are padded to m = j 2^k limbs
+// with j < divThreshold, and shifted so that their top bit is set. The
+// dividend, shifted alike, is divided by blocks of m limbs from the top,
+// each step dividing 2m limbs by m with div2n1n.
+void BigInt::divModMag(const vector<uint64_t> &a, const vector<uint64_t> &b, vector<uint64_t> &q, vector<uint64_t> &r) {
+  if (cmpMag(a, b) < 0) { q.clear(); r = a; return; }
+  const size_t n = b.size();
+  if (n < divThreshold) { divKnuth(a, b, q, r); return; }
+
+  int k = 0;
+  while((n >> k) >= divThreshold) k++;
+  const size_t m = ((n + (size_t(1) << k) - 1) >> k) << k;
+  const size_t shift = (m - n) * 64 + U128::clz64(b.back());
+  const vector<uint64_t> bn = (fromLimbs(b, false) << shift).mag, an = (fromLimbs(a, false) << shift).mag;
+
+  // The top block of t is below B^(m-1), and so below bn
+  const size_t t = an.size() / m + 1;
+  vector<uint64_t> z = limbRange(an, (t - 2) * m, t * m), qi, ri;
+  q.assign((t - 1) * m, 0);
+  for(size_t i=t-1;i-- > 0;) {
+    div2n1n(z, bn, m, qi, ri);
+    copy(qi.begin(), qi.end(), q.begin() + i * m);
+    if (i > 0) z = joinLimbs(ri, limbRange(an, (i - 1) * m, i * m), m);
+  }
+  r = (fromLimbs(ri, false) >> shift).mag;
+}
+
+// a < b B^n divided by b of n limbs with its top bit set. Halves of odd or
+// small sizes are divided by Knuth's algorithm D.
+void BigInt::div2n1n(const vector<uint64_t> &a, const vector<uint64_t> &b, size_t n, vector<uint64_t> &q, vector<uint64_t> &r) {
+  if (n % 2 != 0 || n < divThreshold) {
+    divKnuth(a, b, q, r);
+    trimMag(q);
+    trimMag(r);
+    return;
+  }
+  const size_t h = n / 2;
+  vector<uint64_t> q1, q2, r1;
+  div3n2n(limbRange(a, h, 4 * h), b, h, q1, r1);
+  div3n2n(joinLimbs(r1, limbRange(a, 0, h), h), b, h, q2, r);
+  q = joinLimbs(q1, q2, h);
+}
+
+// a < b B^h divided by b of 2h limbs with its top bit set, estimating the
+// quotient from the top halves, which is at most 2 too large
+void BigInt::div3n2n(const vector<uint64_t> &a, const vector<uint64_t> &b, size_t h, vector<uint64_t> &q, vector<uint64_t> &r) {
+  const vector<uint64_t> a12 = limbRange(a, h, 3 * h), a3 = limbRange(a, 0, h), b1 = limbRange(b, h, 2 * h), b2 = limbRange(b, 0, h);
+  vector<uint64_t> r1;
+  if (cmpMag(limbRange(a, 2 * h, 3 * h), b1) < 0) {
+    div2n1n(a12, b1, h, q, r1);
+  } else {
+    // The top half of a equals b1, the quotient is below B^h, and a12 - (B^h - 1) b1 = a12 + b1 - b1 B^h
+    q.assign(h, ~uint64_t(0));
+    r1 = subMag(addMag(a12, b1), joinLimbs(b1, vector<uint64_t>(), h));
+    trimMag(r1);
+  }
+  vector<uint64_t> d = mulMag(q, b2);
+  trimMag(d);
+  r = joinLimbs(r1, a3, h);
+  while(cmpMag(r, d) < 0) {
+    q = subMag(q, vector<uint64_t> { 1 });
+    trimMag(q);
+    r = addMag(r, b);
+    trimMag(r);
+  }
+  r = subMag(r, d);
+  trimMag(r);
+}
+
+// Knuth's algorithm D
+void BigInt::divKnuth(const vector<uint64_t> &a, const vector<uint64_t> &b, vector<uint64_t> &q, vector<uint64_t> &r) {
+  if (cmpMag(a, b) < 0) { q.clear(); r = a; return; }
+
+  const size_t n = b.size(), m = a.size() - n;
+  if (n == 1) {
+    q.assign(a.size(), 0);
+    uint64_t rem = 0;
+    for(size_t i=a.size();i-- > 0;) q[i] = divlu(rem, a[i], b[0], rem);
+    r.assign(1, rem);
+    return;
+  }
+
+  const int s = U128::clz64(b.back());
+  vector<uint64_t> v(n), u(a.size() + 1);
+  for(size_t i=n;i-- > 0;) v[i] = (b[i] << s) | (s != 0 && i > 0 ? b[i - 1] >> (64 - s) : 0);
+  u[a.size()] = s != 0 ? a.back() >> (64 - s) : 0;
+  for(size_t i=a.size();i-- > 0;) u[i] = (a[i] << s) | (s != 0 && i > 0 ? a[i - 1] >> (64 - s) : 0);
+
+  q.assign(m + 1, 0);
+  for(size_t j=m+1;j-- > 0;) {
+    uint64_t qhat, rhat;
+    bool rhatOverflow = false;
+    if (u[j + n] >= v[n - 1]) {
+      qhat = ~uint64_t(0);
+      rhat = u[j + n - 1] + v[n - 1];
+      rhatOverflow = rhat < v[n - 1];
+    } else {
+      qhat = divlu(u[j + n], u[j + n - 1], v[n - 1], rhat);
+    }
+    while(!rhatOverflow && U128(u[j + n - 2], rhat) < mul64(qhat, v[n - 2])) {
+      qhat--;
+      rhat += v[n - 1];
+      rhatOverflow = rhat < v[n - 1];
+    }
+
+    uint64_t carry = 0, borrow = 0;
+    for(size_t i=0;i<n;i++) {
+      U128 p = mul64(qhat, v[i]);
+      p.lo += carry; p.hi += p.lo < carry;
+      carry = p.hi;
+      uint64_t t = u[i + j] - p.lo, b1 = u[i + j] < p.lo;
+      u[i + j] = t - borrow;
+      borrow = b1 + (t < borrow);
+    }
+    uint64_t t = u[j + n] - carry, b1 = u[j + n] < carry;
+    u[j + n] = t - borrow;
+    if (b1 + (t < borrow)) {
+      qhat--;
+      u[j + n] += addInto(&u[j], n, v.data(), n);
+    }
+    q[j] = qhat;
+  }
+
+  r.assign(n, 0);
+  for(size_t i=0;i<n;i++) r[i] = (u[i] >> s) | (s != 0 ? u[i + 1] << (64 - s) : 0);
+}
+
+BigInt BigInt::operator-() const {
+  BigInt r = *this;
+  if (!r.mag.empty()) r.neg = !r.neg;
+  return r;
+}
+
+BigInt operator+(const BigInt &a, const BigInt &b) {
+  BigInt r;
+  if (a.neg == b.neg) {
+    r.mag = BigInt::addMag(a.mag, b.mag);
+    r.neg = a.neg;
+  } else if (BigInt::cmpMag(a.mag, b.mag) >= 0) {
+    r.mag = BigInt::subMag(a.mag, b.mag);
+    r.neg = a.neg;
+  } else {
+    r.mag = BigInt::subMag(b.mag, a.mag);
+    r.neg = b.neg;
+  }
+  r.trim();
+  return r;
+}
+
+BigInt operator-(const BigInt &a, const BigInt &b) { return a + -b; }
+
+BigInt operator*(const BigInt &a, const BigInt &b) {
+  BigInt r;
+  r.mag = BigInt::mulMag(a.mag, b.mag);
+  r.neg = a.neg != b.neg;
+  r.trim();
+  return r;
+}
+
+void BigInt::divMod(const BigInt &a, const BigInt &b, BigInt &q, BigInt &r) {
+  if (b.isZero()) throw(runtime_error("Division by zero"));
+  BigInt qq, rr;
+  divModMag(a.mag, b.mag, qq.mag, rr.mag);
+  qq.neg = a.neg != b.neg;
+  rr.neg = a.neg;
+  qq.trim();
+  rr.trim();
+  q = qq;
+  r = rr;
+}
+
+BigInt BigInt::operator<<(size_t s) const {
+  if (mag.empty()) return *this;
+  const size_t w = s / 64, b = s % 64;
+  BigInt r;
+  r.mag.assign(mag.size() + w + 1, 0);
+  for(size_t i=0;i<mag.size();i++) {
+    r.mag[i + w] |= mag[i] << b;
+    if (b != 0) r.mag[i + w + 1] = mag[i] >> (64 - b);
+  }
+  r.neg = neg;
+  r.trim();
+  return r;
+}
+
+// Rounds toward negative infinity, as an arithmetic shift on two's complement
+BigInt BigInt::operator>>(size_t s) const {
+  if (neg) return -((-*this - BigInt(1)) >> s) - BigInt(1);
+  const size_t w = s / 64, b = s % 64;
+  if (w >= mag.size()) return BigInt();
+  BigInt r;
+  r.mag.assign(mag.size() - w, 0);
+  for(size_t i=0;i<r.mag.size();i++) {
+    r.mag[i] = mag[i + w] >> b;
+    if (b != 0 && i + w + 1 < mag.size()) r.mag[i] |= mag[i + w + 1] << (64 - b);
+  }
+  r.trim();
+  return r;
+}
+
+vector<uint64_t> BigInt::toTwos(size_t n) const {
+  vector<uint64_t> t(n, 0);
+  copy(mag.begin(), mag.end(), t.begin());
+  if (neg) {
+    uint64_t c = 1;
+    for(auto &x : t) { x = ~x + c; c = c && x == 0; }
+  }
+  return t;
+}
+
+BigInt BigInt::fromTwos(vector<uint64_t> t) {
+  BigInt r;
+  r.neg = !t.empty() && (t.back() >> 63);
+  if (r.neg) {
+    uint64_t c = 1;
+    for(auto &x : t) { x = ~x + c; c = c && x == 0; }
+  }
+  r.mag = t;
+  r.trim();
+  return r;
+}
+
+BigInt BigInt::operator~() const { return -*this - BigInt(1); }
+
+BigInt operator&(const BigInt &a, const BigInt &b) {
+  const size_t n = max(a.mag.size(), b.mag.size()) + 1;
+  auto x = a.toTwos(n), y = b.toTwos(n);
+  for(size_t i=0;i<n;i++) x[i] &= y[i];
+  return BigInt::fromTwos(x);
+}
+
+BigInt operator|(const BigInt &a, const BigInt &b) {
+  const size_t n = max(a.mag.size(), b.mag.size()) + 1;
+  auto x = a.toTwos(n), y = b.toTwos(n);
+  for(size_t i=0;i<n;i++) x[i] |= y[i];
+  return BigInt::fromTwos(x);
+}
+
+BigInt operator^(const BigInt &a, const BigInt &b) {
+  const size_t n = max(a.mag.size(), b.mag.size()) + 1;
+  auto x = a.toTwos(n), y = b.toTwos(n);
+  for(size_t i=0;i<n;i++) x[i] ^= y[i];
+  return BigInt::fromTwos(x);
+}
+
+BigInt BigInt::gcd(BigInt a, BigInt b) {
+  a.neg = b.neg = false;
+  while(!b.isZero()) {
+    BigInt q, r;
+    divMod(a, b, q, r);
+    a = b;
+    b = r;
+  }
+  return a;
+}
+
+BigInt BigInt::pow(const BigInt &a, uint64_t e) {
+  BigInt r(1), x = a;
+  for(;e != 0;e >>= 1) {
+    if (e & 1) r = r * x;
+    if (e > 1) x = x * x;
+  }
+  return r;
+}
+
+// Product of the integers in [lo, hi), by splitting the range in halves so
+// that the operands of each multiplication have similar lengths
+BigInt BigInt::product(uint64_t lo, uint64_t hi) {
+  if (hi - lo <= 16) {
+    BigInt r(1);
+    uint64_t acc = 1;
+    for(uint64_t i=lo;i<hi;i++) {
+      U128 p = mul64(acc, i);
+      if (p.hi != 0) {
+	r = r * fromLimbs(vector<uint64_t>{ acc }, false);
+	acc = i;
+      } else {
+	acc = p.lo;
+      }
+    }
+    return r * fromLimbs(vector<uint64_t>{ acc }, false);
+  }
+  const uint64_t mid = lo + (hi - lo) / 2;
+  return product(lo, mid) * product(mid, hi);
+}
+
+BigInt BigInt::factorial(uint64_t n) { return n < 2 ? BigInt(1) : product(2, n + 1); }
+
+BigInt BigInt::binomial(uint64_t n, uint64_t k) {
+  if (k > n) return BigInt();
+  k = min(k, n - k);
+  if (k == 0) return BigInt(1);
+  BigInt q, r;
+  divMod(product(n - k + 1, n + 1), factorial(k), q, r);
+  return q;
+}
+
+bool BigInt::parse(string_view s, BigInt &r) {
+  bool negative = false;
+  if (!s.empty() && (s[0] == '-' || s[0] == '+')) { negative = s[0] == '-'; s.remove_prefix(1); }
+  if (s.empty()) return false;
+
+  if (s.size() > 2 && s[0] == '0' && (s[1] == 'x' || s[1] == 'X')) {
+    s.remove_prefix(2);
+    vector<uint64_t> limbs((s.size() + 15) / 16, 0);
+    for(size_t i=0;i<s.size();i++) {
+      int d = digitValue(s[s.size() - 1 - i]);
+      if (d >= 16) return false;
+      limbs[i / 16] |= uint64_t(d) << (i % 16 * 4);
+    }
+    r = fromLimbs(limbs, negative);
+    return true;
+  }
+
+  for(char c : s) if (digitValue(c) >= 10) return false;
+
+  // Chunks of 19 digits, combined pairwise with the powers 10^(19 2^i)
+  vector<BigInt> chunks;
+  for(size_t end = s.size();end > 0;) {
+    size_t begin = end >= 19 ? end - 19 : 0;
+    uint64_t v = 0;
+    for(size_t i=begin;i<end;i++) v = v * 10 + uint64_t(s[i] - '0');
+    chunks.push_back(fromLimbs(vector<uint64_t>{ v }, false));
+    end = begin;
+  }
+  BigInt p = fromLimbs(vector<uint64_t>{ pow10_19 }, false);
+  while(chunks.size() > 1) {
+    vector<BigInt> next;
+    for(size_t i=0;i<chunks.size();i+=2) next.push_back(i + 1 < chunks.size() ? chunks[i + 1] * p + chunks[i] : chunks[i]);
+    chunks.swap(next);
+    if (chunks.size() > 1) p = p * p;
+  }
+  r = chunks[0];
+  r.neg = negative && !r.isZero();
+  return true;
+}
+
+// Decimal digits of a non-negative number, zero-padded to width if width is not 0
+string BigInt::toDecimal(const vector<BigInt> &pow10, size_t level, size_t width) const {
+  if (mag.size() < decimalThreshold || level == 0) {
+    string s;
+    vector<uint64_t> x = mag;
+    while(!x.empty()) {
+      uint64_t rem = 0;
+      for(size_t i=x.size();i-- > 0;) x[i] = divlu(rem, x[i], pow10_19, rem);
+      while(!x.empty() && x.back() == 0) x.pop_back();
+      for(int i=0;i<19 && (rem != 0 || !x.empty());i++) { s += char('0' + rem % 10); rem /= 10; }
+    }
+    if (s.size() < width) s.append(width - s.size(), '0');
+    reverse(s.begin(), s.end());
+    return s;
+  }
+  // pow10[level - 1] = 10^(19 2^(level-1))
+  BigInt q, r;
+  divMod(*this, pow10[level - 1], q, r);
+  const size_t lw = size_t(19) << (level - 1);
+  if (width == 0 && q.isZero()) return r.toDecimal(pow10, level - 1, 0);
+  return q.toDecimal(pow10, level - 1, width == 0 ? 0 : width - lw) + r.toDecimal(pow10, level - 1, lw);
+}
+
+string BigInt::toString(int base) const {
+  string s;
+  if (base == 16) {
+    static const char hex[] = "0123456789abcdef";
+    for(size_t i=0;i<mag.size();i++) for(int j=0;j<16;j++) s += hex[(mag[i] >> (j * 4)) & 15];
+    while(s.size() > 1 && s.back() == '0') s.pop_back();
+    if (s.empty()) s = "0";
+    s += "x0";
+    if (neg) s += '-';
+    reverse(s.begin(), s.end());
+    return s;
+  }
+
+  if (mag.empty()) return "0";
+  vector<BigInt> pow10 { fromLimbs(vector<uint64_t>{ pow10_19 }, false) };
+  while(pow10.back().mag.size() * 2 <= mag.size()) pow10.push_back(pow10.back() * pow10.back());
+  BigInt a = *this;
+  a.neg = false;
+  s = a.toDecimal(pow10, pow10.size(), 0);
+  return neg ? "-" + s : s;
+}
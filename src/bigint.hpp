@@ -0,0 +1,79 @@
+#include <vector>
+#include <string>
+#include <string_view>
+#include <cstdint>
+
+using namespace std;
+
+// Arbitrary-size integer in sign-magnitude form. Multiplication switches
+// to Karatsuba above a threshold, and division to the recursive method of
+// Burnikel and Ziegler, whose cost is that of a few multiplications of the
+// size of the divisor per block of the quotient. Decimal conversion splits
+// the number by powers of 10^19 with it, so that large results convert in
+// subquadratic time.
+// Bitwise operations and right shifts behave as on infinite two's complement
+// numbers, like the ones on tlfloat_int128_t.
+class BigInt {
+  vector<uint64_t> mag;	// Magnitude, least significant limb first, without leading zero limbs
+  bool neg = false;
+
+  void trim();
+
+  static int cmpMag(const vector<uint64_t> &a, const vector<uint64_t> &b);
+  static vector<uint64_t> addMag(const vector<uint64_t> &a, const vector<uint64_t> &b);
+  static vector<uint64_t> subMag(const vector<uint64_t> &a, const vector<uint64_t> &b);
+  static vector<uint64_t> mulMag(const vector<uint64_t> &a, const vector<uint64_t> &b);
+  static void divModMag(const vector<uint64_t> &a, const vector<uint64_t> &b, vector<uint64_t> &q, vector<uint64_t> &r);
+  static void divKnuth(const vector<uint64_t> &a, const vector<uint64_t> &b, vector<uint64_t> &q, vector<uint64_t> &r);
+  static void div2n1n(const vector<uint64_t> &a, const vector<uint64_t> &b, size_t n, vector<uint64_t> &q, vector<uint64_t> &r);
+  static void div3n2n(const vector<uint64_t> &a, const vector<uint64_t> &b, size_t h, vector<uint64_t> &q, vector<uint64_t> &r);
+
+  static BigInt product(uint64_t lo, uint64_t hi);
+  string toDecimal(const vector<BigInt> &pow10, size_t level, size_t width) const;
+
+  vector<uint64_t> toTwos(size_t n) const;
+  static BigInt fromTwos(vector<uint64_t> t);
+
+public:
+  BigInt() {}
+  BigInt(int64_t v);
+  static BigInt fromLimbs(const vector<uint64_t> &limbs, bool negative);
+
+  // Parses an optionally signed decimal or "0x" hexadecimal integer, returning false on any other text
+  static bool parse(string_view s, BigInt &r);
+  string toString(int base = 10) const;
+
+  bool isZero() const { return mag.empty(); }
+  bool isNegative() const { return neg; }
+  size_t bitLength() const;
+  const vector<uint64_t> &limbs() const { return mag; }
+
+  // True if the value fits in a signed 64-bit integer, which is then stored in v
+  bool toInt64(int64_t &v) const;
+  // |x| < 2^127
+  bool fitsInt128() const { return bitLength() < 128; }
+
+  int compare(const BigInt &o) const;
+  bool operator==(const BigInt &o) const { return compare(o) == 0; }
+  bool operator!=(const BigInt &o) const { return compare(o) != 0; }
+  bool operator<(const BigInt &o) const { return compare(o) < 0; }
+
+  BigInt operator-() const;
+  BigInt operator~() const;
+  friend BigInt operator+(const BigInt &a, const BigInt &b);
+  friend BigInt operator-(const BigInt &a, const BigInt &b);
+  friend BigInt operator*(const BigInt &a, const BigInt &b);
+  friend BigInt operator&(const BigInt &a, const BigInt &b);
+  friend BigInt operator|(const BigInt &a, const BigInt &b);
+  friend BigInt operator^(const BigInt &a, const BigInt &b);
+  BigInt operator<<(size_t s) const;
+  BigInt operator>>(size_t s) const;
+
+  // Truncating division, so that the remainder has the sign of the dividend. b must not be zero.
+  static void divMod(const BigInt &a, const BigInt &b, BigInt &q, BigInt &r);
+
+  static BigInt gcd(BigInt a, BigInt b);
+  static BigInt pow(const BigInt &a, uint64_t e);
+  static BigInt factorial(uint64_t n);
+  static BigInt binomial(uint64_t n, uint64_t k);
+};
@@ -0,0 +1,176 @@
+#include <cstdint>
+#include <string>
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#include <cpuid.h>
+#include <immintrin.h>
+#define BITOPS_X86 1
+#define BITOPS_TARGET(t) __attribute__((target(t)))
+#elif defined(_MSC_VER) && defined(_M_X64) && !defined(__clang__)
+#include <intrin.h>
+#define BITOPS_X86 1
+#define BITOPS_TARGET(t)
+#endif
+
+#include "modarith.hpp"
+#include "bitops.hpp"
+
+namespace {
+  int popcount64(uint64_t u) {
+    u = u - ((u >> 1) & 0x5555555555555555ULL);
+    u = (u & 0x3333333333333333ULL) + ((u >> 2) & 0x3333333333333333ULL);
+    u = (u + (u >> 4)) & 0x0f0f0f0f0f0f0f0fULL;
+    return int((u * 0x0101010101010101ULL) >> 56);
+  }
+  int clz64(uint64_t u) {
+    if (u == 0) return 64;
+    int n = 0;
+    for(int s=32;s>0;s>>=1) if ((u >> (64 - s)) == 0) { n += s; u <<= s; }
+    return n;
+  }
+  int ctz64(uint64_t u) {
+    if (u == 0) return 64;
+    int n = 0;
+    for(int s=32;s>0;s>>=1) if ((u << (64 - s)) == 0) { n += s; u >>= s; }
+    return n;
+  }
+  // A bit at a time, from the lowest set bit of the mask
+  uint64_t pdep64(uint64_t x, uint64_t m) {
+    uint64_t r = 0;
+    for(uint64_t b = 1;m != 0;b <<= 1, m &= m - 1) if (x & b) r |= m & -m;
+    return r;
+  }
+  uint64_t pext64(uint64_t x, uint64_t m) {
+    uint64_t r = 0;
+    for(uint64_t b = 1;m != 0;b <<= 1, m &= m - 1) if (x & m & -m) r |= b;
+    return r;
+  }
+
+  uint64_t bswap64(uint64_t u) {
+    u = ((u & 0x00ff00ff00ff00ffULL) << 8) | ((u >> 8) & 0x00ff00ff00ff00ffULL);
+    u = ((u & 0x0000ffff0000ffffULL) << 16) | ((u >> 16) & 0x0000ffff0000ffffULL);
+    return (u << 32) | (u >> 32);
+  }
+  uint64_t reverse64(uint64_t u) {
+    u = ((u & 0x5555555555555555ULL) << 1) | ((u >> 1) & 0x5555555555555555ULL);
+    u = ((u & 0x3333333333333333ULL) << 2) | ((u >> 2) & 0x3333333333333333ULL);
+    u = ((u & 0x0f0f0f0f0f0f0f0fULL) << 4) | ((u >> 4) & 0x0f0f0f0f0f0f0f0fULL);
+    return bswap64(u);
+  }
+
+#if defined(BITOPS_X86)
+  BITOPS_TARGET("popcnt") int popcntInsn(uint64_t u) { return int(_mm_popcnt_u64(u)); }
+  BITOPS_TARGET("lzcnt") int lzcntInsn(uint64_t u) { return int(_lzcnt_u64(u)); }
+  BITOPS_TARGET("bmi") int tzcntInsn(uint64_t u) { return int(_tzcnt_u64(u)); }
+  BITOPS_TARGET("bmi2") uint64_t pdepInsn(uint64_t x, uint64_t m) { return _pdep_u64(x, m); }
+  BITOPS_TARGET("bmi2") uint64_t pextInsn(uint64_t x, uint64_t m) { return _pext_u64(x, m); }
+
+  void cpuid(unsigned leaf, unsigned r[4]) {
+#if defined(_MSC_VER)
+    int i[4];
+    __cpuidex(i, int(leaf), 0);
+    for(int k=0;k<4;k++) r[k] = unsigned(i[k]);
+#else
+    __cpuid_count(leaf, 0, r[0], r[1], r[2], r[3]);
+#endif
+  }
+#elif defined(__GNUC__)
+  int popcountBuiltin(uint64_t u) { return __builtin_popcountll(u); }
+  int clzBuiltin(uint64_t u) { return u == 0 ? 64 : __builtin_clzll(u); }
+  int ctzBuiltin(uint64_t u) { return u == 0 ? 64 : __builtin_ctzll(u); }
+#endif
+
+  // The 64-bit primitives the 128-bit operations are built on
+  struct Impl {
+    int (*popcount64)(uint64_t);
+    int (*clz64)(uint64_t);
+    int (*ctz64)(uint64_t);
+    uint64_t (*pdep64)(uint64_t, uint64_t);
+    uint64_t (*pext64)(uint64_t, uint64_t);
+    string features;
+  };
+
+  const Impl portableImpl = { popcount64, clz64, ctz64, pdep64, pext64, "" };
+
+  Impl select() {
+    Impl f = portableImpl;
+#if defined(BITOPS_X86)
+    unsigned r[4], r7[4] = { 0, 0, 0, 0 }, rx[4] = { 0, 0, 0, 0 };
+    cpuid(0, r);
+    const unsigned maxLeaf = r[0];
+    const bool amd = r[1] == 0x68747541;	// "Auth" of AuthenticAMD
+    cpuid(1, r);
+    unsigned family = (r[0] >> 8) & 0xf;
+    if (family == 0xf) family += (r[0] >> 20) & 0xff;
+    const bool popcnt = (r[2] >> 23) & 1;
+    if (maxLeaf >= 7) cpuid(7, r7);
+    cpuid(0x80000000, r);
+    if (r[0] >= 0x80000001) cpuid(0x80000001, rx);
+
+    if (popcnt) { f.popcount64 = popcntInsn; f.features += "popcnt "; }
+    if ((rx[2] >> 5) & 1) { f.clz64 = lzcntInsn; f.features += "lzcnt "; }
+    if ((r7[1] >> 3) & 1) { f.ctz64 = tzcntInsn; f.features += "bmi1 "; }
+    // PDEP and PEXT are microcoded before Zen 3, and slower than the loops
+    if (((r7[1] >> 8) & 1) && !(amd && family < 0x19)) {
+      f.pdep64 = pdepInsn;
+      f.pext64 = pextInsn;
+      f.features += "bmi2 ";
+    }
+    if (!f.features.empty()) f.features.pop_back();
+#elif defined(__GNUC__)
+    f.popcount64 = popcountBuiltin;
+    f.clz64 = clzBuiltin;
+    f.ctz64 = ctzBuiltin;
+    f.features = "builtin";
+#endif
+    return f;
+  }
+
+  const Impl &impl() {
+    static const Impl f = select();
+    return f;
+  }
+
+  int popcount(const Impl &f, const U128 &u) { return f.popcount64(u.lo) + f.popcount64(u.hi); }
+  int clz(const Impl &f, const U128 &u) { return u.hi != 0 ? f.clz64(u.hi) : 64 + f.clz64(u.lo); }
+  int ctz(const Impl &f, const U128 &u) { return u.lo != 0 ? f.ctz64(u.lo) : 64 + f.ctz64(u.hi); }
+
+  // The bits of u above those deposited in the low half go to the high half
+  U128 pdep(const Impl &f, const U128 &u, const U128 &m) {
+    return U128(f.pdep64(u.lo, m.lo), f.pdep64(u.shr(f.popcount64(m.lo)).lo, m.hi));
+  }
+  U128 pext(const Impl &f, const U128 &u, const U128 &m) {
+    const U128 h = U128(f.pext64(u.hi, m.hi)).shl(f.popcount64(m.lo));
+    return U128(f.pext64(u.lo, m.lo) | h.lo, h.hi);
+  }
+}
+
+namespace bitops {
+  int popcount(const U128 &u) { return ::popcount(impl(), u); }
+  int clz(const U128 &u) { return ::clz(impl(), u); }
+  int ctz(const U128 &u) { return ::ctz(impl(), u); }
+  int parity(const U128 &u) { return popcount(u) & 1; }
+  U128 bswap(const U128 &u) { return U128(bswap64(u.hi), bswap64(u.lo)); }
+  U128 bitreverse(const U128 &u) { return U128(reverse64(u.hi), reverse64(u.lo)); }
+
+  U128 rotl(const U128 &u, int n) {
+    n = ((n % 128) + 128) % 128;
+    if (n == 0) return u;
+    const U128 a = u.shl(n), b = u.shr(128 - n);
+    return U128(a.lo | b.lo, a.hi | b.hi);
+  }
+  U128 rotr(const U128 &u, int n) { return rotl(u, -(n % 128)); }
+
+  U128 pdep(const U128 &u, const U128 &mask) { return ::pdep(impl(), u, mask); }
+  U128 pext(const U128 &u, const U128 &mask) { return ::pext(impl(), u, mask); }
+
+  string features() { return impl().features; }
+
+  namespace portable {
+    int popcount(const U128 &u) { return ::popcount(portableImpl, u); }
+    int clz(const U128 &u) { return ::clz(portableImpl, u); }
+    int ctz(const U128 &u) { return ::ctz(portableImpl, u); }
+    U128 pdep(const U128 &u, const U128 &mask) { return ::pdep(portableImpl, u, mask); }
+    U128 pext(const U128 &u, const U128 &mask) { return ::pext(portableImpl, u, mask); }
+  }
+}
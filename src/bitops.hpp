@@ -0,0 +1,35 @@
+#include <cstdint>
+#include <string>
+
+using namespace std;
+
+struct U128;
+
+// Bit manipulation on 128-bit words. The operations that have an x86
+// instruction (POPCNT, LZCNT, TZCNT, PDEP and PEXT) use it if the CPU
+// running the program has it, which is checked on first use, and the
+// portable implementations otherwise.
+namespace bitops {
+  int popcount(const U128 &u);
+  int clz(const U128 &u);		// 128 for 0
+  int ctz(const U128 &u);		// 128 for 0
+  int parity(const U128 &u);
+  U128 bswap(const U128 &u);
+  U128 bitreverse(const U128 &u);
+  U128 rotl(const U128 &u, int n);	// n is taken modulo 128
+  U128 rotr(const U128 &u, int n);
+  U128 pdep(const U128 &u, const U128 &mask);
+  U128 pext(const U128 &u, const U128 &mask);
+
+  // The instructions in use, such as "popcnt lzcnt bmi1 bmi2", or "" if none
+  string features();
+
+  // The implementations in plain C++, which the accelerated ones must match bit for bit
+  namespace portable {
+    int popcount(const U128 &u);
+    int clz(const U128 &u);
+    int ctz(const U128 &u);
+    U128 pdep(const U128 &u, const U128 &mask);
+    U128 pext(const U128 &u, const U128 &mask);
+  }
+}
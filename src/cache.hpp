@@ -0,0 +1,104 @@
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <list>
+#include <unordered_map>
+#include <utility>
+
+#include <tlfloat/tlfloat.h>
+
+using namespace std;
+
+// LRU cache of the results of expressions, keyed on the normalized text.
+// Each assignment gives the variable a new version, and an entry records the
+// versions of the variables its expression read, so that it is only used
+// while none of them has been assigned since. The entries are evicted in
+// LRU order to stay within a budget of bytes; a budget of 0 disables the cache.
+class ResultCache {
+public:
+  typedef pair<string, tlfloat_octuple> Result;
+  typedef vector<pair<const tlfloat_octuple *, uint64_t>> Deps;
+
+  struct Stats {
+    uint64_t hits = 0, misses = 0, bypassed = 0, evictions = 0;
+    size_t entries = 0, bytes = 0, budget = 0;
+    double hitRate() const { return hits + misses == 0 ? 0 : double(hits) / double(hits + misses); }
+  };
+
+private:
+  struct Entry {
+    string key;
+    Deps deps;
+    Result result;
+    size_t bytes;
+  };
+
+  list<Entry> lru;	// Most recently used first
+  unordered_map<string_view, list<Entry>::iterator> index;	// Keys are views of Entry::key
+  unordered_map<const tlfloat_octuple *, uint64_t> versions;
+  uint64_t clock = 0;
+  Stats stats;
+
+  void erase(list<Entry>::iterator it) {
+    stats.bytes -= it->bytes;
+    index.erase(string_view(it->key));
+    lru.erase(it);
+    stats.entries--;
+  }
+
+public:
+  bool enabled() const { return stats.budget != 0; }
+
+  void setBudget(size_t bytes) {
+    stats.budget = bytes;
+    while(stats.bytes > stats.budget) { erase(prev(lru.end())); stats.evictions++; }
+    if (!enabled()) versions.clear();	// Versions are not kept up to date while disabled
+  }
+
+  uint64_t version(const tlfloat_octuple *var) const {
+    auto it = versions.find(var);
+    return it == versions.end() ? 0 : it->second;
+  }
+
+  // Called for each variable written
+  void touch(const tlfloat_octuple *var) { if (enabled()) versions[var] = ++clock; }
+
+  bool lookup(string_view key, Result &result) {
+    auto it = index.find(key);
+    if (it == index.end()) return false;
+    for(auto &d : it->second->deps) {
+      if (version(d.first) != d.second) { erase(it->second); return false; }
+    }
+    lru.splice(lru.begin(), lru, it->second);
+    result = lru.front().result;
+    stats.hits++;
+    return true;
+  }
+
+  // Records the result of an expression that was looked up and missed
+  void insert(string_view key, const Deps &deps, const Result &result) {
+    stats.misses++;
+    const size_t bytes = sizeof(Entry) + key.size() * 2 + result.first.size() + deps.size() * sizeof(deps[0]) + 64;
+    if (bytes > stats.budget) return;
+    auto it = index.find(key);
+    if (it != index.end()) erase(it->second);
+    while(stats.bytes + bytes > stats.budget) { erase(prev(lru.end())); stats.evictions++; }
+    lru.push_front(Entry { string(key), deps, result, bytes });
+    index[string_view(lru.front().key)] = lru.begin();
+    stats.bytes += bytes;
+    stats.entries++;
+  }
+
+  // Records an expression that cannot be cached, because it has side effects
+  void bypass() { stats.bypassed++; }
+
+  void clear() {
+    lru.clear();
+    index.clear();
+    versions.clear();
+    stats.entries = stats.bytes = 0;
+  }
+
+  const Stats &getStats() const { return stats; }
+};
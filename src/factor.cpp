@@ -0,0 +1,127 @@
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <algorithm>
+
+#include "modarith.hpp"
+#include "rng.hpp"
+#include "factor.hpp"
+#include "parallel.hpp"
+
+namespace {
+  // Trial division bound. Cofactors below its square are prime.
+  const uint32_t trialLimit = 1 << 16;
+
+  const vector<uint32_t> &smallPrimes() {
+    static const vector<uint32_t> primes = [] {
+      vector<bool> composite(trialLimit);
+      vector<uint32_t> v;
+      for(uint32_t i=2;i<trialLimit;i++) {
+	if (composite[i]) continue;
+	v.push_back(i);
+	for(uint32_t j=i*i;j<trialLimit;j+=i) composite[j] = true;
+      }
+      return v;
+    }();
+    return primes;
+  }
+
+  // Brent's variant of the rho method with f(y) = y^2 + c, in Montgomery form.
+  // The products of |x - y| are accumulated so that one GCD is taken per
+  // batch, and the batch is replayed one step at a time if the GCD
+  // overshoots to n. Returns false if the walk failed or was stopped.
+  bool brent(const Montgomery &mg, U128 y, const U128 &c, const atomic<bool> &stop, U128 &factor) {
+    const U128 &n = mg.modulus();
+    const uint64_t batch = 128;
+    auto f = [&](const U128 &v) { return mg.add(mg.mul(v, v), c); };
+
+    U128 x, ys, q = mg.one, g(1);
+    for(uint64_t r = 1;g == U128(1);r *= 2) {
+      x = y;
+      for(uint64_t i=0;i<r;i++) {
+	y = f(y);
+	if (i % 1024 == 1023 && stop) return false;
+      }
+      for(uint64_t k=0;k<r && g == U128(1);k += batch) {
+	if (stop) return false;
+	ys = y;
+	for(uint64_t i=0;i<batch && i<r-k;i++) {
+	  y = f(y);
+	  q = mg.mul(q, mg.sub(x, y));
+	}
+	g = gcd(q, n);
+      }
+    }
+
+    if (g == n) {
+      do {
+	ys = f(ys);
+	g = gcd(mg.sub(x, ys), n);
+      } while(g == U128(1));
+    }
+    if (g == n) return false;
+    factor = g;
+    return true;
+  }
+
+  // A non-trivial factor of the odd composite n. The first walk to succeed
+  // stops the others.
+  U128 findFactor(const U128 &n, int nthreads) {
+    const Montgomery mg(n);
+    atomic<bool> found(false);
+    mutex mtx;
+    U128 result;
+
+    auto worker = [&](size_t id) {
+      Xoshiro256 rng(uint64_t(id), n.lo ^ n.hi);
+      while(!found) {
+	U128 y = mod(U128(rng.next64(), rng.next64()), n), c = mod(U128(rng.next64(), rng.next64()), n), d;
+	if (c.isZero()) continue;
+	if (brent(mg, y, c, found, d)) {
+	  lock_guard<mutex> lock(mtx);
+	  if (!found) { result = d; found = true; }
+	}
+      }
+    };
+
+    parallel::parallelFor(size_t(nthreads), size_t(nthreads), worker);
+    return result;
+  }
+}
+
+vector<U128> factorize(const U128 &n, int nthreads) {
+  if (nthreads <= 0) nthreads = int(min<size_t>(8, parallel::threadCount(0)));
+
+  vector<U128> factors;
+  if (n < U128(2)) return factors;
+
+  U128 m = n;
+  for(uint32_t p : smallPrimes()) {
+    if (m < mul64(p, p)) break;
+    for(;;) {
+      uint32_t r;
+      U128 q = m.div32(p, r);
+      if (r != 0) break;
+      factors.push_back(U128(p));
+      m = q;
+    }
+  }
+
+  vector<U128> work;
+  if (m != U128(1)) work.push_back(m);
+  while(!work.empty()) {
+    U128 c = work.back();
+    work.pop_back();
+    if (c < mul64(trialLimit, trialLimit) || isprime(c)) {
+      factors.push_back(c);
+      continue;
+    }
+    U128 d = findFactor(c, nthreads), q, r;
+    divmod(c, d, q, r);
+    work.push_back(d);
+    work.push_back(q);
+  }
+
+  sort(factors.begin(), factors.end());
+  return factors;
+}
@@ -0,0 +1,10 @@
+#include <vector>
+
+using namespace std;
+
+struct U128;
+
+// Prime factors of n in ascending order, with multiplicity. Pollard-Brent
+// rho walks with different parameters are run on up to nthreads threads,
+// or on the hardware concurrency if nthreads is 0.
+vector<U128> factorize(const U128 &n, int nthreads = 0);
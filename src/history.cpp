@@ -0,0 +1,186 @@
+#include <stdexcept>
+#include <algorithm>
+
+#if defined(_WIN32)
+#include <windows.h>
+#endif
+
+#include "mappedfile.hpp"
+#include "history.hpp"
+
+using namespace octcore;
+
+namespace {
+  // Marks the start of each entry in the index, so that prefixes are n-grams that start with it
+  const char startMarker = '\x02';
+
+  uint32_t gram(const char *p, int n) {
+    uint32_t k = uint32_t(n) << 24;
+    for(int i=0;i<n;i++) k |= uint32_t((unsigned char)p[i]) << (8 * i);
+    return k;
+  }
+
+  FILE *openFile(const string &path, const char *mode) {
+#if defined(_WIN32)
+    int n = MultiByteToWideChar(CP_UTF8, 0, path.c_str(), -1, NULL, 0);
+    vector<wchar_t> wpath(n + 1), wmode;
+    MultiByteToWideChar(CP_UTF8, 0, path.c_str(), -1, wpath.data(), n);
+    for(const char *p = mode;*p;p++) wmode.push_back(wchar_t(*p));
+    wmode.push_back(0);
+    return _wfopen(wpath.data(), wmode.data());
+#else
+    return fopen(path.c_str(), mode);
+#endif
+  }
+}
+
+History::History() {}
+
+History::~History() {
+  if (log) fclose(log);
+}
+
+bool History::open(const string &p) {
+  if (log) { fclose(log); log = nullptr; }
+  entries.clear();
+  added.clear();
+  index.clear();
+  shortIndex.clear();
+  indexed = 0;
+  lastQuery.clear();
+  lastSize = 0;
+  result.clear();
+  split = false;
+  path = p;
+
+  try {
+    mapped = make_unique<MappedFile>(path);
+  } catch(runtime_error &) {
+    mapped.reset();	// Created below if it does not exist
+  }
+
+  log = openFile(path, "ab");
+  if (log == nullptr) return false;
+  string_view v = mapped ? mapped->view() : string_view();
+  if (!v.empty() && v.back() != '\n') {
+    // The last write was cut short
+    fputc('\n', log);
+    fflush(log);
+  }
+  return true;
+}
+
+void History::splitLog() {
+  if (split) return;
+  split = true;
+  if (!mapped) return;
+  LineSplitter ls(mapped->view());
+  string_view line;
+  while(ls.next(line)) if (!line.empty()) entries.push_back(line);
+}
+
+void History::add(string_view entry) {
+  if (entry.empty()) return;
+  splitLog();
+  string s(entry);
+  replace(s.begin(), s.end(), '\n', ' ');
+  replace(s.begin(), s.end(), '\r', ' ');
+  added.push_back(move(s));
+  entries.push_back(added.back());
+  if (log) {
+    fwrite(added.back().data(), 1, added.back().size(), log);
+    fputc('\n', log);
+    fflush(log);
+  }
+}
+
+void History::clear() {
+  entries.clear();
+  added.clear();
+  mapped.reset();
+  split = true;
+  index.clear();
+  shortIndex.clear();
+  indexed = 0;
+  lastQuery.clear();
+  lastSize = 0;
+  result.clear();
+
+  if (log) {
+    fclose(log);
+    FILE *fp = openFile(path, "wb");
+    if (fp) fclose(fp);
+    log = openFile(path, "ab");
+  }
+}
+
+vector<uint32_t> *History::postings(uint32_t g, bool create) {
+  if ((g >> 24) < 3) {
+    if (shortIndex.empty()) shortIndex.resize(256 + 65536);
+    return &shortIndex[(g >> 24) == 1 ? g & 0xff : 256 + (g & 0xffff)];
+  }
+  if (create) return &index[g];
+  auto it = index.find(g);
+  return it == index.end() ? nullptr : &it->second;
+}
+
+void History::indexEntries() {
+  string t;
+  for(;indexed < entries.size();indexed++) {
+    t.assign(1, startMarker);
+    t.append(entries[indexed]);
+    for(size_t i=0;i<t.size();i++) {
+      for(int n=1;n<=3 && i+n<=t.size();n++) {
+	auto &v = *postings(gram(t.data() + i, n), true);
+	if (v.empty() || v.back() != indexed) v.push_back(uint32_t(indexed));
+      }
+    }
+  }
+}
+
+bool History::matches(size_t i, string_view query, bool prefix) const {
+  return prefix ? entries[i].substr(0, query.size()) == query : entries[i].find(query) != string_view::npos;
+}
+
+const vector<uint32_t> &History::search(string_view query, bool prefix) {
+  splitLog();
+  indexEntries();
+
+  string key = prefix ? string(1, startMarker) : string();
+  key.append(query);
+
+  // The posting list of the rarest n-gram of the key
+  static const vector<uint32_t> none;
+  const vector<uint32_t> *best = nullptr;
+  if (!key.empty()) {
+    const int n = int(min<size_t>(3, key.size()));
+    for(size_t i=0;i+n<=key.size();i++) {
+      const vector<uint32_t> *v = postings(gram(key.data() + i, n), false);
+      if (v == nullptr) v = &none;
+      if (best == nullptr || v->size() < best->size()) best = v;
+    }
+  }
+
+  const bool refine = prefix == lastPrefix && lastSize != 0 && query.substr(0, lastQuery.size()) == lastQuery &&
+    (best == nullptr || result.size() < best->size());
+
+  vector<uint32_t> r;
+  if (refine) {
+    // The entries matching the extended query are among those that matched before, or new
+    for(uint32_t i : result) if (matches(i, query, prefix)) r.push_back(i);
+    for(size_t i=lastSize;i<entries.size();i++) if (matches(i, query, prefix)) r.push_back(uint32_t(i));
+  } else if (best == nullptr) {
+    r.resize(entries.size());
+    for(size_t i=0;i<r.size();i++) r[i] = uint32_t(i);
+  } else if (key.size() <= 3) {
+    r = *best;	// The n-gram is the whole key
+  } else {
+    for(uint32_t i : *best) if (matches(i, query, prefix)) r.push_back(i);
+  }
+
+  result.swap(r);
+  lastQuery.assign(query);
+  lastPrefix = prefix;
+  lastSize = entries.size();
+  return result;
+}
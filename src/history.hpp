@@ -0,0 +1,72 @@
+#include <cstdio>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+
+using namespace std;
+
+namespace octcore {
+  class MappedFile;
+
+  // History of the evaluated expressions, persisted in an append-only log
+  // with one entry per line. The log is memory-mapped when opened and only
+  // split into lines when the entries are first accessed, so that opening
+  // costs the same for any number of entries. Searches use an index of the
+  // 1- to 3-grams of the entries, which is built by the first search and
+  // then kept up to date as entries are added.
+  class History {
+    string path;
+    unique_ptr<MappedFile> mapped;
+    FILE *log = nullptr;
+    bool split = false;
+
+    vector<string_view> entries;	// Views into the mapping or into added
+    deque<string> added;
+
+    // Sorted indices of the entries containing each n-gram, in a table for
+    // 1- and 2-grams and in a hash table for 3-grams. Prefixes are indexed
+    // as n-grams that start with the marker at the start of each entry.
+    vector<vector<uint32_t>> shortIndex;
+    unordered_map<uint32_t, vector<uint32_t>> index;
+    size_t indexed = 0;
+
+    // The last search, refined when the query is extended
+    string lastQuery;
+    bool lastPrefix = false;
+    size_t lastSize = 0;
+    vector<uint32_t> result;
+
+    void splitLog();
+    vector<uint32_t> *postings(uint32_t gram, bool create);
+    void indexEntries();
+    bool matches(size_t i, string_view query, bool prefix) const;
+
+  public:
+    History();
+    ~History();
+    History(const History &) = delete;
+    History &operator=(const History &) = delete;
+
+    // Loads the log at path, and appends the entries added later to it.
+    // Returns false if it cannot be opened for appending, in which case the
+    // history is kept in memory only.
+    bool open(const string &path);
+
+    // Line breaks in the entry are replaced with spaces
+    void add(string_view entry);
+
+    size_t size() { splitLog(); return entries.size(); }
+    string_view at(size_t i) { splitLog(); return entries[i]; }
+
+    // Removes all entries, and truncates the log
+    void clear();
+
+    // Indices of the entries containing the query, or starting with it if
+    // prefix is set, oldest first. The result stays valid until the next call.
+    const vector<uint32_t> &search(string_view query, bool prefix = false);
+  };
+}
@@ -0,0 +1,87 @@
+#include <stdexcept>
+
+#if defined(_WIN32)
+#include <vector>
+#include <windows.h>
+#else
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#include "mappedfile.hpp"
+
+using namespace octcore;
+
+namespace {
+  // Pages are given back to the OS in chunks of this size
+  const size_t discardUnit = 1 << 24;
+}
+
+#if defined(_WIN32)
+MappedFile::MappedFile(const string &path) {
+  int n = MultiByteToWideChar(CP_UTF8, 0, path.c_str(), -1, NULL, 0);
+  vector<wchar_t> wpath(n + 1);
+  MultiByteToWideChar(CP_UTF8, 0, path.c_str(), -1, wpath.data(), n);
+
+  // Others may append to the file while it is mapped, as to the history log
+  hFile = CreateFileW(wpath.data(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+  if (hFile == INVALID_HANDLE_VALUE) { hFile = nullptr; throw(runtime_error("Cannot open " + path)); }
+
+  LARGE_INTEGER s;
+  if (!GetFileSizeEx(hFile, &s)) { CloseHandle(hFile); throw(runtime_error("Cannot get the size of " + path)); }
+  size = (size_t)s.QuadPart;
+  if (size == 0) return;
+
+  hMap = CreateFileMappingW(hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+  if (hMap == NULL) { CloseHandle(hFile); throw(runtime_error("Cannot map " + path)); }
+  data = (const char *)MapViewOfFile(hMap, FILE_MAP_READ, 0, 0, 0);
+  if (data == nullptr) { CloseHandle(hMap); CloseHandle(hFile); throw(runtime_error("Cannot map " + path)); }
+}
+
+MappedFile::~MappedFile() {
+  if (data) UnmapViewOfFile(data);
+  if (hMap) CloseHandle(hMap);
+  if (hFile) CloseHandle(hFile);
+}
+
+void MappedFile::discard(size_t off) {
+  if (off < discarded + discardUnit || data == nullptr) return;
+  SYSTEM_INFO si;
+  GetSystemInfo(&si);
+  size_t e = off / si.dwPageSize * si.dwPageSize;
+  // Unlocking pages that are not locked removes them from the working set
+  VirtualUnlock((LPVOID)(data + discarded), e - discarded);
+  discarded = e;
+}
+#else
+MappedFile::MappedFile(const string &path) {
+  fd = open(path.c_str(), O_RDONLY);
+  if (fd == -1) throw(runtime_error("Cannot open " + path + " : " + strerror(errno)));
+
+  struct stat st;
+  if (fstat(fd, &st) != 0) { close(fd); throw(runtime_error("Cannot stat " + path + " : " + strerror(errno))); }
+  size = (size_t)st.st_size;
+  if (size == 0) return;
+
+  void *p = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (p == MAP_FAILED) { close(fd); throw(runtime_error("Cannot map " + path + " : " + strerror(errno))); }
+  data = (const char *)p;
+  madvise(p, size, MADV_SEQUENTIAL);
+}
+
+MappedFile::~MappedFile() {
+  if (data) munmap((void *)data, size);
+  if (fd != -1) close(fd);
+}
+
+void MappedFile::discard(size_t off) {
+  if (off < discarded + discardUnit || data == nullptr) return;
+  size_t page = (size_t)sysconf(_SC_PAGESIZE), e = off / page * page;
+  madvise((void *)(data + discarded), e - discarded, MADV_DONTNEED);
+  discarded = e;
+}
+#endif
@@ -0,0 +1,49 @@
+#include <string>
+#include <string_view>
+
+using namespace std;
+
+namespace octcore {
+  // Read-only memory mapping of a whole file
+  class MappedFile {
+    const char *data = nullptr;
+    size_t size = 0, discarded = 0;
+#if defined(_WIN32)
+    void *hFile = nullptr, *hMap = nullptr;
+#else
+    int fd = -1;
+#endif
+  public:
+    explicit MappedFile(const string &path);
+    ~MappedFile();
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    string_view view() const { return string_view(data, size); }
+
+    // Tells the OS that the part before off will not be read again, so
+    // that the resident memory does not grow with the file size
+    void discard(size_t off);
+  };
+
+  // Splits text into lines without copying. Lines end with LF or CRLF, and
+  // the line end is not included in the returned line.
+  class LineSplitter {
+    string_view text;
+    size_t pos = 0;
+  public:
+    explicit LineSplitter(string_view t) : text(t) {}
+
+    bool next(string_view &line) {
+      if (pos >= text.size()) return false;
+      size_t e = text.find('\n', pos);
+      if (e == string_view::npos) e = text.size();
+      line = text.substr(pos, e - pos);
+      if (line.size() != 0 && line.back() == '\r') line.remove_suffix(1);
+      pos = e + 1;
+      return true;
+    }
+
+    size_t position() const { return pos; }
+  };
+}
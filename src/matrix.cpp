@@ -0,0 +1,139 @@
+#include <algorithm>
+
+#include "matrix.hpp"
+#include "parallel.hpp"
+
+namespace {
+  // Rows and columns of the output, and terms of the inner products, per
+  // block. A block of 64 x 64 octuples takes 128 KiB. The panels of the LU
+  // factorization have luBlock columns, and the substitutions are split
+  // into blocks of rhsBlock right-hand sides.
+  const size_t rowBlock = 16, colBlock = 64, depthBlock = 64, luBlock = 32, rhsBlock = 16;
+
+  // Multiply-adds below which a kernel runs on the calling thread only
+  const size_t minParallelWork = 1 << 15;
+
+  size_t threadsFor(size_t work, size_t nthreads) { return work < minParallelWork ? 1 : nthreads; }
+
+  size_t blocks(size_t n, size_t b) { return (n + b - 1) / b; }
+}
+
+void matrix::multiply(const tlfloat_octuple *a, const tlfloat_octuple *b, tlfloat_octuple *c, size_t n, size_t m, size_t p, size_t nthreads) {
+  fill(c, c + n * p, tlfloat_octuple(0));
+  const size_t ncb = blocks(p, colBlock);
+  parallel::parallelFor(blocks(n, rowBlock) * ncb, threadsFor(n * m * p, nthreads), [&](size_t t) {
+    const size_t i0 = t / ncb * rowBlock, i1 = min(n, i0 + rowBlock), j0 = t % ncb * colBlock, j1 = min(p, j0 + colBlock);
+    for(size_t k0=0;k0<m;k0+=depthBlock) {
+      const size_t k1 = min(m, k0 + depthBlock);
+      for(size_t i=i0;i<i1;i++) {
+	tlfloat_octuple *ci = c + i * p;
+	for(size_t k=k0;k<k1;k++) {
+	  const tlfloat_octuple aik = a[i * m + k], *bk = b + k * p;
+	  for(size_t j=j0;j<j1;j++) ci[j] += aik * bk[j];
+	}
+      }
+    }
+  });
+}
+
+void matrix::transpose(const tlfloat_octuple *a, tlfloat_octuple *t, size_t n, size_t m) {
+  for(size_t i0=0;i0<n;i0+=luBlock) {
+    for(size_t j0=0;j0<m;j0+=luBlock) {
+      for(size_t i=i0;i<min(n, i0 + luBlock);i++) {
+	for(size_t j=j0;j<min(m, j0 + luBlock);j++) t[j * n + i] = a[i * m + j];
+      }
+    }
+  }
+}
+
+// Right-looking blocked factorization. Each panel of columns is factored
+// with the row swaps applied to whole rows, then the rows of U to its
+// right are solved for, and the trailing matrix is updated with the
+// product of the two, in parallel over blocks of rows.
+bool matrix::lu(tlfloat_octuple *a, size_t n, vector<size_t> &perm, int &sign, size_t nthreads) {
+  perm.resize(n);
+  for(size_t i=0;i<n;i++) perm[i] = i;
+  sign = 1;
+  bool regular = true;
+
+  for(size_t k0=0;k0<n;k0+=luBlock) {
+    const size_t k1 = min(n, k0 + luBlock);
+    for(size_t j=k0;j<k1;j++) {
+      size_t piv = j;
+      tlfloat_octuple best = tlfloat_fabso(a[j * n + j]);
+      for(size_t i=j+1;i<n;i++) {
+	const tlfloat_octuple v = tlfloat_fabso(a[i * n + j]);
+	if (v > best) { best = v; piv = i; }
+      }
+      if (piv != j) {
+	swap_ranges(a + j * n, a + (j + 1) * n, a + piv * n);
+	swap(perm[j], perm[piv]);
+	sign = -sign;
+      }
+      const tlfloat_octuple d = a[j * n + j];
+      if (d == 0) { regular = false; continue; }
+      for(size_t i=j+1;i<n;i++) {
+	const tlfloat_octuple l = a[i * n + j] /= d;
+	for(size_t c=j+1;c<k1;c++) a[i * n + c] -= l * a[j * n + c];
+      }
+    }
+    if (k1 == n) break;
+
+    for(size_t j=k0;j<k1;j++) {
+      for(size_t i=j+1;i<k1;i++) {
+	const tlfloat_octuple l = a[i * n + j];
+	for(size_t c=k1;c<n;c++) a[i * n + c] -= l * a[j * n + c];
+      }
+    }
+
+    const size_t rest = n - k1;
+    parallel::parallelFor(blocks(rest, rowBlock), threadsFor(rest * rest * (k1 - k0), nthreads), [&](size_t t) {
+      const size_t i0 = k1 + t * rowBlock, i1 = min(n, i0 + rowBlock);
+      for(size_t c0=k1;c0<n;c0+=colBlock) {
+	const size_t c1 = min(n, c0 + colBlock);
+	for(size_t i=i0;i<i1;i++) {
+	  tlfloat_octuple *ai = a + i * n;
+	  for(size_t k=k0;k<k1;k++) {
+	    const tlfloat_octuple l = ai[k], *ak = a + k * n;
+	    for(size_t c=c0;c<c1;c++) ai[c] -= l * ak[c];
+	  }
+	}
+      }
+    });
+  }
+  return regular;
+}
+
+// Forward and back substitution, in parallel over blocks of columns of b
+void matrix::luSolve(const tlfloat_octuple *f, const vector<size_t> &perm, tlfloat_octuple *b, size_t n, size_t p, size_t nthreads) {
+  vector<tlfloat_octuple> x(n * p);
+  for(size_t i=0;i<n;i++) copy(b + perm[i] * p, b + (perm[i] + 1) * p, x.begin() + i * p);
+
+  parallel::parallelFor(blocks(p, rhsBlock), threadsFor(n * n * p, nthreads), [&](size_t t) {
+    const size_t c0 = t * rhsBlock, c1 = min(p, c0 + rhsBlock);
+    for(size_t i=0;i<n;i++) {
+      for(size_t k=0;k<i;k++) {
+	const tlfloat_octuple l = f[i * n + k];
+	for(size_t c=c0;c<c1;c++) x[i * p + c] -= l * x[k * p + c];
+      }
+    }
+    for(size_t i=n;i-- > 0;) {
+      for(size_t k=i+1;k<n;k++) {
+	const tlfloat_octuple u = f[i * n + k];
+	for(size_t c=c0;c<c1;c++) x[i * p + c] -= u * x[k * p + c];
+      }
+      for(size_t c=c0;c<c1;c++) x[i * p + c] /= f[i * n + i];
+    }
+  });
+  copy(x.begin(), x.end(), b);
+}
+
+tlfloat_octuple matrix::det(const tlfloat_octuple *a, size_t n, size_t nthreads) {
+  vector<tlfloat_octuple> f(a, a + n * n);
+  vector<size_t> perm;
+  int sign;
+  lu(f.data(), n, perm, sign, nthreads);
+  tlfloat_octuple d = sign;
+  for(size_t i=0;i<n;i++) d *= f[i * n + i];
+  return d == 0 ? tlfloat_octuple(0) : d;	// Not -0 after an odd permutation
+}
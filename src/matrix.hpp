@@ -0,0 +1,33 @@
+#include <cstddef>
+#include <vector>
+
+#include <tlfloat/tlfloat.h>
+
+using namespace std;
+
+// Dense linear algebra on row-major octuple matrices. The kernels work on
+// blocks that fit in the cache, and split the rows or the columns of their
+// output among up to nthreads threads, or the hardware concurrency if
+// nthreads is 0. Each element is computed by one thread with its terms in
+// a fixed order, so that the results do not depend on the number of
+// threads, and the blocked LU factorization gives the same bits as the
+// textbook one.
+namespace matrix {
+  // c (n x p) = a (n x m) b (m x p)
+  void multiply(const tlfloat_octuple *a, const tlfloat_octuple *b, tlfloat_octuple *c, size_t n, size_t m, size_t p, size_t nthreads = 0);
+
+  // t (m x n) = the transpose of a (n x m)
+  void transpose(const tlfloat_octuple *a, tlfloat_octuple *t, size_t n, size_t m);
+
+  // LU factorization of a (n x n) with partial pivoting, in place, with the
+  // unit lower triangle below the diagonal. Row i of the factors is row
+  // perm[i] of a, and sign is the sign of the permutation. Returns false if
+  // a is singular, in which case the factorization goes on past the zero
+  // pivots.
+  bool lu(tlfloat_octuple *a, size_t n, vector<size_t> &perm, int &sign, size_t nthreads = 0);
+
+  // Replaces b (n x p) with the solution x of a x = b, given the LU factors of a
+  void luSolve(const tlfloat_octuple *f, const vector<size_t> &perm, tlfloat_octuple *b, size_t n, size_t p, size_t nthreads = 0);
+
+  tlfloat_octuple det(const tlfloat_octuple *a, size_t n, size_t nthreads = 0);
+}
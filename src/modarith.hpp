@@ -0,0 +1,437 @@
+#include <cstdint>
+#include <algorithm>
+#include <string>
+
+#if defined(_MSC_VER) && defined(_M_X64) && !defined(__clang__)
+#include <intrin.h>
+#endif
+
+using namespace std;
+
+// Unsigned 128-bit integer as two 64-bit limbs, with just the operations
+// needed for modular arithmetic
+struct U128 {
+  uint64_t lo = 0, hi = 0;
+
+  U128() {}
+  U128(uint64_t l, uint64_t h = 0) : lo(l), hi(h) {}
+
+  bool operator==(const U128 &o) const { return lo == o.lo && hi == o.hi; }
+  bool operator!=(const U128 &o) const { return !(*this == o); }
+  bool operator<(const U128 &o) const { return hi != o.hi ? hi < o.hi : lo < o.lo; }
+  bool operator>=(const U128 &o) const { return !(*this < o); }
+
+  bool isZero() const { return (lo | hi) == 0; }
+  bool isOdd() const { return lo & 1; }
+  bool bit(int i) const { return ((i < 64 ? lo >> i : hi >> (i - 64)) & 1) != 0; }
+
+  U128 shr(int s) const {
+    if (s == 0) return *this;
+    if (s >= 64) return U128(hi >> (s - 64), 0);
+    return U128((lo >> s) | (hi << (64 - s)), hi >> s);
+  }
+  U128 shl(int s) const {
+    if (s == 0) return *this;
+    if (s >= 64) return U128(0, lo << (s - 64));
+    return U128(lo << s, (hi << s) | (lo >> (64 - s)));
+  }
+
+  // Returns the carry out of the top limb
+  bool addTo(const U128 &o) {
+    uint64_t l = lo + o.lo;
+    uint64_t c = l < lo;
+    uint64_t h = hi + o.hi;
+    bool carry = h < hi;
+    h += c;
+    carry = carry || h < c;
+    lo = l; hi = h;
+    return carry;
+  }
+  // Returns the borrow out of the top limb
+  bool subFrom(const U128 &o) {
+    uint64_t b = lo < o.lo;
+    bool borrow = hi < o.hi || (hi - o.hi) < b;
+    lo -= o.lo;
+    hi = hi - o.hi - b;
+    return borrow;
+  }
+
+  static int clz64(uint64_t u) {
+#if defined(__GNUC__)
+    return u == 0 ? 64 : __builtin_clzll(u);
+#else
+    int z = 0;
+    for(uint64_t m = uint64_t(1) << 63;m && !(u & m);m >>= 1) z++;
+    return z;
+#endif
+  }
+  static int ctz64(uint64_t u) {
+#if defined(__GNUC__)
+    return u == 0 ? 64 : __builtin_ctzll(u);
+#else
+    int z = 0;
+    for(;z < 64 && !((u >> z) & 1);z++) ;
+    return z;
+#endif
+  }
+  int bitLength() const { return hi ? 128 - clz64(hi) : 64 - clz64(lo); }
+  int ctz() const { return lo ? ctz64(lo) : 64 + ctz64(hi); }
+
+  // Remainder by a divisor below 2^32, a 32-bit chunk at a time
+  uint32_t mod32(uint32_t d) const {
+    uint64_t r = 0;
+    r = ((r << 32) | (hi >> 32)) % d;
+    r = ((r << 32) | (hi & 0xffffffff)) % d;
+    r = ((r << 32) | (lo >> 32)) % d;
+    r = ((r << 32) | (lo & 0xffffffff)) % d;
+    return uint32_t(r);
+  }
+
+  // Quotient by a divisor below 2^32, leaving the remainder in rem
+  U128 div32(uint32_t d, uint32_t &rem) const {
+    uint64_t r = 0, q[4];
+    const uint64_t c[4] = { hi >> 32, hi & 0xffffffff, lo >> 32, lo & 0xffffffff };
+    for(int i=0;i<4;i++) {
+      uint64_t x = (r << 32) | c[i];
+      q[i] = x / d;
+      r = x % d;
+    }
+    rem = uint32_t(r);
+    return U128((q[2] << 32) | q[3], (q[0] << 32) | q[1]);
+  }
+
+  string toDecimal() const {
+    char buf[48], *p = buf + sizeof(buf);
+    *--p = '\0';
+    U128 u = *this;
+    do {
+      uint32_t r;
+      u = u.div32(1000000000, r);
+      for(int i=0;i<9 && (r != 0 || !u.isZero());i++) { *--p = char('0' + r % 10); r /= 10; }
+    } while(!u.isZero());
+    if (*p == '\0') *--p = '0';
+    return p;
+  }
+};
+
+// Full 64x64 -> 128-bit product
+inline U128 mul64(uint64_t a, uint64_t b) {
+#if defined(__SIZEOF_INT128__)
+  unsigned __int128 p = (unsigned __int128)a * b;
+  return U128(uint64_t(p), uint64_t(p >> 64));
+#elif defined(_MSC_VER) && defined(_M_X64) && !defined(__clang__)
+  uint64_t h, l = _umul128(a, b, &h);
+  return U128(l, h);
+#else
+  uint64_t a0 = a & 0xffffffff, a1 = a >> 32, b0 = b & 0xffffffff, b1 = b >> 32;
+  uint64_t p00 = a0 * b0, p01 = a0 * b1, p10 = a1 * b0, p11 = a1 * b1;
+  uint64_t mid = (p00 >> 32) + (p01 & 0xffffffff) + (p10 & 0xffffffff);
+  return U128((mid << 32) | (p00 & 0xffffffff), p11 + (p01 >> 32) + (p10 >> 32) + (mid >> 32));
+#endif
+}
+
+// a * b, returning false if the product does not fit in 128 bits
+inline bool mul128(const U128 &a, const U128 &b, U128 &p) {
+  if (a.hi != 0 && b.hi != 0) return false;
+  const U128 c = mul64(a.hi | b.hi, a.hi != 0 ? b.lo : a.lo);
+  p = mul64(a.lo, b.lo);
+  if (c.hi != 0) return false;
+  p.hi += c.lo;
+  return p.hi >= c.lo;
+}
+
+// Quotient and remainder by shift and subtract, for the rare operations
+// that are not done in Montgomery form
+inline void divmod(U128 a, const U128 &d, U128 &q, U128 &r) {
+  q = U128(); r = U128();
+  if (a < d) { r = a; return; }
+  if (a.hi == 0) { q = U128(a.lo / d.lo); r = U128(a.lo % d.lo); return; }
+  for(int i = a.bitLength() - 1;i >= 0;i--) {
+    bool top = r.hi >> 63;
+    r = r.shl(1);
+    r.lo |= a.bit(i);
+    q = q.shl(1);
+    if (top || r >= d) { r.subFrom(d); q.lo |= 1; }
+  }
+}
+
+inline U128 mod(const U128 &a, const U128 &m) { U128 q, r; divmod(a, m, q, r); return r; }
+
+// (a + b) mod m, for a, b < m
+inline U128 addmod(U128 a, const U128 &b, const U128 &m) {
+  if (a.addTo(b) || a >= m) a.subFrom(m);
+  return a;
+}
+
+// (a - b) mod m, for a, b < m
+inline U128 submod(U128 a, const U128 &b, const U128 &m) {
+  if (a.subFrom(b)) a.addTo(m);
+  return a;
+}
+
+// a * b mod m by double and add, for moduli on which Montgomery form cannot be used
+inline U128 mulmodSlow(const U128 &a, const U128 &b, const U128 &m) {
+  U128 r;
+  for(int i = b.bitLength() - 1;i >= 0;i--) {
+    r = addmod(r, r, m);
+    if (b.bit(i)) r = addmod(r, a, m);
+  }
+  return r;
+}
+
+// Binary GCD
+inline U128 gcd(U128 a, U128 b) {
+  if (a.isZero()) return b;
+  if (b.isZero()) return a;
+  const int k = min(a.ctz(), b.ctz());
+  a = a.shr(a.ctz());
+  for(;;) {
+    b = b.shr(b.ctz());
+    if (a >= b && a != b) { U128 t = a; a = b; b = t; }
+    b.subFrom(a);
+    if (b.isZero()) return a.shl(k);
+  }
+}
+
+// Montgomery arithmetic modulo an odd n > 1 with R = 2^128. Numbers in
+// Montgomery form are kept fully reduced, so they can be compared directly.
+class Montgomery {
+  U128 n_, r2;
+  uint64_t ninv;	// -n^-1 mod 2^64
+
+  // t + x * y + c, returning the low limb and leaving the high limb in c
+  static uint64_t mac(uint64_t t, uint64_t x, uint64_t y, uint64_t &c) {
+    U128 p = mul64(x, y);
+    p.lo += t; p.hi += p.lo < t;
+    p.lo += c; p.hi += p.lo < c;
+    c = p.hi;
+    return p.lo;
+  }
+
+public:
+  U128 one;	// R mod n, that is 1 in Montgomery form
+
+  explicit Montgomery(const U128 &n) : n_(n) {
+    uint64_t x = n.lo;		// Newton iteration for the inverse, doubling the correct bits each time
+    for(int i=0;i<5;i++) x *= 2 - n.lo * x;
+    ninv = 0 - x;
+
+    // 2^128 mod n and 2^256 mod n by doubling
+    U128 r(1);
+    for(int i=0;i<128;i++) r = addmod(r, r, n);
+    one = r;
+    for(int i=0;i<128;i++) r = addmod(r, r, n);
+    r2 = r;
+  }
+
+  const U128 &modulus() const { return n_; }
+
+  // a * b / R mod n by CIOS, for a, b < n
+  U128 mul(const U128 &a, const U128 &b) const {
+    uint64_t t0 = 0, t1 = 0, t2 = 0;
+    for(int i=0;i<2;i++) {
+      const uint64_t bi = i == 0 ? b.lo : b.hi;
+      uint64_t c = 0;
+      t0 = mac(t0, a.lo, bi, c);
+      t1 = mac(t1, a.hi, bi, c);
+      t2 += c;
+      uint64_t t3 = t2 < c;
+
+      const uint64_t m = t0 * ninv;
+      c = 0;
+      mac(t0, m, n_.lo, c);
+      t0 = mac(t1, m, n_.hi, c);
+      t1 = t2 + c;
+      t2 = t3 + (t1 < c);
+    }
+    U128 r(t0, t1);
+    if (t2 || r >= n_) r.subFrom(n_);
+    return r;
+  }
+
+  U128 to(const U128 &a) const { return mul(a < n_ ? a : mod(a, n_), r2); }
+  U128 from(const U128 &a) const { return mul(a, U128(1)); }
+  U128 add(const U128 &a, const U128 &b) const { return addmod(a, b, n_); }
+  U128 sub(const U128 &a, const U128 &b) const { return submod(a, b, n_); }
+
+  // a ^ e, with a and the result in Montgomery form
+  U128 pow(const U128 &a, const U128 &e) const {
+    U128 r = one;
+    for(int i = e.bitLength() - 1;i >= 0;i--) {
+      r = mul(r, r);
+      if (e.bit(i)) r = mul(r, a);
+    }
+    return r;
+  }
+};
+
+inline U128 mulmod(const U128 &a, const U128 &b, const U128 &m) {
+  if (m == U128(1)) return U128();
+  if (!m.isOdd()) return mulmodSlow(mod(a, m), mod(b, m), m);
+  Montgomery mg(m);
+  return mg.from(mg.mul(mg.to(a), mg.to(b)));
+}
+
+inline U128 powmod(const U128 &a, const U128 &e, const U128 &m) {
+  if (m == U128(1)) return U128();
+  if (m.isOdd()) {
+    Montgomery mg(m);
+    return mg.from(mg.pow(mg.to(a), e));
+  }
+  U128 b = mod(a, m), r(1);
+  for(int i = e.bitLength() - 1;i >= 0;i--) {
+    r = mulmodSlow(r, r, m);
+    if (e.bit(i)) r = mulmodSlow(r, b, m);
+  }
+  return r;
+}
+
+// Inverse of a modulo m by the extended Euclidean algorithm, with the
+// coefficients kept reduced modulo m. Returns false if gcd(a, m) != 1.
+inline bool invmod(const U128 &a, const U128 &m, U128 &inv) {
+  if (m == U128(1)) { inv = U128(); return true; }
+  const bool odd = m.isOdd();
+  const Montgomery mg(odd ? m : U128(3));
+  U128 r0 = m, r1 = mod(a, m), x0, x1(1);
+  while(!r1.isZero()) {
+    U128 q, r;
+    divmod(r0, r1, q, r);
+    U128 x = submod(x0, odd ? mg.mul(mg.to(q), x1) : mulmodSlow(mod(q, m), x1, m), m);
+    r0 = r1; r1 = r;
+    x0 = x1; x1 = x;
+  }
+  if (r0 != U128(1)) return false;
+  inv = x0;
+  return true;
+}
+
+namespace modarith_detail {
+  inline const uint32_t *smallPrimes(int &count) {
+    static const uint32_t primes[] = {
+      2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37, 41, 43, 47, 53, 59, 61, 67, 71, 73, 79, 83, 89, 97,
+      101, 103, 107, 109, 113, 127, 131, 137, 139, 149, 151, 157, 163, 167, 173, 179, 181, 191, 193, 197, 199,
+    };
+    count = sizeof(primes) / sizeof(primes[0]);
+    return primes;
+  }
+
+  // Strong probable prime test to base a, for odd n with n - 1 = d * 2^s
+  inline bool sprp(const Montgomery &mg, const U128 &d, int s, uint32_t a) {
+    const U128 mone = mg.sub(U128(), mg.one);
+    U128 x = mg.pow(mg.to(U128(a)), d);
+    if (x == mg.one || x == mone) return true;
+    for(int i=1;i<s;i++) {
+      x = mg.mul(x, x);
+      if (x == mone) return true;
+      if (x == mg.one) return false;
+    }
+    return false;
+  }
+
+  // Jacobi symbol (a / n) for odd n > 0 and |a| < 2^31
+  inline int jacobi(int64_t a, const U128 &n) {
+    int j = 1;
+    if (a < 0) { a = -a; if ((n.lo & 3) == 3) j = -j; }
+    uint64_t x = n.mod32(uint32_t(a)), y = uint64_t(a);
+    // (a / n) = (n mod a / a) * (-1)^((a-1)(n-1)/4), after removing the factors of 2 of a
+    while(y % 2 == 0) { y /= 2; if ((n.lo & 7) == 3 || (n.lo & 7) == 5) j = -j; }
+    if ((y & 3) == 3 && (n.lo & 3) == 3) j = -j;
+    x %= y;
+    while(x != 0) {
+      while(x % 2 == 0) { x /= 2; if ((y & 7) == 3 || (y & 7) == 5) j = -j; }
+      uint64_t t = x; x = y; y = t;
+      if ((x & 3) == 3 && (y & 3) == 3) j = -j;
+      x %= y;
+    }
+    return y == 1 ? j : 0;
+  }
+
+  // Halving modulo the odd modulus of mg
+  inline U128 half(const Montgomery &mg, U128 x) {
+    if (!x.isOdd()) return x.shr(1);
+    bool carry = x.addTo(mg.modulus());
+    x = x.shr(1);
+    if (carry) x.hi |= uint64_t(1) << 63;
+    return x;
+  }
+
+  inline bool isSquare(const U128 &n) {
+    uint64_t lo = 0, hi = ~uint64_t(0);
+    while(lo < hi) {
+      uint64_t mid = lo + (hi - lo) / 2 + 1;
+      if (n < mul64(mid, mid)) hi = mid - 1; else lo = mid;
+    }
+    return mul64(lo, lo) == n;
+  }
+
+  // Strong Lucas probable prime test with Selfridge's parameters, for odd n
+  // that is not a perfect square
+  inline bool slprp(const Montgomery &mg, const U128 &n) {
+    int64_t D = 5;
+    for(;;) {
+      int j = jacobi(D, n);
+      if (j == -1) break;
+      if (j == 0 && U128(uint64_t(D < 0 ? -D : D)) != n) return false;
+      D = D < 0 ? -D + 2 : -D - 2;
+      if (D == 17 && isSquare(n)) return false;	// A perfect square never gives -1
+    }
+    const int64_t Qi = (1 - D) / 4;
+    auto fromInt = [&](int64_t v) {
+      U128 m = mg.to(U128(uint64_t(v < 0 ? -v : v)));
+      return v < 0 ? mg.sub(U128(), m) : m;
+    };
+    const U128 Dm = fromInt(D), Qm = fromInt(Qi);
+
+    U128 d = n; d.addTo(U128(1));	// n + 1 = d * 2^s, which does not overflow as n is odd and below 2^128 - 1
+    const int s = d.ctz();
+    d = d.shr(s);
+
+    // Left-to-right ladder with U_k, V_k and Q^k, for P = 1
+    U128 U = mg.one, V = mg.one, Qk = Qm;
+    for(int i = d.bitLength() - 2;i >= 0;i--) {
+      U = mg.mul(U, V);
+      V = mg.sub(mg.mul(V, V), mg.add(Qk, Qk));
+      Qk = mg.mul(Qk, Qk);
+      if (d.bit(i)) {
+	U128 u = half(mg, mg.add(U, V));
+	V = half(mg, mg.add(mg.mul(Dm, U), V));
+	U = u;
+	Qk = mg.mul(Qk, Qm);
+      }
+    }
+    if (U.isZero() || V.isZero()) return true;
+    for(int r=1;r<s;r++) {
+      V = mg.sub(mg.mul(V, V), mg.add(Qk, Qk));
+      if (V.isZero()) return true;
+      Qk = mg.mul(Qk, Qk);
+    }
+    return false;
+  }
+}
+
+// Below 3.3 * 10^24 the Miller-Rabin test with the first 13 prime bases is
+// deterministic (Sorenson and Webster). Above that, the Baillie-PSW test
+// is used, which has no known counterexample.
+inline bool isprime(const U128 &n) {
+  using namespace modarith_detail;
+  if (n < U128(2)) return false;
+  int np;
+  const uint32_t *primes = smallPrimes(np);
+  for(int i=0;i<np;i++) {
+    if (n == U128(primes[i])) return true;
+    if (n.mod32(primes[i]) == 0) return false;
+  }
+  if (n < U128(199 * 199)) return true;
+
+  Montgomery mg(n);
+  U128 d = n; d.subFrom(U128(1));
+  const int s = d.ctz();
+  d = d.shr(s);
+
+  const U128 limit(0x51adc5b22410a5fdULL, 0x2be69ULL);	// 3317044064679887385961981
+  if (n < limit) {
+    for(int i=0;i<13;i++) if (!sprp(mg, d, s, primes[i])) return false;
+    return true;
+  }
+  return sprp(mg, d, s, 2) && slprp(mg, n);
+}
@@ -0,0 +1,24 @@
+#include <cstdint>
+
+#include <tlfloat/tlfloat.h>
+
+using namespace std;
+
+// Small helpers shared by the sources of the library, which are not part
+// of its interface
+namespace numutil {
+  inline tlfloat_octuple fromU64(uint64_t u) { return tlfloat_uint128_t(u); }
+
+  inline bool isdigit_(char c) { return '0' <= c && c <= '9'; }
+
+  // Neumaier's compensated summation
+  struct CompensatedSum {
+    tlfloat_octuple s = 0, c = 0;
+    void add(tlfloat_octuple x) {
+      const tlfloat_octuple t = s + x;
+      c += tlfloat_fabso(s) >= tlfloat_fabso(x) ? (s - t) + x : (x - t) + s;
+      s = t;
+    }
+    tlfloat_octuple value() const { return s + c; }
+  };
+}
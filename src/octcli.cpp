@@ -0,0 +1,294 @@
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+#if defined(_WIN32)
+#include <io.h>
+#include <fcntl.h>
+#endif
+
+#include "octcore.hpp"
+#include "mappedfile.hpp"
+#include "tabulate.hpp"
+#include "stats.hpp"
+#include "server.hpp"
+
+using namespace std;
+using namespace octcore;
+
+namespace {
+  bool hexMode = false;
+  int nErrors = 0;
+
+  bool isBlank(string_view s) {
+    for(char c : s) if (!isspace((unsigned char)c)) return false;
+    return true;
+  }
+
+  void printResult(const string &name, size_t lineno, string_view line, const Result &r) {
+    if (isBlank(line)) return;
+    if (!r.ok()) {
+      fprintf(stderr, "%s:%zu: %s\n", name.c_str(), lineno, r.error.message().c_str());
+      nErrors++;
+      return;
+    }
+    if (!r.profile.empty()) puts(r.profile.c_str());
+    if (r.label.substr(0, 5) == "TEXT:") {
+      puts(r.label.c_str() + 5);
+      return;
+    }
+    BigInt b;
+    if (r.label.substr(0, 4) == "INT:" && BigInt::parse(r.label.substr(4), b)) {
+      puts(hexMode ? b.toString(16).c_str() : r.label.c_str() + 4);
+      return;
+    }
+    char buf[256];
+    tlfloat_snprintf(buf, sizeof(buf), hexMode ? "%Oa" : "%.70Og", r.value);
+    puts(buf);
+  }
+
+  void showUsage(const char *argv0) {
+    fprintf(stderr, "Usage : %s [-x] [-s] [-r] [-t <threads>] [-m <variable> <matrix file>] [-e <expression>] [<script file> ...]\n", argv0);
+    fprintf(stderr, "        %s [-e <expression>] --tabulate <expression> <variable> (--range <from> <to> <count> | --points <file>)\n", argv0);
+    fprintf(stderr, "          [-x] [-b] [-o <output file>] [-t <threads>]\n");
+    fprintf(stderr, "        %s --stats <data file> <column> [-x] [-t <threads>]\n", argv0);
+    fprintf(stderr, "        %s --serve <socket path or port> [-t <threads>]\n", argv0);
+    fprintf(stderr, "  Evaluates each line of the script files, or of the standard input if no\n");
+    fprintf(stderr, "  file or expression is given, and prints the results.\n");
+    fprintf(stderr, "  -x : print in hexadecimal\n");
+    fprintf(stderr, "  -s : print statistics of the result cache on exit\n");
+    fprintf(stderr, "  -r : reactive mode, in which variables defined by expressions follow their inputs\n");
+    fprintf(stderr, "  -t : number of threads, or of evaluation threads of the server\n");
+    fprintf(stderr, "  -m : assign the matrix in the file, with the numbers of a row on each line, to the variable\n");
+    fprintf(stderr, "  --tabulate : write the values of the variable and of the expression as CSV, at count evenly\n");
+    fprintf(stderr, "    spaced values from <from> to <to> inclusive, or at the numbers in the file, one per line\n");
+    fprintf(stderr, "  -b : write the table as raw little-endian binary256 values after a 64-byte header\n");
+    fprintf(stderr, "  -o : write the table to the file instead of the standard output\n");
+    fprintf(stderr, "  --stats : print the count, sum, mean, variance, higher moments, minimum and maximum of a column\n");
+    fprintf(stderr, "    of numbers, counted from 1, separated by commas, semicolons or spaces\n");
+    fprintf(stderr, "  --serve : serve JSON requests on a Unix domain socket, or on a TCP port on localhost\n");
+  }
+
+  struct TableArgs {
+    string expr, var, from, to, points, output;
+    size_t count = 0;
+    bool binary = false;
+  };
+
+  // The numbers on the non-blank lines of the file
+  bool readPoints(const string &path, vector<tlfloat_octuple> &xs) {
+    MappedFile file(path);
+    LineSplitter ls(file.view());
+    string_view line;
+    string buf;
+    for(size_t lineno = 1;ls.next(line);lineno++) {
+      if (isBlank(line)) continue;
+      buf.assign(line);
+      const char *p = buf.c_str();
+      const char *end;
+      xs.push_back(tlfloat_strtoo(p, &end));
+      if (end == p || !isBlank(end)) {
+	fprintf(stderr, "%s:%zu: Number expected\n", path.c_str(), lineno);
+	return false;
+      }
+    }
+    return true;
+  }
+
+  int stats(const string &path, size_t column, unsigned nThreads) {
+    ColumnStats st;
+    try {
+      MappedFile file(path);
+      st = columnStats(file, column - 1, nThreads);
+    } catch(exception &ex) {
+      fprintf(stderr, "%s\n", ex.what());
+      return -1;
+    }
+    printf("count    : %llu\n", (unsigned long long)st.n);
+    printf("skipped  : %llu\n", (unsigned long long)st.skipped);
+    const pair<const char *, tlfloat_octuple> rows[] = {
+      { "sum", st.sum }, { "mean", st.mean }, { "variance", st.variance() }, { "stddev", tlfloat_sqrto(st.variance()) },
+      { "skewness", st.skewness() }, { "kurtosis", st.kurtosis() }, { "min", st.min }, { "max", st.max },
+    };
+    char buf[256];
+    for(auto &r : rows) {
+      tlfloat_snprintf(buf, sizeof(buf), hexMode ? "%Oa" : "%.70Og", r.second);
+      printf("%-8s : %s\n", r.first, buf);
+    }
+    return 0;
+  }
+
+  int tabulate(OctCore &octCore, const TableArgs &t, unsigned nThreads) {
+    Tabulator tab(t.expr, t.var, octCore.variables());
+    if (tab.error()) {
+      fprintf(stderr, "%s\n", tab.error().message().c_str());
+      return -1;
+    }
+    tab.setThreads(nThreads);
+
+    vector<tlfloat_octuple> xs;
+    tlfloat_octuple x0 = 0, x1 = 0;
+    try {
+      if (!t.points.empty()) {
+	if (!readPoints(t.points, xs)) return -1;
+      } else {
+	Result r0 = octCore.evaluate(t.from), r1 = octCore.evaluate(t.to);
+	if (!r0.ok() || !r1.ok()) {
+	  fprintf(stderr, "Range : %s\n", (r0.ok() ? r1 : r0).error.message().c_str());
+	  return -1;
+	}
+	x0 = r0.value;
+	x1 = r1.value;
+      }
+    } catch(exception &ex) {
+      fprintf(stderr, "%s\n", ex.what());
+      return -1;
+    }
+
+    FILE *fp = stdout;
+    if (!t.output.empty()) {
+      fp = fopen(t.output.c_str(), "wb");
+      if (fp == nullptr) {
+	fprintf(stderr, "Cannot open %s\n", t.output.c_str());
+	return -1;
+      }
+    }
+#if defined(_WIN32)
+    if (fp == stdout && t.binary) _setmode(_fileno(stdout), _O_BINARY);
+#endif
+    setvbuf(fp, nullptr, _IOFBF, 1 << 20);
+
+    const Tabulator::Format format = t.binary ? Tabulator::BINARY : hexMode ? Tabulator::CSV_HEX : Tabulator::CSV;
+    bool ok = t.points.empty() ? tab.writeRange(fp, format, x0, x1, t.count) :
+      tab.write(fp, format, xs.size(), [&](size_t i) { return xs[i]; });
+    if (fp != stdout && fclose(fp) != 0) ok = false;
+    if (!ok) {
+      fprintf(stderr, "Cannot write %s\n", t.output.empty() ? "the table" : t.output.c_str());
+      return -1;
+    }
+    return 0;
+  }
+
+  int serve(const string &addr, int nThreads) {
+    try {
+      Server server(addr, nThreads);
+      fprintf(stderr, "Serving on %s\n", addr.c_str());
+      server.run();
+    } catch(exception &ex) {
+      fprintf(stderr, "%s\n", ex.what());
+      return -1;
+    }
+    return 0;
+  }
+}
+
+int main(int argc, char **argv) {
+  OctCore octCore;
+  bool executed = false, showStats = false;
+  TableArgs table;
+  string statsFile;
+  size_t statsColumn = 0;
+  unsigned nThreads = 0;
+  octCore.setCacheBudget(1 << 24);
+
+  if (argc >= 3 && string(argv[1]) == "--serve") {
+    if (argc == 3) return serve(argv[2], 0);
+    if (argc == 5 && string(argv[3]) == "-t") return serve(argv[2], atoi(argv[4]));
+    showUsage(argv[0]);
+    return -1;
+  }
+
+  for(int i=1;i<argc;i++) {
+    string a = argv[i];
+    if (a == "-x") {
+      hexMode = true;
+    } else if (a == "-s") {
+      showStats = true;
+    } else if (a == "-r") {
+      octCore.setReactive(true);
+    } else if (a == "-t" && i+1 < argc) {
+      nThreads = unsigned(atoi(argv[++i]));
+      octCore.setThreads(nThreads);
+    } else if (a == "-m" && i+2 < argc) {
+      const string name = argv[++i], path = argv[++i];
+      try {
+	MappedFile file(path);
+	Error e = octCore.loadMatrix(name, file);
+	if (e) {
+	  fprintf(stderr, "%s : %s\n", path.c_str(), e.message().c_str());
+	  return -1;
+	}
+      } catch(exception &ex) {
+	fprintf(stderr, "%s\n", ex.what());
+	return -1;
+      }
+    } else if (a == "--tabulate" && i+2 < argc) {
+      table.expr = argv[++i];
+      table.var = argv[++i];
+    } else if (a == "--range" && i+3 < argc) {
+      table.from = argv[++i];
+      table.to = argv[++i];
+      table.count = strtoull(argv[++i], nullptr, 10);
+    } else if (a == "--stats" && i+2 < argc) {
+      statsFile = argv[++i];
+      statsColumn = strtoull(argv[++i], nullptr, 10);
+      if (statsColumn == 0) {
+	showUsage(argv[0]);
+	return -1;
+      }
+    } else if (a == "--points" && i+1 < argc) {
+      table.points = argv[++i];
+    } else if (a == "-b") {
+      table.binary = true;
+    } else if (a == "-o" && i+1 < argc) {
+      table.output = argv[++i];
+    } else if (a == "-e" && i+1 < argc) {
+      string_view e = argv[++i];
+      printResult("-e", 1, e, octCore.evaluate(e));
+      executed = true;
+    } else if (a.size() > 1 && a[0] == '-') {
+      showUsage(argv[0]);
+      return -1;
+    } else {
+      try {
+	MappedFile file(a);
+	octCore.executeFile(file, [&](size_t lineno, string_view line, const Result &r) {
+	  printResult(a, lineno, line, r);
+	});
+      } catch(exception &ex) {
+	fprintf(stderr, "%s\n", ex.what());
+	return -1;
+      }
+      executed = true;
+    }
+  }
+
+  if (!statsFile.empty()) return stats(statsFile, statsColumn, nThreads);
+
+  if (!table.expr.empty()) {
+    if (table.points.empty() == (table.count == 0)) {
+      showUsage(argv[0]);
+      return -1;
+    }
+    return tabulate(octCore, table, nThreads);
+  }
+
+  if (!executed) {
+    string line;
+    for(size_t lineno = 1;getline(cin, line);lineno++) {
+      if (line.size() != 0 && line.back() == '\r') line.pop_back();
+      printResult("-", lineno, line, octCore.evaluate(line));
+    }
+  }
+
+  if (showStats) {
+    auto &st = octCore.cacheStats();
+    fprintf(stderr, "cache : %llu hit(s), %llu miss(es), %llu bypassed, %llu eviction(s), hit rate %.1f%%, %zu entries in %zu bytes\n",
+	    (unsigned long long)st.hits, (unsigned long long)st.misses, (unsigned long long)st.bypassed,
+	    (unsigned long long)st.evictions, st.hitRate() * 100, st.entries, st.bytes);
+  }
+
+  return nErrors == 0 ? 0 : 1;
+}
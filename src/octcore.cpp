@@ -4,11 +4,23 @@
 #include <cstdlib>
 #include <cctype>
 #include <cmath>
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <algorithm>
 
 #include "octcore.hpp"
-#include "rng.hpp"
+#include "mappedfile.hpp"
+#include "modarith.hpp"
+#include "factor.hpp"
+#include "bitops.hpp"
+#include "matrix.hpp"
+#include "tabulate.hpp"
+#include "numutil.hpp"
+#include "parallel.hpp"
 
 using namespace octcore;
+using namespace numutil;
 
 namespace {
   tlfloat_octuple uplus(tlfloat_octuple a) { return a; }
@@ -24,237 +36,2475 @@ namespace {
   tlfloat_octuple bxor(tlfloat_octuple x, tlfloat_octuple y) { return tlfloat_int128_t(x) ^ tlfloat_int128_t(y); }
   tlfloat_octuple bor (tlfloat_octuple x, tlfloat_octuple y) { return tlfloat_int128_t(x) | tlfloat_int128_t(y); }
   tlfloat_octuple bsubst(tlfloat_octuple x, tlfloat_octuple y) { return y; }
+  tlfloat_octuple beq(tlfloat_octuple x, tlfloat_octuple y) { return x == y ? 1 : 0; }
+  tlfloat_octuple bne(tlfloat_octuple x, tlfloat_octuple y) { return x != y ? 1 : 0; }
+  tlfloat_octuple blt(tlfloat_octuple x, tlfloat_octuple y) { return x < y ? 1 : 0; }
+  tlfloat_octuple ble(tlfloat_octuple x, tlfloat_octuple y) { return x <= y ? 1 : 0; }
+  tlfloat_octuple bgt(tlfloat_octuple x, tlfloat_octuple y) { return x > y ? 1 : 0; }
+  tlfloat_octuple bge(tlfloat_octuple x, tlfloat_octuple y) { return x >= y ? 1 : 0; }
+  tlfloat_octuple lnot(tlfloat_octuple a) { return a == 0 ? 1 : 0; }
+  tlfloat_octuple truth(tlfloat_octuple a) { return a != 0 ? 1 : 0; }
   tlfloat_octuple ldexp_(tlfloat_octuple x, tlfloat_octuple y) { return tlfloat_ldexpo(x, int(y)); }
+
+  // Splits an integral value in [0, 2^128) into 64-bit halves
+  void toU64(tlfloat_octuple x, uint64_t &hi, uint64_t &lo) {
+    tlfloat_octuple h = tlfloat_trunco(tlfloat_ldexpo(x, -64));
+    hi = (uint64_t)h;
+    lo = (uint64_t)(x - tlfloat_ldexpo(h, 64));
+  }
+
+  // Integral values in [0, 2^128) are converted exactly, and anything else is rejected
+  bool toU128(tlfloat_octuple x, U128 &u) {
+    if (!(x >= 0 && x < 0x1p+128 && tlfloat_trunco(x) == x)) return false;
+    toU64(x, u.hi, u.lo);
+    return true;
+  }
+  tlfloat_octuple fromU128(const U128 &u) { return tlfloat_ldexpo(fromU64(u.hi), 64) + fromU64(u.lo); }
+
   tlfloat_octuple gcd(tlfloat_octuple x, tlfloat_octuple y) {
-    tlfloat_int128_t a = tlfloat_int128_t(x), b = tlfloat_int128_t(y);
-    while(b != 0) { auto t = b; b = a % b; a = t; }
-    return a;
+    U128 a, b;
+    if (!toU128(tlfloat_fabso(tlfloat_trunco(x)), a) || !toU128(tlfloat_fabso(tlfloat_trunco(y)), b)) return NAN;
+    return fromU128(gcd(a, b));
+  }
+  // Computed as a / gcd(a, b) * b on 128-bit integers, with the sign of x * y
+  tlfloat_octuple lcm(tlfloat_octuple x, tlfloat_octuple y) {
+    U128 a, b, q, r, m;
+    if (!toU128(tlfloat_fabso(tlfloat_trunco(x)), a) || !toU128(tlfloat_fabso(tlfloat_trunco(y)), b)) return NAN;
+    if (a.isZero() || b.isZero()) return 0;
+    divmod(a, gcd(a, b), q, r);
+    if (!mul128(q, b, m)) return NAN;
+    return (x < 0) != (y < 0) ? -fromU128(m) : fromU128(m);
+  }
+
+  tlfloat_octuple mulmod(tlfloat_octuple x, tlfloat_octuple y, tlfloat_octuple z) {
+    U128 a, b, m;
+    if (!toU128(x, a) || !toU128(y, b) || !toU128(z, m) || m.isZero()) return NAN;
+    return fromU128(mulmod(a, b, m));
+  }
+  tlfloat_octuple powmod(tlfloat_octuple x, tlfloat_octuple y, tlfloat_octuple z) {
+    U128 a, e, m;
+    if (!toU128(x, a) || !toU128(y, e) || !toU128(z, m) || m.isZero()) return NAN;
+    return fromU128(powmod(a, e, m));
+  }
+  tlfloat_octuple invmod(tlfloat_octuple x, tlfloat_octuple y) {
+    U128 a, m, r;
+    if (!toU128(x, a) || !toU128(y, m) || m.isZero() || !invmod(a, m, r)) return NAN;
+    return fromU128(r);
+  }
+  tlfloat_octuple isprime(tlfloat_octuple x) {
+    U128 n;
+    if (!toU128(x, n)) return NAN;
+    return isprime(n) ? 1 : 0;
+  }
+
+  // Integral values in [-2^127, 2^128) as 128-bit words, negative ones in two's complement
+  bool toBits(tlfloat_octuple x, U128 &u) {
+    if (!(x < 0)) return toU128(x, u);
+    if (!(x >= -0x1p+127) || !toU128(-x, u)) return false;
+    U128 z;
+    z.subFrom(u);
+    u = z;
+    return true;
+  }
+  tlfloat_octuple popcount(tlfloat_octuple x) { U128 u; if (!toBits(x, u)) return NAN; return bitops::popcount(u); }
+  tlfloat_octuple clz(tlfloat_octuple x) { U128 u; if (!toBits(x, u)) return NAN; return bitops::clz(u); }
+  tlfloat_octuple ctz(tlfloat_octuple x) { U128 u; if (!toBits(x, u)) return NAN; return bitops::ctz(u); }
+  tlfloat_octuple parity(tlfloat_octuple x) { U128 u; if (!toBits(x, u)) return NAN; return bitops::parity(u); }
+  tlfloat_octuple bswap(tlfloat_octuple x) { U128 u; if (!toBits(x, u)) return NAN; return fromU128(bitops::bswap(u)); }
+  tlfloat_octuple bitreverse(tlfloat_octuple x) { U128 u; if (!toBits(x, u)) return NAN; return fromU128(bitops::bitreverse(u)); }
+  tlfloat_octuple rotl(tlfloat_octuple x, tlfloat_octuple y) {
+    U128 u;
+    if (!toBits(x, u) || !(tlfloat_trunco(y) == y)) return NAN;
+    return fromU128(bitops::rotl(u, int(tlfloat_fmodo(y, 128))));
+  }
+  tlfloat_octuple rotr(tlfloat_octuple x, tlfloat_octuple y) { return rotl(x, -y); }
+  tlfloat_octuple pdep(tlfloat_octuple x, tlfloat_octuple y) {
+    U128 u, m;
+    if (!toBits(x, u) || !toBits(y, m)) return NAN;
+    return fromU128(bitops::pdep(u, m));
+  }
+  tlfloat_octuple pext(tlfloat_octuple x, tlfloat_octuple y) {
+    U128 u, m;
+    if (!toBits(x, u) || !toBits(y, m)) return NAN;
+    return fromU128(bitops::pext(u, m));
+  }
+
+  bool isint_(tlfloat_octuple x) { return x - x == 0 && tlfloat_trunco(x) == x; }
+
+  // Exact as long as the result is below 2^237. Larger results of integer
+  // expressions are recomputed by the exact integer evaluation.
+  tlfloat_octuple factorial(tlfloat_octuple x) {
+    if (!isint_(x) || x < 0) return NAN;
+    if (x > 64) return tlfloat_tgammao(x + 1);
+    tlfloat_octuple r = 1;
+    for(int i=2;i<=int(x);i++) r *= i;
+    return r;
+  }
+  tlfloat_octuple binomial(tlfloat_octuple n, tlfloat_octuple k) {
+    if (!isint_(n) || !isint_(k) || n < 0) return NAN;
+    if (k < 0 || k > n) return 0;
+    if (k > n - k) k = n - k;
+    if (k > 1000) return tlfloat_roundo(tlfloat_expo(tlfloat_lgammao(n + 1) - tlfloat_lgammao(k + 1) - tlfloat_lgammao(n - k + 1)));
+    tlfloat_octuple r = 1;
+    for(int i=1;i<=int(k);i++) r = r * (n - k + i) / i;
+    return r;
+  }
+
+  bool isfinite_(tlfloat_octuple x) { return x - x == 0; }
+
+  // Coefficients B_2k / 2k of the asymptotic expansion of digamma
+  const char *digammaCoef[] = {
+    "8.333333333333333333333333333333333333333333333333333333333333333333333333e-2",
+    "-8.333333333333333333333333333333333333333333333333333333333333333333333333e-3",
+    "3.968253968253968253968253968253968253968253968253968253968253968253968254e-3",
+    "-4.166666666666666666666666666666666666666666666666666666666666666666666667e-3",
+    "7.575757575757575757575757575757575757575757575757575757575757575757575758e-3",
+    "-2.109279609279609279609279609279609279609279609279609279609279609279609280e-2",
+    "8.333333333333333333333333333333333333333333333333333333333333333333333333e-2",
+    "-4.432598039215686274509803921568627450980392156862745098039215686274509804e-1",
+    "3.053954330270119743803954330270119743803954330270119743803954330270119744e+0",
+    "-2.645621212121212121212121212121212121212121212121212121212121212121212121e+1",
+    "2.814601449275362318840579710144927536231884057971014492753623188405797101e+2",
+    "-3.607510546398046398046398046398046398046398046398046398046398046398046398e+3",
+    "5.482758333333333333333333333333333333333333333333333333333333333333333333e+4",
+    "-9.749368238505747126436781609195402298850574712643678160919540229885057471e+5",
+    "2.005269579668807894614346227249453055904668807894614346227249453055904669e+7",
+    "-4.723848677216299019607843137254901960784313725490196078431372549019607843e+8",
+    "1.263572479591666666666666666666666666666666666666666666666666666666666667e+10",
+    "-3.808793112524536881155302207933786881155302207933786881155302207933786881e+11",
+    "1.285085049930508333333333333333333333333333333333333333333333333333333333e+13",
+    "-4.824144835485017037158167036215816703621581670362158167036215816703621582e+14",
+    "2.004031065651625273810842166323893898644729209513262669408848810842166324e+16",
+    "-9.167743603195330775699275362318840579710144927536231884057971014492753623e+17",
+    "4.597988834365650349043794326241134751773049645390070921985815602836879433e+19",
+    "-2.518047192145109569708902332022552610787904905551964375493787258493140846e+21",
+    "1.500173349215392873371144015151515151515151515151515151515151515151515152e+23",
+    "-9.689957887463594065649794289465408805031446540880503144654088050314465409e+24",
+    "6.764588237929282099094524230179847767567065812679847767567065812679847768e+26",
+    "-5.089065946866228968976633291591192528735632183908045977011494252873563218e+28",
+    "4.114728879255797869766548606761933615819209039548022598870056497175141243e+30",
+    "-3.566658209537555610968457460865182898779025193620645762369717948776647878e+32",
+  };
+
+  // Derivative of lgamma, needed for the derivatives of tgamma and lgamma
+  tlfloat_octuple digamma(tlfloat_octuple x) {
+    // Built once, thread-safely, as contexts may run concurrently
+    static const vector<tlfloat_octuple> coef = []() {
+      vector<tlfloat_octuple> v;
+      for(auto s : digammaCoef) v.push_back(tlfloat_strtoo(s, nullptr));
+      return v;
+    }();
+
+    if (x <= 0 && x == tlfloat_trunco(x)) return NAN;
+    if (x < 0.5) return digamma(1 - x) - TLFLOAT_M_PIo / tlfloat_tanpio(x);
+
+    tlfloat_octuple r = 0;
+    for(;x < 64;x += 1) r -= 1 / x;
+    tlfloat_octuple x2 = 1 / (x * x), p = x2, s = 0;
+    for(auto c : coef) { s += c * p; p *= x2; }
+    return r + tlfloat_logo(x) - 1 / (2 * x) - s;
+  }
+
+  // Derivative rules. Each takes the arguments as dual numbers and returns the value with its derivative.
+  Dual duplus(const Dual *a) { return a[0]; }
+  Dual duminus(const Dual *a) { return Dual { -a[0].v, -a[0].d }; }
+  Dual dmul(const Dual *a) { return Dual { a[0].v * a[1].v, a[0].d * a[1].v + a[0].v * a[1].d }; }
+  Dual ddiv(const Dual *a) { auto q = a[0].v / a[1].v; return Dual { q, (a[0].d - q * a[1].d) / a[1].v }; }
+  Dual dadd(const Dual *a) { return Dual { a[0].v + a[1].v, a[0].d + a[1].d }; }
+  Dual dsub(const Dual *a) { return Dual { a[0].v - a[1].v, a[0].d - a[1].d }; }
+  Dual dfmod(const Dual *a) {
+    auto r = tlfloat_fmodo(a[0].v, a[1].v);
+    return Dual { r, a[0].d - (a[0].v - r) / a[1].v * a[1].d };
+  }
+  Dual dremainder(const Dual *a) {
+    auto r = tlfloat_remaindero(a[0].v, a[1].v);
+    return Dual { r, a[0].d - (a[0].v - r) / a[1].v * a[1].d };
+  }
+
+  Dual dsqrt(const Dual *a) { auto r = tlfloat_sqrto(a[0].v); return Dual { r, a[0].d / (2 * r) }; }
+  Dual dcbrt(const Dual *a) { auto r = tlfloat_cbrto(a[0].v); return Dual { r, a[0].d / (3 * r * r) }; }
+  Dual dsin(const Dual *a) { return Dual { tlfloat_sino(a[0].v), tlfloat_coso(a[0].v) * a[0].d }; }
+  Dual dcos(const Dual *a) { return Dual { tlfloat_coso(a[0].v), -tlfloat_sino(a[0].v) * a[0].d }; }
+  Dual dtan(const Dual *a) { auto r = tlfloat_tano(a[0].v); return Dual { r, (1 + r * r) * a[0].d }; }
+  Dual dasin(const Dual *a) { return Dual { tlfloat_asino(a[0].v), a[0].d / tlfloat_sqrto((1 - a[0].v) * (1 + a[0].v)) }; }
+  Dual dacos(const Dual *a) { return Dual { tlfloat_acoso(a[0].v), -a[0].d / tlfloat_sqrto((1 - a[0].v) * (1 + a[0].v)) }; }
+  Dual datan(const Dual *a) { return Dual { tlfloat_atano(a[0].v), a[0].d / (1 + a[0].v * a[0].v) }; }
+  Dual dsinh(const Dual *a) { return Dual { tlfloat_sinho(a[0].v), tlfloat_cosho(a[0].v) * a[0].d }; }
+  Dual dcosh(const Dual *a) { return Dual { tlfloat_cosho(a[0].v), tlfloat_sinho(a[0].v) * a[0].d }; }
+  Dual dtanh(const Dual *a) { auto r = tlfloat_tanho(a[0].v); return Dual { r, (1 - r) * (1 + r) * a[0].d }; }
+  Dual dasinh(const Dual *a) { return Dual { tlfloat_asinho(a[0].v), a[0].d / tlfloat_hypoto(a[0].v, 1) }; }
+  Dual dacosh(const Dual *a) { return Dual { tlfloat_acosho(a[0].v), a[0].d / tlfloat_sqrto((a[0].v - 1) * (a[0].v + 1)) }; }
+  Dual datanh(const Dual *a) { return Dual { tlfloat_atanho(a[0].v), a[0].d / ((1 - a[0].v) * (1 + a[0].v)) }; }
+  Dual dlog(const Dual *a) { return Dual { tlfloat_logo(a[0].v), a[0].d / a[0].v }; }
+  Dual dlog2(const Dual *a) { return Dual { tlfloat_log2o(a[0].v), a[0].d / (a[0].v * TLFLOAT_M_LN2o) }; }
+  Dual dlog10(const Dual *a) { return Dual { tlfloat_log10o(a[0].v), a[0].d / (a[0].v * TLFLOAT_M_LN10o) }; }
+  Dual dlog1p(const Dual *a) { return Dual { tlfloat_log1po(a[0].v), a[0].d / (1 + a[0].v) }; }
+  Dual dexp(const Dual *a) { auto r = tlfloat_expo(a[0].v); return Dual { r, r * a[0].d }; }
+  Dual dexp2(const Dual *a) { auto r = tlfloat_exp2o(a[0].v); return Dual { r, r * TLFLOAT_M_LN2o * a[0].d }; }
+  Dual dexp10(const Dual *a) { auto r = tlfloat_exp10o(a[0].v); return Dual { r, r * TLFLOAT_M_LN10o * a[0].d }; }
+  Dual dexpm1(const Dual *a) { auto r = tlfloat_expm1o(a[0].v); return Dual { r, (r + 1) * a[0].d }; }
+  Dual derf(const Dual *a) { return Dual { tlfloat_erfo(a[0].v), TLFLOAT_M_2_SQRTPIo * tlfloat_expo(-a[0].v * a[0].v) * a[0].d }; }
+  Dual derfc(const Dual *a) { return Dual { tlfloat_erfco(a[0].v), -TLFLOAT_M_2_SQRTPIo * tlfloat_expo(-a[0].v * a[0].v) * a[0].d }; }
+  Dual dtgamma(const Dual *a) { auto r = tlfloat_tgammao(a[0].v); return Dual { r, r * digamma(a[0].v) * a[0].d }; }
+  Dual dlgamma(const Dual *a) { return Dual { tlfloat_lgammao(a[0].v), digamma(a[0].v) * a[0].d }; }
+  Dual dfabs(const Dual *a) { return Dual { tlfloat_fabso(a[0].v), tlfloat_copysigno(1, a[0].v) * a[0].d }; }
+  Dual dtanpi(const Dual *a) { auto r = tlfloat_tanpio(a[0].v); return Dual { r, TLFLOAT_M_PIo * (1 + r * r) * a[0].d }; }
+  Dual dsinpi(const Dual *a) { return Dual { tlfloat_sinpio(a[0].v), TLFLOAT_M_PIo * tlfloat_cospio(a[0].v) * a[0].d }; }
+  Dual dcospi(const Dual *a) { return Dual { tlfloat_cospio(a[0].v), -TLFLOAT_M_PIo * tlfloat_sinpio(a[0].v) * a[0].d }; }
+
+  Dual dpow(const Dual *a) {
+    auto r = tlfloat_powo(a[0].v, a[1].v);
+    tlfloat_octuple d = 0;
+    if (a[0].d != 0) d += a[1].v * tlfloat_powo(a[0].v, a[1].v - 1) * a[0].d;
+    if (a[1].d != 0) d += r * tlfloat_logo(a[0].v) * a[1].d;
+    return Dual { r, d };
+  }
+  Dual datan2(const Dual *a) {
+    return Dual { tlfloat_atan2o(a[0].v, a[1].v),
+      (a[1].v * a[0].d - a[0].v * a[1].d) / (a[0].v * a[0].v + a[1].v * a[1].v) };
+  }
+  Dual dhypot(const Dual *a) {
+    auto r = tlfloat_hypoto(a[0].v, a[1].v);
+    return Dual { r, (a[0].v * a[0].d + a[1].v * a[1].d) / r };
+  }
+  Dual dfdim(const Dual *a) { return Dual { tlfloat_fdimo(a[0].v, a[1].v), a[0].v > a[1].v ? a[0].d - a[1].d : 0 }; }
+  Dual dfmax(const Dual *a) { auto r = tlfloat_fmaxo(a[0].v, a[1].v); return Dual { r, r == a[0].v ? a[0].d : a[1].d }; }
+  Dual dfmin(const Dual *a) { auto r = tlfloat_fmino(a[0].v, a[1].v); return Dual { r, r == a[0].v ? a[0].d : a[1].d }; }
+  Dual dcopysign(const Dual *a) {
+    return Dual { tlfloat_copysigno(a[0].v, a[1].v), tlfloat_copysigno(1, a[0].v) * tlfloat_copysigno(1, a[1].v) * a[0].d };
+  }
+  Dual dfma(const Dual *a) {
+    return Dual { tlfloat_fmao(a[0].v, a[1].v, a[2].v), a[0].d * a[1].v + a[0].v * a[1].d + a[2].d };
+  }
+  Dual dldexp(const Dual *a) { return Dual { ldexp_(a[0].v, a[1].v), ldexp_(a[0].d, a[1].v) }; }
+}
+
+namespace octcore {
+  BigInt toBigInt(tlfloat_octuple x) {
+    const bool neg = x < 0;
+    x = tlfloat_fabso(x);
+    U128 u;
+    if (toU128(x, u)) return BigInt::fromLimbs(vector<uint64_t> { u.lo, u.hi }, neg);
+    int e;
+    tlfloat_frexpo(x, &e);
+    tlfloat_octuple m = tlfloat_ldexpo(x, 237 - e), h = tlfloat_trunco(tlfloat_ldexpo(m, -128));
+    U128 mh, ml;
+    toU128(h, mh);
+    toU128(m - tlfloat_ldexpo(h, 128), ml);
+    // Below 2^237, the bits shifted out are zero as x is integral
+    const BigInt b = BigInt::fromLimbs(vector<uint64_t> { ml.lo, ml.hi, mh.lo, mh.hi }, neg);
+    return e >= 237 ? b << size_t(e - 237) : b >> size_t(237 - e);
+  }
+
+  tlfloat_octuple toOctuple(const BigInt &b) {
+    auto &l = b.limbs();
+    const size_t n = l.size(), lo = n > 4 ? n - 4 : 0;
+    tlfloat_octuple r = 0;
+    for(size_t i=lo;i<n;i++) r += tlfloat_ldexpo(fromU64(l[i]), int(64 * (i - lo)));
+    r = tlfloat_ldexpo(r, int(64 * lo));
+    return b.isNegative() ? -r : r;
+  }
+}
+
+// Exact counterparts of the integer operators and functions. They throw
+// Inexact where the result would not be an integer, or where it would
+// exceed maxExactBits, and the expression is then evaluated in octuple.
+namespace {
+  struct Inexact {};
+
+  const size_t maxExactBits = 1 << 20;
+
+  BigInt checked(const BigInt &x) {
+    if (x.bitLength() > maxExactBits) throw Inexact();
+    return x;
+  }
+  // The integer that a literal denotes, with its exponent, of 10 or of 2 for
+  // a hexadecimal one, applied exactly. Throws Inexact if the literal has a
+  // fractional part, or if the integer would be too large.
+  BigInt exactLiteral(string_view s) {
+    BigInt r;
+    if (BigInt::parse(s, r)) return r;
+    const bool hex = s.substr(0, 2) == "0x";
+    const size_t pe = s.find_first_of(hex ? "pP" : "eE");
+    const string_view m = s.substr(0, pe);
+    const size_t dot = m.find('.');
+    int64_t exp = 0;
+    if (pe != string_view::npos) {
+      size_t i = pe + 1;
+      const bool negExp = i < s.size() && s[i] == '-';
+      if (i < s.size() && (s[i] == '-' || s[i] == '+')) i++;
+      for(;i<s.size();i++) exp = min<int64_t>(exp * 10 + (s[i] - '0'), int64_t(1) << 40);
+      if (negExp) exp = -exp;
+    }
+    string digits(m.substr(0, dot));
+    if (dot != string_view::npos) {
+      digits += m.substr(dot + 1);
+      exp -= int64_t(m.size() - dot - 1) * (hex ? 4 : 1);
+    }
+    if (!BigInt::parse(digits, r)) throw Inexact();
+    if (r.isZero()) return r;
+    if (hex) {
+      if (exp >= 0) {
+	if (uint64_t(exp) > maxExactBits) throw Inexact();
+	return checked(r << size_t(exp));
+      }
+      if (uint64_t(-exp) > r.bitLength() || ((r >> size_t(-exp)) << size_t(-exp)) != r) throw Inexact();
+      return r >> size_t(-exp);
+    }
+    if (exp >= 0) {
+      if (uint64_t(exp) > maxExactBits / 3) throw Inexact();
+      return checked(r * BigInt::pow(BigInt(10), uint64_t(exp)));
+    }
+    if (uint64_t(-exp) > digits.size()) throw Inexact();
+    BigInt q, rem;
+    BigInt::divMod(r, BigInt::pow(BigInt(10), uint64_t(-exp)), q, rem);
+    if (!rem.isZero()) throw Inexact();
+    return q;
   }
-  tlfloat_octuple lcm(tlfloat_octuple x, tlfloat_octuple y) { return tlfloat_trunco(x) / gcd(x, y) * tlfloat_trunco(y); }
 
-  tlfloat_octuple rnd(tlfloat_octuple x) {
-    static TLCG64 lcg64;
-    if (x < 0 || x >= 0x1p+64) return NAN;
-    uint64_t u = (uint64_t)x;
-    return tlfloat_uint128_t(u == 0 ? lcg64.next64() : lcg64.nextLT(u));
+  uint64_t toCount(const BigInt &x) {
+    int64_t v;
+    if (!x.toInt64(v) || v < 0) throw Inexact();
+    return uint64_t(v);
   }
 
+  BigInt xuplus(const BigInt *a) { return a[0]; }
+  BigInt xuminus(const BigInt *a) { return -a[0]; }
+  BigInt xnot(const BigInt *a) { return ~a[0]; }
+  BigInt xadd(const BigInt *a) { return checked(a[0] + a[1]); }
+  BigInt xsub(const BigInt *a) { return checked(a[0] - a[1]); }
+  BigInt xmul(const BigInt *a) {
+    if (a[0].bitLength() + a[1].bitLength() > maxExactBits + 1) throw Inexact();
+    return checked(a[0] * a[1]);
+  }
+  BigInt xdiv(const BigInt *a) {
+    if (a[1].isZero()) throw Inexact();
+    BigInt q, r;
+    BigInt::divMod(a[0], a[1], q, r);
+    if (!r.isZero()) throw Inexact();
+    return q;
+  }
+  BigInt xmod(const BigInt *a) {
+    if (a[1].isZero()) throw Inexact();
+    BigInt q, r;
+    BigInt::divMod(a[0], a[1], q, r);
+    return r;
+  }
+  BigInt xshl(const BigInt *a) {
+    uint64_t s = toCount(a[1]);
+    if (s > maxExactBits) throw Inexact();
+    return checked(a[0] << size_t(s));
+  }
+  BigInt xshr(const BigInt *a) {
+    uint64_t s = toCount(a[1]);
+    return a[0] >> size_t(min<uint64_t>(s, maxExactBits + 64));
+  }
+  BigInt xand(const BigInt *a) { return a[0] & a[1]; }
+  BigInt xor_(const BigInt *a) { return a[0] | a[1]; }
+  BigInt xxor(const BigInt *a) { return a[0] ^ a[1]; }
+  BigInt xsubst(const BigInt *a) { return a[1]; }
+  BigInt xeq(const BigInt *a) { return a[0] == a[1] ? 1 : 0; }
+  BigInt xne(const BigInt *a) { return a[0] != a[1] ? 1 : 0; }
+  BigInt xlt(const BigInt *a) { return a[0] < a[1] ? 1 : 0; }
+  BigInt xle(const BigInt *a) { return a[1] < a[0] ? 0 : 1; }
+  BigInt xgt(const BigInt *a) { return a[1] < a[0] ? 1 : 0; }
+  BigInt xge(const BigInt *a) { return a[0] < a[1] ? 0 : 1; }
+  BigInt xlnot(const BigInt *a) { return a[0].isZero() ? 1 : 0; }
+  BigInt xtruth(const BigInt *a) { return a[0].isZero() ? 0 : 1; }
+  BigInt xfabs(const BigInt *a) { return a[0].isNegative() ? -a[0] : a[0]; }
+  BigInt xgcd(const BigInt *a) { return BigInt::gcd(a[0], a[1]); }
+  BigInt xlcm(const BigInt *a) {
+    BigInt g = BigInt::gcd(a[0], a[1]), q, r;
+    if (g.isZero()) return g;
+    BigInt::divMod(a[0], g, q, r);
+    return checked(q * a[1]);
+  }
+  BigInt xpow(const BigInt *a) {
+    uint64_t e = toCount(a[1]);
+    if (a[0].bitLength() > 1 && (e > maxExactBits || (a[0].bitLength() - 1) * e > maxExactBits)) throw Inexact();
+    return checked(BigInt::pow(a[0], e));
+  }
+  BigInt xfactorial(const BigInt *a) {
+    uint64_t n = toCount(a[0]);
+    if (n > 2 && double(n) * (log2(double(n)) - 1.4427) > maxExactBits) throw Inexact();
+    return BigInt::factorial(n);
+  }
+  BigInt xbinomial(const BigInt *a) {
+    if (a[0].isNegative()) throw Inexact();
+    if (a[1].isNegative() || a[0] < a[1]) return BigInt();
+    uint64_t n = toCount(a[0]), k = toCount(a[1]);
+    k = min(k, n - k);
+    if (double(k) * log2(double(n) + 1) > 2.0 * maxExactBits) throw Inexact();
+    return checked(BigInt::binomial(n, k));
+  }
+}
+
+namespace octcore {
+  // dual is the derivative rule of the function. A null dual marks a piecewise constant
+  // function, whose derivative is zero wherever it is defined. cfunc, if not null, is
+  // called instead of func1-3 for functions that use the state of the context, and
+  // big, if not null, is the exact counterpart on integers.
   struct Func {
     const int narg;
     tlfloat_octuple (* const func1)(tlfloat_octuple a1), (* const func2)(tlfloat_octuple a1, tlfloat_octuple a2);
     tlfloat_octuple (* const func3)(tlfloat_octuple a1, tlfloat_octuple a2, tlfloat_octuple a3);
+    Dual (* const dual)(const Dual *a);
+    tlfloat_octuple (* const cfunc)(OctCore &c, const tlfloat_octuple *a);
+    BigInt (* const big)(const BigInt *a);
+    const bool sideEffects;		// Set if the result is not determined by the arguments
   };
 }
 
-// L8 ::= L7 L8p
-pair<string, tlfloat_octuple> OctCore::L8(Tokenizer& tk) {
-  auto lval = L7(tk), rval = L8p(tk, lval);
-  if (lval.first.substr(0, 5) == "LVAL:")
-    return pair<string, tlfloat_octuple>(lval.first, varMap[lval.first.substr(5)]);
-  return lval;
+tlfloat_octuple OctCore::call(const Func &f, const tlfloat_octuple *a) {
+  if (f.cfunc) return (*f.cfunc)(*this, a);
+  switch(f.narg) {
+  case 1: return (*f.func1)(a[0]);
+  case 2: return (*f.func2)(a[0], a[1]);
+  case 3: return (*f.func3)(a[0], a[1], a[2]);
+  default: abort();
+  }
+}
+
+namespace {
+  tlfloat_octuple rnd(OctCore &c, const tlfloat_octuple *a) {
+    if (a[0] < 0 || a[0] >= 0x1p+64) return NAN;
+    uint64_t u = (uint64_t)a[0];
+    return fromU64(u == 0 ? c.rng().next64() : c.rng().nextLT(u));
+  }
+
+  // Uniform in [0, 1). The exponent is drawn from the number of leading zeros
+  // of a random bit string, and then all 236 fraction bits are random, so that
+  // small results keep a full 237-bit mantissa instead of being multiples of 2^-237.
+  tlfloat_octuple uniform(OctCore &c, const tlfloat_octuple *) {
+    Xoshiro256 &rng = c.rng();
+    int e = -1;
+    for(;;) {
+      uint64_t u = rng.next64();
+      if (u != 0) { e -= int(rng.clz64(u)); break; }
+      e -= 64;
+      if (e < -262000) return 0;
+    }
+    tlfloat_octuple m = tlfloat_ldexpo(1, 236);
+    m += tlfloat_ldexpo(fromU64(rng.next(44)), 192);
+    m += tlfloat_ldexpo(fromU64(rng.next64()), 128);
+    m += tlfloat_ldexpo(fromU64(rng.next64()), 64);
+    m += fromU64(rng.next64());
+    return tlfloat_ldexpo(m, e - 236);
+  }
+
+  // Shows the factorization as text, and returns the argument
+  tlfloat_octuple factor(OctCore &c, const tlfloat_octuple *a) {
+    U128 n;
+    if (!toU128(a[0], n)) return NAN;
+    if (n < U128(2)) { c.setText(n.toDecimal()); return a[0]; }
+    auto f = factorize(n);
+    string s;
+    for(size_t i=0, j;i<f.size();i=j) {
+      for(j=i+1;j<f.size() && f[j] == f[i];j++) ;
+      if (i != 0) s += " * ";
+      s += f[i].toDecimal();
+      if (j - i > 1) s += "^" + to_string(j - i);
+    }
+    c.setText(s);
+    return a[0];
+  }
+
+  tlfloat_octuple seed(OctCore &c, const tlfloat_octuple *a) {
+    if (!(a[0] >= 0 && a[0] < 0x1p+128 && tlfloat_trunco(a[0]) == a[0])) return NAN;
+    uint64_t hi, lo;
+    toU64(a[0], hi, lo);
+    c.rng().seed(lo, hi);
+    return a[0];
+  }
+}
+
+// Maximal-munch scanner. The longest match among FP, the operators and
+// ID is taken, ties going to the earlier one in that order.
+//
+// FP  : (0x([0-9a-fA-F]*[.])?[0-9a-fA-F]+([pP][-+]?\d+)?)|(([0-9]*[.])?[0-9]+([eE][-+]?\d+)?)|([Ii][Nn][Ff])|([Nn][Aa][Nn])
+// ID  : [a-zA-Z_][a-zA-Z_0-9]*
+namespace {
+  bool isxdigit_(char c) { return isdigit_(c) || ('a' <= c && c <= 'f') || ('A' <= c && c <= 'F'); }
+  bool isidstart_(char c) { return ('a' <= c && c <= 'z') || ('A' <= c && c <= 'Z') || c == '_'; }
+
+  // Mantissa with an optional point followed by an optional exponent, as the
+  // first alternative of the regex above that matches
+  size_t matchNumber(string_view s, size_t i, bool (*digit)(char), char e0, char e1) {
+    size_t j = i, end = 0;
+    while(j < s.size() && digit(s[j])) j++;
+    if (j + 1 < s.size() && s[j] == '.' && digit(s[j+1])) {
+      for(end = j + 1;end < s.size() && digit(s[end]);end++) ;
+    } else if (j > i) {
+      end = j;
+    } else return 0;
+    if (end < s.size() && (s[end] == e0 || s[end] == e1)) {
+      size_t k = end + 1;
+      if (k < s.size() && (s[k] == '+' || s[k] == '-')) k++;
+      if (k < s.size() && isdigit_(s[k])) {
+	while(k < s.size() && isdigit_(s[k])) k++;
+	end = k;
+      }
+    }
+    return end;
+  }
+
+  bool matchWord(string_view s, const char *w) {
+    if (s.size() < 3) return false;
+    for(int i=0;i<3;i++) if (tolower(s[i]) != w[i]) return false;
+    return true;
+  }
+
+  size_t matchFP(string_view s) {
+    size_t n;
+    if (s.substr(0, 2) == "0x" && (n = matchNumber(s, 2, isxdigit_, 'p', 'P')) != 0) return n;
+    if ((n = matchNumber(s, 0, isdigit_, 'e', 'E')) != 0) return n;
+    if (matchWord(s, "inf") || matchWord(s, "nan")) return 3;
+    return 0;
+  }
+
+  size_t matchID(string_view s) {
+    if (s.size() == 0 || !isidstart_(s[0])) return 0;
+    size_t n = 1;
+    while(n < s.size() && (isidstart_(s[n]) || isdigit_(s[n]))) n++;
+    return n;
+  }
+
+  const string_view operators[] = {
+    "+", "-", "*", "/", "%", "<<", ">>", "&", "|", "^", "~",
+    "+=", "-=", "*=", "/=", "%=", "&=", "|=", "^=", "<<=", ">>=",
+    "==", "!=", "<", "<=", ">", ">=", "&&", "||", "!", "?", ":",
+    "(", ")", "=", ",", "[", "]",
+  };
+}
+
+Token Tokenizer::next() {
+  if (pushedBack.size() != 0) { Token t = pushedBack.back(); pushedBack.pop_back(); return t; }
+  Token ret { "", "" };
+  size_t maxnp = 0, sp = 0;
+
+  while(sp < str.size() && isspace((unsigned char)str[sp])) sp++;
+  str = str.substr(sp);
+  lastpos = pos + sp;
+
+  if (str != "") ret = Token { "character", str.substr(0, 1) };
+
+  size_t np = matchFP(str);
+  if (np > maxnp) { maxnp = np; ret = Token { "FP", str.substr(0, np) }; }
+  for(auto op : operators) {
+    if (op.size() > maxnp && str.substr(0, op.size()) == op) { maxnp = op.size(); ret = Token { op, op }; }
+  }
+  np = matchID(str);
+  if (np > maxnp) { maxnp = np; ret = Token { "ID", str.substr(0, np) }; }
+
+  if (maxnp > 0) { pos += sp + maxnp; str = str.substr(maxnp); }
+
+  ret.pos = (int)lastpos;
+
+  return ret;
+}
+
+namespace {
+  // Binary operators with their precedence. Assignment operators have the
+  // lowest precedence and are right associative, the others are left
+  // associative. The comparisons give 1 or 0. &&, || and ?: are not in the
+  // table, since they are compiled into jumps over the operand not needed.
+  struct BinOp {
+    int prec;
+    Func func;
+  };
+
+  const int precAssign = 1, precCond = 2, precOr = 3, precAnd = 4, precUnary = 13;
+
+  const unordered_map<string_view, BinOp> binOpMap = {
+    { "=", { 1, Func { 2, nullptr, bsubst, nullptr, nullptr, nullptr, xsubst } } },
+    { "+=", { 1, Func { 2, nullptr, badd, nullptr, nullptr, nullptr, xadd } } }, { "-=", { 1, Func { 2, nullptr, bsub, nullptr, nullptr, nullptr, xsub } } },
+    { "*=", { 1, Func { 2, nullptr, bmul, nullptr, nullptr, nullptr, xmul } } }, { "/=", { 1, Func { 2, nullptr, bdiv, nullptr, nullptr, nullptr, xdiv } } },
+    { "%=", { 1, Func { 2, nullptr, tlfloat_fmodo, nullptr, nullptr, nullptr, xmod } } },
+    { "&=", { 1, Func { 2, nullptr, band, nullptr, nullptr, nullptr, xand } } }, { "|=", { 1, Func { 2, nullptr, bor, nullptr, nullptr, nullptr, xor_ } } },
+    { "^=", { 1, Func { 2, nullptr, bxor, nullptr, nullptr, nullptr, xxor } } },
+    { "<<=", { 1, Func { 2, nullptr, bshl, nullptr, nullptr, nullptr, xshl } } }, { ">>=", { 1, Func { 2, nullptr, bshr, nullptr, nullptr, nullptr, xshr } } },
+    { "|", { 5, Func { 2, nullptr, bor, nullptr, nullptr, nullptr, xor_ } } },
+    { "^", { 6, Func { 2, nullptr, bxor, nullptr, nullptr, nullptr, xxor } } },
+    { "&", { 7, Func { 2, nullptr, band, nullptr, nullptr, nullptr, xand } } },
+    { "==", { 8, Func { 2, nullptr, beq, nullptr, nullptr, nullptr, xeq } } }, { "!=", { 8, Func { 2, nullptr, bne, nullptr, nullptr, nullptr, xne } } },
+    { "<", { 9, Func { 2, nullptr, blt, nullptr, nullptr, nullptr, xlt } } }, { "<=", { 9, Func { 2, nullptr, ble, nullptr, nullptr, nullptr, xle } } },
+    { ">", { 9, Func { 2, nullptr, bgt, nullptr, nullptr, nullptr, xgt } } }, { ">=", { 9, Func { 2, nullptr, bge, nullptr, nullptr, nullptr, xge } } },
+    { "<<", { 10, Func { 2, nullptr, bshl, nullptr, nullptr, nullptr, xshl } } }, { ">>", { 10, Func { 2, nullptr, bshr, nullptr, nullptr, nullptr, xshr } } },
+    { "+", { 11, Func { 2, nullptr, badd, nullptr, dadd, nullptr, xadd } } }, { "-", { 11, Func { 2, nullptr, bsub, nullptr, dsub, nullptr, xsub } } },
+    { "*", { 12, Func { 2, nullptr, bmul, nullptr, dmul, nullptr, xmul } } }, { "/", { 12, Func { 2, nullptr, bdiv, nullptr, ddiv, nullptr, xdiv } } },
+    { "%", { 12, Func { 2, nullptr, tlfloat_fmodo, nullptr, dfmod, nullptr, xmod } } },
+  };
+
+  const unordered_map<string_view, Func> unaryOpMap = {
+    { "+", Func { 1, uplus, nullptr, nullptr, duplus, nullptr, xuplus } }, { "-", Func { 1, uminus, nullptr, nullptr, duminus, nullptr, xuminus } },
+    { "~", Func { 1, unot, nullptr, nullptr, nullptr, nullptr, xnot } }, { "!", Func { 1, lnot, nullptr, nullptr, nullptr, nullptr, xlnot } },
+  };
+
+  // Applied to the right operand of && and ||, so that they give 1 or 0
+  const Func truthFunc = Func { 1, truth, nullptr, nullptr, nullptr, nullptr, xtruth };
+
+  const unordered_map<string_view, Func> funcMap = {
+    { "sqrt", Func { 1, tlfloat_sqrto, nullptr, nullptr, dsqrt } }, { "cbrt", Func { 1, tlfloat_cbrto, nullptr, nullptr, dcbrt } },
+    { "sin", Func { 1, tlfloat_sino, nullptr, nullptr, dsin } }, { "cos", Func { 1, tlfloat_coso, nullptr, nullptr, dcos } },
+    { "tan", Func { 1, tlfloat_tano, nullptr, nullptr, dtan } }, { "asin", Func { 1, tlfloat_asino, nullptr, nullptr, dasin } },
+    { "acos", Func { 1, tlfloat_acoso, nullptr, nullptr, dacos } }, { "atan", Func { 1, tlfloat_atano, nullptr, nullptr, datan } },
+    { "sinh", Func { 1, tlfloat_sinho, nullptr, nullptr, dsinh } }, { "cosh", Func { 1, tlfloat_cosho, nullptr, nullptr, dcosh } },
+    { "tanh", Func { 1, tlfloat_tanho, nullptr, nullptr, dtanh } }, { "asinh", Func { 1, tlfloat_asinho, nullptr, nullptr, dasinh } },
+    { "acosh", Func { 1, tlfloat_acosho, nullptr, nullptr, dacosh } }, { "atanh", Func { 1, tlfloat_atanho, nullptr, nullptr, datanh } },
+    { "log", Func { 1, tlfloat_logo, nullptr, nullptr, dlog } }, { "log2", Func { 1, tlfloat_log2o, nullptr, nullptr, dlog2 } },
+    { "log10", Func { 1, tlfloat_log10o, nullptr, nullptr, dlog10 } }, { "log1p", Func { 1, tlfloat_log1po, nullptr, nullptr, dlog1p } },
+    { "exp", Func { 1, tlfloat_expo, nullptr, nullptr, dexp } }, { "exp2", Func { 1, tlfloat_exp2o, nullptr, nullptr, dexp2 } },
+    { "exp10", Func { 1, tlfloat_exp10o, nullptr, nullptr, dexp10 } }, { "expm1", Func { 1, tlfloat_expm1o, nullptr, nullptr, dexpm1 } },
+    { "erf", Func { 1, tlfloat_erfo, nullptr, nullptr, derf } }, { "erfc", Func { 1, tlfloat_erfco, nullptr, nullptr, derfc } },
+    { "tgamma", Func { 1, tlfloat_tgammao, nullptr, nullptr, dtgamma } }, { "lgamma", Func { 1, tlfloat_lgammao, nullptr, nullptr, dlgamma } },
+    { "trunc", Func { 1, tlfloat_trunco, nullptr, nullptr, nullptr, nullptr, xuplus } }, { "floor", Func { 1, tlfloat_flooro, nullptr, nullptr, nullptr, nullptr, xuplus } },
+    { "ceil", Func { 1, tlfloat_ceilo, nullptr, nullptr, nullptr, nullptr, xuplus } }, { "round", Func { 1, tlfloat_roundo, nullptr, nullptr, nullptr, nullptr, xuplus } },
+    { "rint", Func { 1, tlfloat_rinto, nullptr, nullptr, nullptr, nullptr, xuplus } }, { "fabs", Func { 1, tlfloat_fabso, nullptr, nullptr, dfabs, nullptr, xfabs } },
+    { "pow", Func { 2, nullptr, tlfloat_powo, nullptr, dpow, nullptr, xpow } }, { "atan2", Func { 2, nullptr, tlfloat_atan2o, nullptr, datan2 } },
+    { "hypot", Func { 2, nullptr, tlfloat_hypoto, nullptr, dhypot } }, { "fdim", Func { 2, nullptr, tlfloat_fdimo, nullptr, dfdim } },
+    { "fmax", Func { 2, nullptr, tlfloat_fmaxo, nullptr, dfmax } }, { "fmin", Func { 2, nullptr, tlfloat_fmino, nullptr, dfmin } },
+    { "fmod", Func { 2, nullptr, tlfloat_fmodo, nullptr, dfmod, nullptr, xmod } }, { "remainder", Func { 2, nullptr, tlfloat_remaindero, nullptr, dremainder } },
+    { "copysign", Func { 2, nullptr, tlfloat_copysigno, nullptr, dcopysign } }, { "fma", Func { 3, nullptr, nullptr, tlfloat_fmao, dfma } },
+    { "ldexp", Func { 2, nullptr, ldexp_, nullptr, dldexp } }, { "int", Func { 1, tlfloat_trunco, nullptr, nullptr, nullptr, nullptr, xuplus } },
+    { "gcd", Func { 2, nullptr, gcd, nullptr, nullptr, nullptr, xgcd } }, { "lcm", Func { 2, nullptr, lcm, nullptr, nullptr, nullptr, xlcm } },
+    { "mulmod", Func { 3, nullptr, nullptr, mulmod, nullptr } }, { "powmod", Func { 3, nullptr, nullptr, powmod, nullptr } },
+    { "invmod", Func { 2, nullptr, invmod, nullptr, nullptr } }, { "isprime", Func { 1, isprime, nullptr, nullptr, nullptr } },
+    { "factor", Func { 1, nullptr, nullptr, nullptr, nullptr, factor } },
+    { "popcount", Func { 1, popcount, nullptr, nullptr, nullptr } }, { "parity", Func { 1, parity, nullptr, nullptr, nullptr } },
+    { "clz", Func { 1, clz, nullptr, nullptr, nullptr } }, { "ctz", Func { 1, ctz, nullptr, nullptr, nullptr } },
+    { "bswap", Func { 1, bswap, nullptr, nullptr, nullptr } }, { "bitreverse", Func { 1, bitreverse, nullptr, nullptr, nullptr } },
+    { "rotl", Func { 2, nullptr, rotl, nullptr, nullptr } }, { "rotr", Func { 2, nullptr, rotr, nullptr, nullptr } },
+    { "pdep", Func { 2, nullptr, pdep, nullptr, nullptr } }, { "pext", Func { 2, nullptr, pext, nullptr, nullptr } },
+    { "factorial", Func { 1, factorial, nullptr, nullptr, nullptr, nullptr, xfactorial } },
+    { "binomial", Func { 2, nullptr, binomial, nullptr, nullptr, nullptr, xbinomial } },
+    { "rnd", Func { 1, nullptr, nullptr, nullptr, nullptr, rnd, nullptr, true } }, { "tanpi", Func { 1, tlfloat_tanpio, nullptr, nullptr, dtanpi } },
+    { "sinpi", Func { 1, tlfloat_sinpio, nullptr, nullptr, dsinpi } }, { "cospi", Func { 1, tlfloat_cospio, nullptr, nullptr, dcospi } },
+    { "uniform", Func { 0, nullptr, nullptr, nullptr, nullptr, uniform, nullptr, true } },
+    { "seed", Func { 1, nullptr, nullptr, nullptr, nullptr, seed, nullptr, true } },
+  };
+  const unordered_map<string_view, tlfloat_octuple> constMap = {
+    { "M_E", TLFLOAT_M_Eo }, { "M_LOG2E", TLFLOAT_M_LOG2Eo }, { "M_LOG10E", TLFLOAT_M_LOG10Eo }, { "M_LN2", TLFLOAT_M_LN2o },
+    { "M_LN10", TLFLOAT_M_LN10o }, { "M_PI", TLFLOAT_M_PIo }, { "M_PI_2", TLFLOAT_M_PI_2o }, { "M_PI_4", TLFLOAT_M_PI_4o },
+    { "M_1_PI", TLFLOAT_M_1_PIo }, { "M_2_PI", TLFLOAT_M_2_PIo }, { "M_2_SQRTPI", TLFLOAT_M_2_SQRTPIo },
+    { "M_SQRT2", TLFLOAT_M_SQRT2o }, { "M_SQRT1_2", TLFLOAT_M_SQRT1_2o },
+  };
+
+  // Builtins that build, reduce or operate on arrays and matrices. They
+  // compile to opcodes of their own, since the value stack only holds scalars.
+  enum Reduction { SUM, PROD, MIN, MAX, DOT };
+  enum MatrixOp { MATMUL, TRANSPOSE, DET, INV, LINSOLVE };
+
+  struct ArrayFunc {
+    int narg;
+    Insn::Opcode opcode;
+    int kind;			// Reduction or MatrixOp
+  };
+
+  const unordered_map<string_view, ArrayFunc> arrayFuncMap = {
+    { "range", { 3, Insn::RANGE, SUM } }, { "sum", { 1, Insn::REDUCE, SUM } }, { "prod", { 1, Insn::REDUCE, PROD } },
+    { "min", { 1, Insn::REDUCE, MIN } }, { "max", { 1, Insn::REDUCE, MAX } }, { "dot", { 2, Insn::REDUCE, DOT } },
+    { "matmul", { 2, Insn::MATRIX, MATMUL } }, { "transpose", { 1, Insn::MATRIX, TRANSPOSE } },
+    { "det", { 1, Insn::MATRIX, DET } }, { "inv", { 1, Insn::MATRIX, INV } }, { "linsolve", { 2, Insn::MATRIX, LINSOLVE } },
+  };
+
+
+  // An entry of the operator stack of the parser. Parentheses, function calls
+  // and diff/solve are markers with precedence 0, which are never reduced.
+  struct Pending {
+    enum Kind { OP, ASSIGN, PAREN, CALL, DIFF, BRACKET, AFUNC, SHORT, QUESTION, ELSE, LOOP, MONTECARLO } kind;
+    int prec, pos;
+    const Func *func = nullptr;
+    string_view name;			// ASSIGN : target, otherwise the operator or function name
+    tlfloat_octuple *var = nullptr;	// ASSIGN : target, DIFF : variable
+    int narg = 0;			// CALL : arguments so far, DIFF : arguments consumed, LOOP, MONTECARLO : commas seen
+    size_t jump = 0, body = 0;		// DIFF : position of the JUMP, end of the body, LOOP : position of the LOOP and TEST,
+					// MONTECARLO : position of the MONTECARLO,
+					// SHORT, QUESTION, ELSE : position of the AND, OR, BRANCH or JUMP
+    const ArrayFunc *afunc = nullptr;	// AFUNC : the array builtin
+  };
 }
 
-// L8p ::= OP L7 L8p | epsilon      OP : = += -= ...
-pair<string, tlfloat_octuple> OctCore::L8p(Tokenizer& tk, const pair<string, tlfloat_octuple> &lval) {
-  static const unordered_map<string, tlfloat_octuple (* const)(const tlfloat_octuple, const tlfloat_octuple)> opMap = {
-    { "=", bsubst }, { "+=", badd }, { "-=", bsub }, { "*=", bmul }, { "/=", bdiv },
-    { "%=", tlfloat_fmodo }, { "&=", band }, { "|=", bor }, { "^=", bxor },
-    { "<<=", bshl }, { ">>=", bshr },
+// Operator-precedence parser. Operators waiting for their right operand are
+// kept on an explicit stack instead of the C++ call stack, so the stack
+// depth does not grow with the length of the expression, and each token
+// is handled once.
+//
+// E  ::= P | U E | E OP E | E ? E : E
+// P  ::= FP | ID | ( E ) | F ( ) | F ( E , ... ) | D ( E , ID , E )		D : diff solve
+bool OctCore::parse(Tokenizer& tk) {
+  vector<Pending, ArenaAllocator<Pending>> ops { ArenaAllocator<Pending>(arena) };
+  int depth = 0;
+
+  // Emits the pending operators whose precedence is prec or higher
+  auto reduce = [&](int prec) {
+    while(!ops.empty() && ops.back().prec >= prec) {
+      const Pending &p = ops.back();
+      if (p.kind == Pending::SHORT) {
+	emit(Insn::CALL, p.pos, &truthFunc);
+	code.back().name = p.name;
+	code[p.jump].len = int(code.size() - p.jump - 1);
+      } else if (p.kind == Pending::ELSE) {
+	// A variable at the end of the false branch is not the result
+	if (isLval()) emit(Insn::CALL, p.pos, &unaryOpMap.at("+"));
+	code[p.jump].len = int(code.size() - p.jump - 1);
+      } else {
+	emit(p.kind == Pending::ASSIGN ? Insn::ASSIGN : Insn::CALL, p.pos, p.func);
+	code.back().var = p.var;
+	code.back().name = p.name;
+      }
+      ops.pop_back();
+    }
+  };
+
+  auto open = [&](Pending::Kind k, const Token &t) {
+    if (++depth > maxDepth) return fail(Error::NESTING, t.pos);
+    ops.push_back(Pending { k, 0, t.pos });
+    ops.back().name = t.second;
+    return true;
   };
-  auto t0 = tk.next();
-  if (opMap.count(t0.first) == 0) {
-    tk.pushBack(t0);
-    return pair<string, tlfloat_octuple>("", 0);
-  }
-  if (lval.first.substr(0, 5) != "LVAL:") throw(runtime_error("Expected l-value before assignment operator at column " + to_string(t0.pos)));
-  auto rval = L7(tk), rval2 = L8p(tk, rval);
-  varMap[lval.first.substr(5)] =
-    (*opMap.at(t0.first))(varMap[lval.first.substr(5)],
-			  rval.first.substr(0, 5) == "LVAL:" ? varMap[rval.first.substr(5)] : rval.second);
-  return pair<string, tlfloat_octuple>(rval.first, varMap[lval.first.substr(5)]);
-}
-
-// L7p ::= OP L6 L7p | epsilon      OP : |
-pair<string, tlfloat_octuple> OctCore::L7p(Tokenizer& tk, pair<string, tlfloat_octuple> lhs) {
-  auto t0 = tk.next();
-  if (t0.first == "|") return L7p(tk, pair<string, tlfloat_octuple>("RVAL", bor(lhs.second, L6(tk).second)));
-  tk.pushBack(t0);
-  return lhs;
-}
-
-// L6p ::= OP L5 L6p | epsilon      OP : ^
-pair<string, tlfloat_octuple> OctCore::L6p(Tokenizer& tk, pair<string, tlfloat_octuple> lhs) {
-  auto t0 = tk.next();
-  if (t0.first == "^") return L6p(tk, pair<string, tlfloat_octuple>("RVAL", bxor(lhs.second, L5(tk).second)));
-  tk.pushBack(t0);
-  return lhs;
-}
-
-// L5p ::= OP L4 L5p | epsilon      OP : &
-pair<string, tlfloat_octuple> OctCore::L5p(Tokenizer& tk, pair<string, tlfloat_octuple> lhs) {
-  auto t0 = tk.next();
-  if (t0.first == "&") return L5p(tk, pair<string, tlfloat_octuple>("RVAL", band(lhs.second, L4(tk).second)));
-  tk.pushBack(t0);
-  return lhs;
-}
-
-// L4p ::= OP L3 L4p | epsilon      OP : << >>
-pair<string, tlfloat_octuple> OctCore::L4p(Tokenizer& tk, pair<string, tlfloat_octuple> lhs) {
-  static const unordered_map<string, tlfloat_octuple (* const)(tlfloat_octuple, tlfloat_octuple)> opMap = {
-    { "<<", bshl }, { ">>", bshr },
+
+  auto expect = [&](const char *s) {
+    auto t = tk.next();
+    return t.first == s || fail(Error::EXPECTED, t.pos, s);
   };
-  auto t0 = tk.next();
-  if (opMap.count(t0.first) != 0) {
-    auto c0 = L3(tk);
-    return L4p(tk, pair<string, tlfloat_octuple>("RVAL", (*opMap.at(t0.first))(lhs.second, c0.second)));
+
+  for(;;) {
+    // An operand is expected
+    auto t0 = tk.next();
+
+    if (unaryOpMap.count(t0.first) != 0) {
+      ops.push_back(Pending { Pending::OP, precUnary, t0.pos, &unaryOpMap.at(t0.first), t0.first });
+      continue;
+    } else if (t0.first == "(") {
+      if (!open(Pending::PAREN, t0)) return false;
+      continue;
+    } else if (t0.first == "[") {
+      auto t1 = tk.next();
+      if (t1.first != "]") {
+	tk.pushBack(t1);
+	if (!open(Pending::BRACKET, t0)) return false;
+	ops.back().narg = 1;
+	continue;
+      }
+      emit(Insn::ARRAY, t0.pos);
+      hasArrays = true;
+    } else if (t0.first == "FP") {
+      emit(Insn::NUM, t0.pos);
+      code.back().name = t0.second;
+      char buf[128];
+      if (t0.second.size() < sizeof(buf)) {
+	buf[t0.second.copy(buf, t0.second.size())] = '\0';
+	code.back().val = tlfloat_strtoo(buf, nullptr);
+      } else {
+	code.back().val = tlfloat_strtoo(string(t0.second).c_str(), nullptr);
+      }
+    } else if (t0.first == "ID" && funcMap.count(t0.second) != 0) {
+      const Func &f = funcMap.at(t0.second);
+      if (!expect("(")) return false;
+      if (f.narg == 0) {
+	if (!expect(")")) return false;
+	emit(Insn::CALL, t0.pos, &f);
+	code.back().name = t0.second;
+      } else {
+	if (!open(Pending::CALL, t0)) return false;
+	ops.back().func = &f;
+	ops.back().narg = 1;
+	continue;
+      }
+    } else if (t0.first == "ID" && arrayFuncMap.count(t0.second) != 0) {
+      if (!expect("(") || !open(Pending::AFUNC, t0)) return false;
+      ops.back().afunc = &arrayFuncMap.at(t0.second);
+      ops.back().narg = 1;
+      continue;
+    } else if (t0.first == "ID" && (t0.second == "diff" || t0.second == "solve")) {
+      // The body is compiled once and skipped over in normal flow. It is run
+      // with dual numbers, with the variable bound to the value of the third argument.
+      if (!expect("(") || !open(Pending::DIFF, t0)) return false;
+      ops.back().jump = code.size();
+      emit(Insn::JUMP, t0.pos);
+      continue;
+    } else if (t0.first == "ID" && (t0.second == "iterate" || t0.second == "while")) {
+      // The body is compiled once, and NEXT jumps back to the LOOP. The
+      // iterations left and the last value of the body are kept on the stack.
+      if (!expect("(") || !open(Pending::LOOP, t0)) return false;
+      if (t0.second == "while") {
+	ops.back().jump = code.size();
+	emit(Insn::LOOP, t0.pos);
+	code.back().name = t0.second;
+      }
+      continue;
+    } else if (t0.first == "ID" && t0.second == "montecarlo") {
+      // The body follows the MONTECARLO, which runs it on all cores and skips over it
+      if (!expect("(") || !open(Pending::MONTECARLO, t0)) return false;
+      continue;
+    } else if (t0.first == "ID" && constMap.count(t0.second) != 0) {
+      emit(Insn::NUM, t0.pos);
+      code.back().val = constMap.at(t0.second);
+    } else if (t0.first == "ID") {
+      emit(Insn::VAR, t0.pos);
+      code.back().var = &varMap[string(t0.second)];
+      code.back().name = t0.second;
+      if (!arrays.empty() && arrays.count(code.back().var) != 0) hasArrays = true;
+    } else {
+      return fail(t0.first == "" ? Error::UNEXPECTED_END : t0.first == "character" ? Error::UNEXPECTED_CHAR : Error::UNEXPECTED_TOKEN,
+		  t0.pos, t0.second);
+    }
+
+    // An operator, a closing parenthesis or a comma is expected
+    for(;;) {
+      auto t1 = tk.next();
+
+      if (t1.first == "&&" || t1.first == "||") {
+	// The right operand is skipped if the left one decides the result
+	const int prec = t1.first == "&&" ? precAnd : precOr;
+	reduce(prec);
+	ops.push_back(Pending { Pending::SHORT, prec, t1.pos, nullptr, t1.first });
+	ops.back().jump = code.size();
+	emit(t1.first == "&&" ? Insn::AND : Insn::OR, t1.pos);
+	code.back().name = t1.first;
+	break;
+      }
+
+      if (t1.first == "?") {
+	reduce(precCond + 1);
+	if (!open(Pending::QUESTION, t1)) return false;
+	ops.back().jump = code.size();
+	emit(Insn::BRANCH, t1.pos);
+	code.back().name = t1.first;
+	break;
+      }
+
+      if (binOpMap.count(t1.first) != 0) {
+	auto &op = binOpMap.at(t1.first);
+	if (op.prec == precAssign) {
+	  reduce(precAssign + 1);
+	  if (!isLval()) return fail(Error::NOT_LVALUE, t1.pos);
+	  ops.push_back(Pending { Pending::ASSIGN, precAssign, t1.pos, &op.func, code.back().name, code.back().var });
+	} else {
+	  reduce(op.prec);
+	  ops.push_back(Pending { Pending::OP, op.prec, t1.pos, &op.func, t1.first });
+	}
+	break;
+      }
+
+      reduce(1);
+
+      if (ops.empty()) { tk.pushBack(t1); return true; }
+      Pending &m = ops.back();
+
+      if (m.kind == Pending::QUESTION) {
+	if (t1.first != ":") return fail(Error::EXPECTED, t1.pos, ":");
+	// The true branch ends with a jump over the false branch, which is
+	// closed like a right associative operator
+	emit(Insn::JUMP, t1.pos);
+	code[m.jump].len = int(code.size() - m.jump - 1);
+	m.kind = Pending::ELSE;
+	m.prec = precCond;
+	m.jump = code.size() - 1;
+	depth--;
+	break;
+      }
+
+      if ((m.kind == Pending::CALL || m.kind == Pending::AFUNC || m.kind == Pending::BRACKET) && t1.first == ",") { m.narg++; break; }
+
+      if (m.kind == Pending::CALL && (t1.first == ")" || m.narg != m.func->narg)) {
+	if (m.narg != m.func->narg) return fail(Error::ARG_COUNT, m.pos, m.name, m.func->narg);
+	emit(Insn::CALL, m.pos, m.func);
+	code.back().name = m.name;
+	ops.pop_back();
+	depth--;
+	continue;
+      }
+
+      if (m.kind == Pending::AFUNC && (t1.first == ")" || m.narg != m.afunc->narg)) {
+	if (m.narg != m.afunc->narg) return fail(Error::ARG_COUNT, m.pos, m.name, m.afunc->narg);
+	emit(m.afunc->opcode, m.pos);
+	code.back().name = m.name;
+	code.back().len = m.afunc->kind;
+	hasArrays = true;
+	ops.pop_back();
+	depth--;
+	continue;
+      }
+
+      if (m.kind == Pending::BRACKET) {
+	if (t1.first != "]") return fail(Error::EXPECTED, t1.pos, "]");
+	emit(Insn::ARRAY, m.pos);
+	code.back().len = m.narg;
+	hasArrays = true;
+	ops.pop_back();
+	depth--;
+	continue;
+      }
+
+      if (m.kind == Pending::DIFF && m.narg == 0) {
+	auto t3 = tk.next(), t4 = tk.next();
+	if (t1.first != "," || t4.first != ",") return fail(Error::ARG_COUNT, m.pos, m.name, 3);
+	if (t3.first != "ID" || funcMap.count(t3.second) != 0 || constMap.count(t3.second) != 0)
+	  return fail(Error::VAR_EXPECTED, t3.pos);
+	m.body = code.size();
+	m.var = &varMap[string(t3.second)];
+	m.narg = 2;
+	break;
+      }
+
+      if (m.kind == Pending::LOOP && m.narg == 0) {
+	// The count of iterate() is on the stack when LOOP is reached, and the
+	// condition of while() is tested at each iteration
+	if (t1.first != ",") return fail(Error::ARG_COUNT, m.pos, m.name, 2);
+	if (m.name == "iterate") {
+	  m.jump = code.size();
+	  emit(Insn::LOOP, m.pos);
+	  code.back().name = m.name;
+	  code.back().off = 1;
+	} else {
+	  m.body = code.size();
+	  emit(Insn::TEST, m.pos);
+	}
+	m.narg = 1;
+	break;
+      }
+
+      if (m.kind == Pending::MONTECARLO && m.narg == 0) {
+	if (t1.first != ",") return fail(Error::ARG_COUNT, m.pos, m.name, 2);
+	m.jump = code.size();
+	emit(Insn::MONTECARLO, m.pos);
+	code.back().name = m.name;
+	m.narg = 1;
+	break;
+      }
+
+      if (t1.first != ")") return fail(Error::EXPECTED, t1.pos, ")");
+
+      if (m.kind == Pending::MONTECARLO) {
+	// The body is run by several threads at once, which read the variables
+	for(size_t i=m.jump+1;i<code.size();i++) {
+	  if (code[i].opcode == Insn::ASSIGN) return fail(Error::MONTECARLO_ASSIGN, code[i].pos);
+	}
+	code[m.jump].len = int(code.size() - 1 - m.jump);
+      }
+
+      if (m.kind == Pending::LOOP) {
+	const size_t skip = m.name == "iterate" ? m.jump : m.body;
+	emit(Insn::NEXT, m.pos);
+	code.back().name = m.name;
+	code.back().off = code[m.jump].off;
+	code.back().len = int(code.size() - 1 - m.jump);
+	code[skip].len = int(code.size() - 1 - skip);
+      }
+
+      if (m.kind == Pending::DIFF) {
+	// The body is run with dual numbers, which cannot be assigned or differentiated again
+	for(size_t i=m.jump+1;i<m.body;i++) {
+	  if (code[i].opcode == Insn::ASSIGN) return fail(Error::DIFF_ASSIGN, code[i].pos);
+	  else if (code[i].opcode == Insn::DIFF || code[i].opcode == Insn::SOLVE) return fail(Error::DIFF_NESTED, code[i].pos);
+	  else if (code[i].opcode == Insn::LOOP || code[i].opcode == Insn::MONTECARLO) return fail(Error::DIFF_LOOP, code[i].pos);
+	}
+	const int len = int(m.body - m.jump - 1);
+	code[m.jump].len = len;
+	emit(m.name == "diff" ? Insn::DIFF : Insn::SOLVE, m.pos);
+	code.back().var = m.var;
+	code.back().name = m.name;
+	code.back().len = len;
+	code.back().off = int(code.size() - m.jump - 2);
+      }
+      ops.pop_back();
+      depth--;
+    }
   }
-  tk.pushBack(t0);
-  return lhs;
 }
 
-// L3p ::= OP L2 L3p | epsilon      OP : + -
-pair<string, tlfloat_octuple> OctCore::L3p(Tokenizer& tk, pair<string, tlfloat_octuple> lhs) {
-  static const unordered_map<string, tlfloat_octuple (* const)(tlfloat_octuple, tlfloat_octuple)> opMap = {
-    { "+", badd }, { "-", bsub },
+namespace {
+  uint64_t nanoseconds() {
+    return uint64_t(chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count());
+  }
+}
+
+tlfloat_octuple OctCore::run(const Insn *pc, const Insn *end) {
+  return profile_ ? runCode<true>(pc, end) : runCode<false>(pc, end);
+}
+
+// The profiled version reads the clock before each insn, and charges the
+// time since the previous reading to the previous insn, with the top of the
+// stack as its result. The time of DIFF, SOLVE and MONTECARLO includes that
+// of their bodies, which they run themselves.
+template<bool profiled> tlfloat_octuple OctCore::runCode(const Insn *pc, const Insn *end) {
+  const size_t sp = stack.size();
+  const Insn *timed = nullptr;
+  uint64_t t0 = 0;
+  auto charge = [&](uint64_t t) {
+    const size_t i = size_t(timed - code.data());
+    if (i >= profile_->size()) return;
+    InsnProfile &p = (*profile_)[i];
+    p.count++;
+    p.ns += t - t0;
+    p.seq = ++profileSeq;
+    if (!stack.empty()) p.last = stack.back();
   };
-  auto t0 = tk.next();
-  if (opMap.count(t0.first) != 0) {
-    auto c0 = L2(tk);
-    return L3p(tk, pair<string, tlfloat_octuple>("RVAL", (*opMap.at(t0.first))(lhs.second, c0.second)));
+
+  for(;pc < end;pc++) {
+    if constexpr (profiled) {
+      const uint64_t t = nanoseconds();
+      if (timed) charge(t);
+      timed = pc;
+      t0 = t;
+    }
+    switch(pc->opcode) {
+    case Insn::NUM: stack.push_back(pc->val); break;
+    case Insn::VAR: stack.push_back(*pc->var); break;
+    case Insn::CALL: {
+      const int n = pc->func->narg;
+      if (checkRange && pc->func->big == xshl) checkShift(stack[stack.size()-2], stack.back());
+      auto r = call(*pc->func, stack.data() + stack.size() - n);
+      stack.resize(stack.size() - n);
+      stack.push_back(r);
+      break;
+    }
+    case Insn::ASSIGN: {
+      auto r = stack.back();
+      stack.pop_back();
+      if (checkRange && pc->func->big == xshl) checkShift(*pc->var, r);
+      stack.back() = *pc->var = (*pc->func->func2)(*pc->var, r);
+      break;
+    }
+    case Insn::JUMP: pc += pc->len; break;
+    case Insn::AND: case Insn::OR:
+      if ((stack.back() != 0) == (pc->opcode == Insn::OR)) {
+	stack.back() = pc->opcode == Insn::OR ? 1 : 0;
+	pc += pc->len;
+      } else {
+	stack.pop_back();
+      }
+      break;
+    case Insn::BRANCH: {
+      const bool c = stack.back() != 0;
+      stack.pop_back();
+      if (!c) pc += pc->len;
+      break;
+    }
+    case Insn::DIFF: {
+      const Insn *body = pc - pc->off;
+      stack.back() = runDual(body, body + pc->len, pc->var, Dual { stack.back(), 1 }).d;
+      break;
+    }
+    case Insn::SOLVE: {
+      const Insn *body = pc - pc->off;
+      stack.back() = solve(body, body + pc->len, pc->var, stack.back(), pc->pos);
+      if (err_) { stack.resize(sp); return NAN; }
+      break;
+    }
+    case Insn::LOOP:
+      if (pc->off) {
+	const auto n = stack.back();
+	if (!(n >= 0 && n <= maxIterations && isint_(n))) { fail(Error::ITERATION_COUNT, pc->pos, pc->name); stack.resize(sp); return NAN; }
+	if (n == 0) { stack.back() = NAN; pc += pc->len; break; }
+      } else {
+	stack.push_back(maxIterations);
+      }
+      stack.push_back(NAN);
+      break;
+    case Insn::TEST: {
+      const bool c = stack.back() != 0;
+      stack.pop_back();
+      if (!c) {
+	stack[stack.size()-2] = stack.back();
+	stack.pop_back();
+	pc += pc->len;
+      }
+      break;
+    }
+    case Insn::NEXT: {
+      const auto r = stack.back();
+      stack.pop_back();
+      stack.back() = r;
+      auto &left = stack[stack.size()-2];
+      left -= 1;
+      if (left != 0) { pc -= pc->len; break; }
+      if (!pc->off) { fail(Error::ITERATION_LIMIT, pc->pos, pc->name); stack.resize(sp); return NAN; }
+      left = r;
+      stack.pop_back();
+      break;
+    }
+    case Insn::MONTECARLO: {
+      const auto n = stack.back();
+      if (!(n >= 1 && n <= maxIterations && isint_(n))) { fail(Error::ITERATION_COUNT, pc->pos, pc->name); stack.resize(sp); return NAN; }
+      // The result is shown with its standard error if it is that of the whole expression
+      const Insn *body = pc + 1;
+      pc += pc->len;
+      stack.back() = monteCarlo(body, pc + 1, uint64_t(n), pc + 1 == code.data() + code.size());
+      if (err_) { stack.resize(sp); return NAN; }
+      break;
+    }
+    case Insn::ARRAY: case Insn::RANGE: case Insn::REDUCE: case Insn::MATRIX: abort();	// Code with arrays goes to runArray
+    }
+    // Only set for code without jumps, in which every insn leaves its result on top
+    if (checkRange && !(tlfloat_fabso(stack.back()) < 0x1p+127)) outOfRange = true;
   }
-  tk.pushBack(t0);
-  return lhs;
+  if constexpr (profiled) if (timed) charge(nanoseconds());
+  auto r = stack.back();
+  stack.resize(sp);
+  return r;
 }
 
-// L2p ::= OP L1 L2p | epsilon      OP : * / %
-pair<string, tlfloat_octuple> OctCore::L2p(Tokenizer& tk, pair<string, tlfloat_octuple> lhs) {
-  static const unordered_map<string, tlfloat_octuple (* const)(tlfloat_octuple, tlfloat_octuple)> opMap = {
-    { "*", bmul }, { "/", bdiv }, { "%", tlfloat_fmodo },
+// Evaluates the body with the variable bound to x, propagating derivatives
+Dual OctCore::runDual(const Insn *pc, const Insn *end, const tlfloat_octuple *var, Dual x) {
+  const size_t sp = dstack.size();
+  for(;pc < end;pc++) {
+    switch(pc->opcode) {
+    case Insn::NUM: dstack.push_back(Dual { pc->val, 0 }); break;
+    case Insn::VAR: dstack.push_back(pc->var == var ? x : Dual { *pc->var, 0 }); break;
+    case Insn::CALL: {
+      const Func &f = *pc->func;
+      Dual *a = dstack.data() + dstack.size() - f.narg;
+      bool constant = true;
+      tlfloat_octuple v[3];
+      for(int i=0;i<f.narg;i++) { v[i] = a[i].v; constant = constant && a[i].d == 0; }
+      Dual r = constant || f.dual == nullptr ? Dual { call(f, v), 0 } : (*f.dual)(a);
+      dstack.resize(dstack.size() - f.narg);
+      dstack.push_back(r);
+      break;
+    }
+    case Insn::JUMP: pc += pc->len; break;
+    case Insn::AND: case Insn::OR:
+      if ((dstack.back().v != 0) == (pc->opcode == Insn::OR)) {
+	dstack.back() = Dual { pc->opcode == Insn::OR ? 1 : 0, 0 };
+	pc += pc->len;
+      } else {
+	dstack.pop_back();
+      }
+      break;
+    case Insn::BRANCH: {
+      const bool c = dstack.back().v != 0;
+      dstack.pop_back();
+      if (!c) pc += pc->len;
+      break;
+    }
+    case Insn::ASSIGN: case Insn::DIFF: case Insn::SOLVE: abort();	// Rejected by the parser
+    case Insn::LOOP: case Insn::TEST: case Insn::NEXT: case Insn::MONTECARLO: abort();
+    case Insn::ARRAY: case Insn::RANGE: case Insn::REDUCE: case Insn::MATRIX: abort();
+    }
+  }
+  auto r = dstack.back();
+  dstack.resize(sp);
+  return r;
+}
+
+// Newton's method, with the derivative computed exactly by runDual
+tlfloat_octuple OctCore::solve(const Insn *pc, const Insn *end, const tlfloat_octuple *var, tlfloat_octuple x, int pos) {
+  tlfloat_octuple prev = 0;
+  for(int i=0;i<256;i++) {
+    Dual f = runDual(pc, end, var, Dual { x, 1 });
+    if (f.v == 0) return x;
+    auto dx = f.v / f.d;
+    if (!isfinite_(dx)) break;
+    x -= dx;
+    auto adx = tlfloat_fabso(dx), ax = tlfloat_fabso(x);
+    if (adx <= ax * tlfloat_ldexpo(1, -230)) return x;
+    // The step stopped shrinking at the level of rounding errors in f
+    if (i > 0 && adx >= prev && adx <= ax * tlfloat_ldexpo(1, -200)) return x;
+    prev = adx;
+  }
+  fail(Error::NO_CONVERGENCE, pos);
+  return NAN;
+}
+
+// Integer expressions are evaluated exactly if they contain only integer
+// literals, and operators and functions with an exact counterpart
+// Left shifts wrap around on tlfloat_int128_t instead of growing
+void OctCore::checkShift(tlfloat_octuple x, tlfloat_octuple y) {
+  if (!(y < 127 && tlfloat_fabso(tlfloat_ldexpo(x, int(y))) < 0x1p+127)) outOfRange = true;
+}
+
+bool OctCore::exactEligible() const {
+  for(const Insn &insn : code) {
+    switch(insn.opcode) {
+    case Insn::NUM: if (!isint_(insn.val)) return false; break;
+    case Insn::VAR: break;
+    case Insn::CALL: case Insn::ASSIGN: if (insn.func->big == nullptr) return false; break;
+    default: return false;
+    }
+  }
+  return true;
+}
+
+// Evaluates the code on exact integers. The assignments are applied only if
+// the whole evaluation succeeds, and false is returned if a value turns
+// out not to be an integer.
+bool OctCore::runExact(BigInt &result) {
+  vector<BigInt> bstack;
+  vector<pair<tlfloat_octuple *, BigInt>> pending;
+
+  auto read = [&](tlfloat_octuple *var) {
+    for(size_t i=pending.size();i-- > 0;) if (pending[i].first == var) return pending[i].second;
+    auto it = exactVars.find(var);
+    if (it != exactVars.end() && it->second.second == *var) return it->second.first;
+    if (!isint_(*var)) throw Inexact();
+    return toBigInt(*var);
   };
-  auto t0 = tk.next();
-  if (opMap.count(t0.first) != 0) {
-    auto c0 = L1(tk);
-    return L2p(tk, pair<string, tlfloat_octuple>("RVAL", (*opMap.at(t0.first))(lhs.second, c0.second)));
+
+  try {
+    for(const Insn &insn : code) {
+      switch(insn.opcode) {
+      case Insn::NUM: {
+	bstack.push_back(exactLiteral(insn.name));
+	break;
+      }
+      case Insn::VAR: bstack.push_back(read(insn.var)); break;
+      case Insn::CALL: {
+	const int n = insn.func->narg;
+	BigInt r = (*insn.func->big)(bstack.data() + bstack.size() - n);
+	bstack.resize(bstack.size() - n);
+	bstack.push_back(r);
+	break;
+      }
+      case Insn::ASSIGN: {
+	BigInt a[2] = { read(insn.var), bstack.back() };
+	bstack.pop_back();
+	bstack.back() = (*insn.func->big)(a);
+	pending.push_back(make_pair(insn.var, bstack.back()));
+	break;
+      }
+      default: return false;
+      }
+    }
+  } catch(Inexact &) {
+    return false;
+  }
+
+  for(auto &p : pending) {
+    *p.first = toOctuple(p.second);
+    exactVars[p.first] = make_pair(p.second, *p.first);
   }
-  tk.pushBack(t0);
-  return lhs;
+  result = bstack.back();
+  return true;
 }
 
-// L1 ::= L0 | OP L1		OP : + - ~
-pair<string, tlfloat_octuple> OctCore::L1(Tokenizer& tk) {
-  static const unordered_map<string, tlfloat_octuple (* const)(tlfloat_octuple)> opMap = {
-    { "+", uplus }, { "-", uminus }, { "~", unot },
+namespace octcore {
+  // Element-wise code computing element i of an array from element i of its
+  // sources. Operators and functions applied to arrays are appended to the
+  // kernel instead of being evaluated, so that a whole expression runs in one
+  // pass over the elements without temporary arrays.
+  struct Kernel {
+    struct Op {
+      enum { CONST, ELEM, CALL } op;
+      tlfloat_octuple val;
+      const tlfloat_octuple *src;
+      const Func *func;
+    };
+    vector<Op> ops;
+    size_t n = 0;		// Number of elements
+    bool serial = false;	// Set if a function uses the context, like rnd()
   };
-  auto t0 = tk.next();
-  if (opMap.count(t0.first) != 0) {
-    auto c = L1(tk);
-    return pair<string, tlfloat_octuple>("RVAL", (*opMap.at(t0.first))(c.second));
+}
+
+namespace {
+  const size_t maxArraySize = 1 << 24, chunkSize = 1024;
+
+  // Calls f(chunk, begin, end) for the chunks of [0, n) on up to maxThreads
+  // threads. The chunks do not depend on the number of threads, so that the
+  // results of reductions combined in chunk order are reproducible.
+  void forChunks(size_t n, size_t maxThreads, const function<void(size_t, size_t, size_t)> &f) {
+    parallel::parallelFor((n + chunkSize - 1) / chunkSize, maxThreads, [&](size_t c) { f(c, c * chunkSize, min(n, (c + 1) * chunkSize)); });
+  }
+
+  // Shows at most the first 10 and the last 3 elements
+  string formatElements(const tlfloat_octuple *p, size_t n) {
+    char buf[128];
+    string s = "[";
+    for(size_t i=0;i<n;i++) {
+      if (n > 16 && i == 10) { s += ", ..."; i = n - 3; }
+      if (i != 0) s += ", ";
+      tlfloat_snprintf(buf, sizeof(buf), "%.60Og", p[i]);
+      s += buf;
+    }
+    return s + "]";
+  }
+
+  string formatArray(const tlfloat_octuple *p, size_t n) {
+    string s = formatElements(p, n);
+    if (n > 16) s += " (" + to_string(n) + " elements)";
+    return s;
+  }
+
+  // Shows the rows as arrays, at most the first 10 and the last 3 of them
+  string formatMatrix(const tlfloat_octuple *p, size_t rows, size_t cols) {
+    string s = "[";
+    for(size_t i=0;i<rows;i++) {
+      if (rows > 16 && i == 10) { s += ", ..."; i = rows - 3; }
+      if (i != 0) s += ", ";
+      s += formatElements(p + i * cols, cols);
+    }
+    s += "]";
+    if (rows > 16 || cols > 16) s += " (" + to_string(rows) + "x" + to_string(cols) + " matrix)";
+    return s;
   }
-  tk.pushBack(t0);
-  return L0(tk);
 }
 
-// L0p ::= , L8 L0p | epsilon
-vector<pair<string, tlfloat_octuple>> OctCore::L0p(Tokenizer& tk, vector<pair<string, tlfloat_octuple>> v) {
-  auto t0 = tk.next();
-  if (t0.first == ",") { v.push_back(LTop(tk)); return L0p(tk, v); }
-  tk.pushBack(t0);
-  return v;
+size_t OctCore::threads() const {
+  return parallel::threadCount(threads_);
 }
 
-// L0 ::= FP | ( L8 ) | ID | F | F ( L8 L0p )
-pair<string, tlfloat_octuple> OctCore::L0(Tokenizer& tk) {
-  static unordered_map<string, Func> funcMap = {
-    { "sqrt", Func { 1, tlfloat_sqrto, nullptr, nullptr } }, { "cbrt", Func { 1, tlfloat_cbrto, nullptr, nullptr } },
-    { "sin", Func { 1, tlfloat_sino, nullptr, nullptr } }, { "cos", Func { 1, tlfloat_coso, nullptr, nullptr } },
-    { "tan", Func { 1, tlfloat_tano, nullptr, nullptr } }, { "asin", Func { 1, tlfloat_asino, nullptr, nullptr } },
-    { "acos", Func { 1, tlfloat_acoso, nullptr, nullptr } }, { "atan", Func { 1, tlfloat_atano, nullptr, nullptr } },
-    { "sinh", Func { 1, tlfloat_sinho, nullptr, nullptr } }, { "cosh", Func { 1, tlfloat_cosho, nullptr, nullptr } },
-    { "tanh", Func { 1, tlfloat_tanho, nullptr, nullptr } }, { "asinh", Func { 1, tlfloat_asinho, nullptr, nullptr } },
-    { "acosh", Func { 1, tlfloat_acosho, nullptr, nullptr } }, { "atanh", Func { 1, tlfloat_atanho, nullptr, nullptr } },
-    { "log", Func { 1, tlfloat_logo, nullptr, nullptr } }, { "log2", Func { 1, tlfloat_log2o, nullptr, nullptr } },
-    { "log10", Func { 1, tlfloat_log10o, nullptr, nullptr } }, { "log1p", Func { 1, tlfloat_log1po, nullptr, nullptr } },
-    { "exp", Func { 1, tlfloat_expo, nullptr, nullptr } }, { "exp2", Func { 1, tlfloat_exp2o, nullptr, nullptr } },
-    { "exp10", Func { 1, tlfloat_exp10o, nullptr, nullptr } }, { "expm1", Func { 1, tlfloat_expm1o, nullptr, nullptr } },
-    { "erf", Func { 1, tlfloat_erfo, nullptr, nullptr } }, { "erfc", Func { 1, tlfloat_erfco, nullptr, nullptr } },
-    { "tgamma", Func { 1, tlfloat_tgammao, nullptr, nullptr } }, { "lgamma", Func { 1, tlfloat_lgammao, nullptr, nullptr } },
-    { "trunc", Func { 1, tlfloat_trunco, nullptr, nullptr } }, { "floor", Func { 1, tlfloat_flooro, nullptr, nullptr } },
-    { "ceil", Func { 1, tlfloat_ceilo, nullptr, nullptr } }, { "round", Func { 1, tlfloat_roundo, nullptr, nullptr } },
-    { "rint", Func { 1, tlfloat_rinto, nullptr, nullptr } }, { "fabs", Func { 1, tlfloat_fabso, nullptr, nullptr } }, 
-    { "pow", Func { 2, nullptr, tlfloat_powo, nullptr } }, { "atan2", Func { 2, nullptr, tlfloat_atan2o, nullptr } },
-    { "hypot", Func { 2, nullptr, tlfloat_hypoto, nullptr } }, { "fdim", Func { 2, nullptr, tlfloat_fdimo, nullptr } },
-    { "fmax", Func { 2, nullptr, tlfloat_fmaxo, nullptr } }, { "fmin", Func { 2, nullptr, tlfloat_fmino, nullptr } },
-    { "fmod", Func { 2, nullptr, tlfloat_fmodo, nullptr } }, { "remainder", Func { 2, nullptr, tlfloat_remaindero, nullptr } },
-    { "copysign", Func { 2, nullptr, tlfloat_copysigno, nullptr } }, { "fma", Func { 3, nullptr, nullptr, tlfloat_fmao } },
-    { "ldexp", Func { 2, nullptr, ldexp_, nullptr } }, { "int", Func { 1, tlfloat_trunco, nullptr, nullptr } },
-    { "gcd", Func { 2, nullptr, gcd, nullptr } }, { "lcm", Func { 2, nullptr, lcm, nullptr } }, 
-    { "rnd", Func { 1, rnd, nullptr, nullptr } }, { "tanpi", Func { 1, tlfloat_tanpio, nullptr, nullptr } },
-    { "sinpi", Func { 1, tlfloat_sinpio, nullptr, nullptr } }, { "cospi", Func { 1, tlfloat_cospio, nullptr, nullptr } },
+// Runs the body n times in the chunks of the array kernels, each with a
+// context of its own. Chunk i draws its random numbers from a generator
+// seeded from this context and jumped i times. The streams of the chunks
+// thus start 2^128 steps apart, and cannot overlap. The samples of a chunk
+// are summed with compensation about its first sample. The chunks are
+// merged in order, so that the result only depends on the seed, and not on
+// the number of threads. Returns the mean, and shows it with its standard
+// error if show is set.
+tlfloat_octuple OctCore::monteCarlo(const Insn *pc, const Insn *end, uint64_t n, bool show) {
+  struct Stats { uint64_t n; tlfloat_octuple mean, m2; };
+  const size_t nChunks = size_t((n + chunkSize - 1) / chunkSize);
+  vector<Stats> chunks(nChunks);
+
+  vector<Xoshiro256> streams;
+  streams.reserve(nChunks);
+  Xoshiro256 g(rng_.next64(), rng_.next64());
+  for(size_t c=0;c<nChunks;c++) {
+    streams.push_back(g);
+    g.jump();
+  }
+
+  // The error of the first chunk that fails. The chunks before it have all
+  // been started when it fails, and are run to the end.
+  atomic<bool> failed(false);
+  mutex mtx;
+  size_t failedChunk = nChunks;
+  Error error;
+
+  parallel::parallelFor<OctCore>(nChunks, threads(), [&](OctCore &w, size_t c) {
+    w.rng_ = streams[c];
+    const uint64_t m = min<uint64_t>(n - uint64_t(c) * chunkSize, chunkSize);
+    CompensatedSum s, s2;
+    tlfloat_octuple shift = 0;
+    for(uint64_t i=0;i<m;i++) {
+      const tlfloat_octuple v = w.run(pc, end);
+      if (w.err_) {
+	lock_guard<mutex> lock(mtx);
+	if (c < failedChunk) { failedChunk = c; error = w.err_; }
+	failed = true;
+	return;
+      }
+      if (i == 0) shift = v;
+      s.add(v - shift);
+      s2.add((v - shift) * (v - shift));
+    }
+    const tlfloat_octuple a = s.value(), fm = fromU64(m);
+    chunks[c] = Stats { m, shift + a / fm, s2.value() - a * a / fm };
+  }, &failed);
+  if (failed) {
+    if (!err_) err_ = error;
+    return NAN;
+  }
+
+  // Chan et al.'s pairwise update of the mean and the sum of squared deviations
+  Stats t { 0, 0, 0 };
+  for(const Stats &c : chunks) {
+    const tlfloat_octuple d = c.mean - t.mean, na = fromU64(t.n), nb = fromU64(c.n), nn = na + nb;
+    t.mean += d * nb / nn;
+    t.m2 += c.m2 + d * d * (na * nb / nn);
+    t.n += c.n;
+  }
+  if (show) {
+    const tlfloat_octuple se = n > 1 ? tlfloat_sqrto(t.m2 / fromU64(n - 1) / fromU64(n)) : tlfloat_octuple(NAN);
+    char buf[128];
+    tlfloat_snprintf(buf, sizeof(buf), "%.40Og", t.mean);
+    text_ = buf;
+    tlfloat_snprintf(buf, sizeof(buf), "%.6Og", se);
+    text_ += " +/- " + string(buf);
+  }
+  return t.mean;
+}
+
+tlfloat_octuple OctCore::evalKernel(const Kernel &k, size_t i, tlfloat_octuple *stk) {
+  size_t sp = 0;
+  for(const Kernel::Op &op : k.ops) {
+    switch(op.op) {
+    case Kernel::Op::CONST: stk[sp++] = op.val; break;
+    case Kernel::Op::ELEM: stk[sp++] = op.src[i]; break;
+    case Kernel::Op::CALL: {
+      sp -= op.func->narg;
+      stk[sp] = call(*op.func, stk + sp);
+      sp++;
+      break;
+    }
+    }
+  }
+  return stk[0];
+}
+
+void OctCore::runKernel(const Kernel &k, tlfloat_octuple *out) {
+  forChunks(k.n, k.serial ? 1 : threads(), [&](size_t, size_t begin, size_t end) {
+    vector<tlfloat_octuple> stk(k.ops.size());
+    for(size_t i=begin;i<end;i++) out[i] = evalKernel(k, i, stk.data());
+  });
+}
+
+// Reduces the elements computed by the kernel without storing them
+tlfloat_octuple OctCore::reduceKernel(const Kernel &k, int kind) {
+  const tlfloat_octuple identity = kind == SUM ? 0 : kind == PROD ? 1 : kind == MIN ? INFINITY : -INFINITY;
+  vector<tlfloat_octuple> partial((k.n + chunkSize - 1) / chunkSize, identity);
+  forChunks(k.n, k.serial ? 1 : threads(), [&](size_t c, size_t begin, size_t end) {
+    vector<tlfloat_octuple> stk(k.ops.size());
+    tlfloat_octuple r = identity;
+    for(size_t i=begin;i<end;i++) {
+      auto v = evalKernel(k, i, stk.data());
+      switch(kind) {
+      case SUM: r += v; break;
+      case PROD: r *= v; break;
+      case MIN: r = tlfloat_fmino(r, v); break;
+      case MAX: r = tlfloat_fmaxo(r, v); break;
+      }
+    }
+    partial[c] = r;
+  });
+  tlfloat_octuple r = identity;
+  for(auto v : partial) {
+    switch(kind) {
+    case SUM: r += v; break;
+    case PROD: r *= v; break;
+    case MIN: r = tlfloat_fmino(r, v); break;
+    case MAX: r = tlfloat_fmaxo(r, v); break;
+    }
+  }
+  return r;
+}
+
+// Evaluates code that builds, reads or reduces arrays. Scalar operands are
+// evaluated as they come, array operands are kernels, which are run when
+// an array is reduced, stored in a variable, passed to a matrix operation
+// or shown as the result. Element-wise operations keep the shape of
+// matrices, whose kernels run over the elements in row order.
+tlfloat_octuple OctCore::runArray() {
+  struct Operand {
+    bool isArray;
+    tlfloat_octuple val;
+    Kernel k;
+    size_t cols = 0;		// Columns of a matrix, 0 for a vector
   };
-  static unordered_map<string, tlfloat_octuple> constMap = {
-    { "M_E", TLFLOAT_M_Eo }, { "M_LOG2E", TLFLOAT_M_LOG2Eo }, { "M_LOG10E", TLFLOAT_M_LOG10Eo }, { "M_LN2", TLFLOAT_M_LN2o },
-    { "M_LN10", TLFLOAT_M_LN10o }, { "M_PI", TLFLOAT_M_PIo }, { "M_PI_2", TLFLOAT_M_PI_2o }, { "M_PI_4", TLFLOAT_M_PI_4o },
-    { "M_1_PI", TLFLOAT_M_1_PIo }, { "M_2_PI", TLFLOAT_M_2_PIo }, { "M_2_SQRTPI", TLFLOAT_M_2_SQRTPIo },
-    { "M_SQRT2", TLFLOAT_M_SQRT2o }, { "M_SQRT1_2", TLFLOAT_M_SQRT1_2o },
+  vector<Operand> st;
+  vector<vector<tlfloat_octuple>> temps;	// Literals, ranges and replaced variables, which kernels may still read
+
+  auto scalar = [](tlfloat_octuple v) { return Operand { false, v, Kernel() }; };
+  auto source = [](const vector<tlfloat_octuple> &v, size_t cols = 0) {
+    Operand o { true, 0, Kernel(), cols };
+    o.k.ops.push_back(Kernel::Op { Kernel::Op::ELEM, 0, v.data(), nullptr });
+    o.k.n = v.size();
+    return o;
+  };
+  auto variable = [&](const tlfloat_octuple *var) {
+    auto it = arrays.find(var);
+    if (it == arrays.end()) return scalar(*var);
+    auto c = columns.find(var);
+    return source(it->second, c == columns.end() ? 0 : c->second);
+  };
+  auto pop = [&]() { Operand o = move(st.back()); st.pop_back(); return o; };
+  auto popScalar = [&](const Insn &insn) {
+    if (st.back().isArray) fail(Error::SCALAR_EXPECTED, insn.pos, insn.name);
+    return pop().val;
   };
 
-  auto t0 = tk.next();
+  // Applies f element-wise to the top n operands, or to their values if they are all scalars
+  auto apply = [&](const Insn &insn, const Func &f, int n) {
+    Operand *a = st.data() + st.size() - n;
+    bool any = false;
+    for(int i=0;i<n;i++) any = any || a[i].isArray;
+    if (!any) {
+      tlfloat_octuple v[3];
+      for(int i=0;i<n;i++) v[i] = a[i].val;
+      auto r = call(f, v);
+      st.resize(st.size() - n);
+      st.push_back(scalar(r));
+      return;
+    }
+    Operand r { true, 0, Kernel() };
+    bool sized = false;
+    for(int i=0;i<n;i++) {
+      if (!a[i].isArray) {
+	r.k.ops.push_back(Kernel::Op { Kernel::Op::CONST, a[i].val, nullptr, nullptr });
+	continue;
+      }
+      if (sized && (r.k.n != a[i].k.n || r.cols != a[i].cols)) {
+	if (r.k.n != a[i].k.n) fail(Error::LENGTH_MISMATCH, insn.pos, string_view(), r.k.n, a[i].k.n);
+	else fail(Error::SHAPE_MISMATCH, insn.pos);
+	st.resize(st.size() - n);
+	st.push_back(scalar(NAN));
+	return;
+      }
+      r.k.n = a[i].k.n;
+      r.cols = a[i].cols;
+      sized = true;
+      r.k.serial = r.k.serial || a[i].k.serial;
+      r.k.ops.insert(r.k.ops.end(), a[i].k.ops.begin(), a[i].k.ops.end());
+    }
+    r.k.ops.push_back(Kernel::Op { Kernel::Op::CALL, 0, nullptr, &f });
+    r.k.serial = r.k.serial || f.cfunc != nullptr;
+    st.resize(st.size() - n);
+    st.push_back(move(r));
+  };
 
-  if (t0.first == "FP") {
-    return pair<string, tlfloat_octuple>("RVAL", tlfloat_strtoo(t0.second.c_str(), nullptr));
-  } if (t0.first == "(") {
-    auto c = LTop(tk);
-    auto t1 = tk.next();
-    if (t1.first != ")") throw(runtime_error("')' expected at column " + to_string(t1.pos)));
-    return c;
-  } else if (t0.first == "ID" && funcMap.count(t0.second) != 0) {
-    auto f = funcMap.at(t0.second);
-    auto t1 = tk.next();
-    if (t1.first != "(") throw(runtime_error("'(' expected at column " + to_string(t1.pos)));
-    vector<pair<string, tlfloat_octuple>> c;
-    c.push_back(LTop(tk));
-    c = L0p(tk, c);
-    if ((int)c.size() != f.narg)
-      throw(runtime_error(to_string(f.narg) + " argument(s) expected for " + t0.second +
-			  " at column " + to_string(t0.pos)));
-    auto t2 = tk.next();
-    if (t2.first != ")") throw(runtime_error("')' expected at column " + to_string(t2.pos)));
-    switch(f.narg) {
-    case 1: return pair<string, tlfloat_octuple>("RVAL", (*f.func1)(c[0].second));
-    case 2: return pair<string, tlfloat_octuple>("RVAL", (*f.func2)(c[0].second, c[1].second));
-    case 3: return pair<string, tlfloat_octuple>("RVAL", (*f.func3)(c[0].second, c[1].second, c[2].second));
-    default: abort();
-    }
-  } else if (t0.first == "ID" && constMap.count(t0.second) != 0) {
-    return pair<string, tlfloat_octuple>("RVAL", constMap[t0.second]);
-  } else if (t0.first == "ID") {
-    return pair<string, tlfloat_octuple>("LVAL:" + t0.second, varMap[t0.second]);
-  } else {
-    string s = t0.first == "" ? "end of line" : t0.first;
-    throw(runtime_error("Unexpected " + s + " at column " + to_string(t0.pos)));
+  auto force = [&](const Kernel &k) {
+    vector<tlfloat_octuple> v(k.n);
+    runKernel(k, v.data());
+    return v;
+  };
+
+  // The elements of a matrix operand. A vector is taken as a column if
+  // allowed, and the matrix has to be square if required.
+  auto popMatrix = [&](const Insn &insn, bool vectorOk, bool square, size_t &rows, size_t &cols) {
+    Operand o = pop();
+    if (!o.isArray || (o.cols == 0 && !vectorOk)) {
+      fail(Error::MATRIX_EXPECTED, insn.pos, insn.name, square);
+      return vector<tlfloat_octuple>();
+    }
+    cols = o.cols != 0 ? o.cols : 1;
+    rows = o.k.n / cols;
+    if (square && rows != cols) fail(Error::MATRIX_EXPECTED, insn.pos, insn.name, square);
+    return force(o.k);
+  };
+
+  for(size_t pc=0;pc<code.size();pc++) {
+    if (err_) return NAN;
+    const Insn &insn = code[pc];
+    switch(insn.opcode) {
+    case Insn::NUM: st.push_back(scalar(insn.val)); break;
+    case Insn::VAR: st.push_back(variable(insn.var)); break;
+    case Insn::CALL: apply(insn, *insn.func, insn.func->narg); break;
+    case Insn::ASSIGN: {
+      // As in run(), the variable is read when the assignment is made
+      Operand r = pop();
+      st.pop_back();
+      if (insn.func->func2 == bsubst) {
+	st.push_back(move(r));
+      } else {
+	st.push_back(variable(insn.var));
+	st.push_back(move(r));
+	apply(insn, *insn.func, 2);
+	if (err_) return NAN;
+      }
+
+      auto it = arrays.find(insn.var);
+      if (it != arrays.end()) {
+	temps.push_back(move(it->second));
+	arrays.erase(it);
+	columns.erase(insn.var);
+      }
+      if (!st.back().isArray) {
+	*insn.var = st.back().val;
+      } else {
+	const size_t cols = st.back().cols;
+	auto &v = arrays[insn.var] = force(st.back().k);
+	if (cols != 0) columns[insn.var] = cols;
+	*insn.var = NAN;
+	st.back() = source(v, cols);
+      }
+      break;
+    }
+    case Insn::JUMP: pc += insn.len; break;
+    case Insn::AND: case Insn::OR: {
+      // Conditions are scalars, since both branches cannot be skipped element-wise
+      auto c = popScalar(insn);
+      if (err_) return NAN;
+      if ((c != 0) == (insn.opcode == Insn::OR)) {
+	st.push_back(scalar(insn.opcode == Insn::OR ? 1 : 0));
+	pc += insn.len;
+      }
+      break;
+    }
+    case Insn::BRANCH:
+      if (popScalar(insn) == 0 && !err_) pc += insn.len;
+      break;
+    case Insn::DIFF: case Insn::SOLVE: {
+      const Insn *body = &insn - insn.off;
+      for(const Insn *b = body;b < body + insn.len;b++) {
+	if (b->opcode == Insn::ARRAY || b->opcode == Insn::RANGE || b->opcode == Insn::REDUCE || b->opcode == Insn::MATRIX ||
+	    (b->opcode == Insn::VAR && arrays.count(b->var) != 0)) {
+	  fail(Error::ARRAY_IN_DIFF, b->pos);
+	  return NAN;
+	}
+      }
+      auto x = popScalar(insn);
+      st.push_back(scalar(insn.opcode == Insn::DIFF ? runDual(body, body + insn.len, insn.var, Dual { x, 1 }).d :
+			  solve(body, body + insn.len, insn.var, x, insn.pos)));
+      break;
+    }
+    case Insn::LOOP: case Insn::TEST: case Insn::NEXT: case Insn::MONTECARLO:
+      fail(Error::ARRAY_IN_LOOP, insn.pos);
+      return NAN;
+    case Insn::ARRAY: {
+      Operand *a = st.data() + st.size() - insn.len;
+      if (insn.len == 0 || !a[0].isArray) {
+	vector<tlfloat_octuple> v(insn.len);
+	for(int i=insn.len-1;i>=0;i--) {
+	  if (st.back().isArray) { fail(Error::NESTED_ARRAY, insn.pos); return NAN; }
+	  v[i] = pop().val;
+	}
+	temps.push_back(move(v));
+	st.push_back(source(temps.back()));
+	break;
+      }
+
+      // An array of vectors of the same length is a matrix with them as rows
+      const size_t cols = a[0].k.n;
+      vector<tlfloat_octuple> v;
+      v.reserve(cols * insn.len);
+      for(int i=0;i<insn.len;i++) {
+	if (!a[i].isArray || a[i].cols != 0) { fail(Error::NESTED_ARRAY, insn.pos); return NAN; }
+	if (a[i].k.n != cols) { fail(Error::LENGTH_MISMATCH, insn.pos, string_view(), cols, a[i].k.n); return NAN; }
+	auto row = force(a[i].k);
+	v.insert(v.end(), row.begin(), row.end());
+      }
+      st.resize(st.size() - insn.len);
+      temps.push_back(move(v));
+      st.push_back(source(temps.back(), cols));
+      break;
+    }
+    case Insn::RANGE: {
+      // The end point is included unless it is off the grid by more than rounding errors
+      auto step = popScalar(insn), end = popScalar(insn), start = popScalar(insn);
+      auto q = (end - start) / step;
+      if (err_) return NAN;
+      if (!(q >= 0 && q < maxArraySize)) { fail(Error::INVALID_RANGE, insn.pos); return NAN; }
+      const size_t n = (size_t)(uint64_t)(q + tlfloat_ldexpo(q, -200)) + 1;
+      vector<tlfloat_octuple> v(n);
+      for(size_t i=0;i<n;i++) v[i] = start + fromU64(i) * step;
+      temps.push_back(move(v));
+      st.push_back(source(temps.back()));
+      break;
+    }
+    case Insn::REDUCE: {
+      // dot(a, b) is the sum of the element-wise product
+      if (insn.len == DOT) apply(insn, binOpMap.at("*").func, 2);
+      Operand a = pop();
+      st.push_back(scalar(a.isArray ? reduceKernel(a.k, insn.len == DOT ? SUM : insn.len) : a.val));
+      break;
+    }
+    case Insn::MATRIX: {
+      size_t n, m, k, p;
+      vector<tlfloat_octuple> r;
+      size_t cols = 0;		// Of the result, 0 if it is a vector
+      switch(insn.len) {
+      case MATMUL: {
+	// A vector is a row on the left, and a column on the right
+	const bool vecA = st[st.size() - 2].isArray && st[st.size() - 2].cols == 0, vecB = st.back().isArray && st.back().cols == 0;
+	auto b = popMatrix(insn, true, false, k, p);
+	auto a = popMatrix(insn, true, false, n, m);
+	if (err_) return NAN;
+	if (vecA) { m = n; n = 1; }
+	if (m != k) { fail(Error::SHAPE_MISMATCH, insn.pos, insn.name); return NAN; }
+	r.resize(n * p);
+	matrix::multiply(a.data(), b.data(), r.data(), n, m, p, threads());
+	if (!vecA && !vecB) cols = p;
+	break;
+      }
+      case TRANSPOSE: {
+	auto a = popMatrix(insn, false, false, n, m);
+	if (err_) return NAN;
+	r.resize(n * m);
+	matrix::transpose(a.data(), r.data(), n, m);
+	cols = n;
+	break;
+      }
+      case DET: {
+	auto a = popMatrix(insn, false, true, n, m);
+	if (err_) return NAN;
+	st.push_back(scalar(matrix::det(a.data(), n, threads())));
+	continue;
+      }
+      case INV: case LINSOLVE: {
+	const bool vecB = insn.len == LINSOLVE && st.back().isArray && st.back().cols == 0;
+	if (insn.len == INV) {
+	  p = 0;
+	} else {
+	  r = popMatrix(insn, true, false, k, p);
+	}
+	auto a = popMatrix(insn, false, true, n, m);
+	if (err_) return NAN;
+	if (insn.len == INV) {
+	  r.assign(n * n, tlfloat_octuple(0));
+	  for(size_t i=0;i<n;i++) r[i * n + i] = 1;
+	  k = p = n;
+	}
+	if (k != n) { fail(Error::SHAPE_MISMATCH, insn.pos, insn.name); return NAN; }
+	vector<size_t> perm;
+	int sign;
+	if (!matrix::lu(a.data(), n, perm, sign, threads())) { fail(Error::SINGULAR_MATRIX, insn.pos, insn.name); return NAN; }
+	matrix::luSolve(a.data(), perm, r.data(), n, p, threads());
+	if (!vecB) cols = p;
+	break;
+      }
+      }
+      temps.push_back(move(r));
+      st.push_back(source(temps.back(), cols));
+      break;
+    }
+    }
   }
+
+  Operand r = pop();
+  if (!r.isArray) return r.val;
+  auto v = force(r.k);
+  text_ = r.cols != 0 ? formatMatrix(v.data(), v.size() / r.cols, r.cols) : formatArray(v.data(), v.size());
+  return fromU64(v.size());
 }
 
-pair<string, tlfloat_octuple> OctCore::execute(const string &str) {
-  static vector<pair<string, string>> tokenDefs = {
-    { "FP", "(0x([0-9a-fA-F]*[.])?[0-9a-fA-F]+([pP][-+]?\\d+)?)|(([0-9]*[.])?[0-9]+([eE][-+]?\\d+)?)|([Ii][Nn][Ff])|([Nn][Aa][Nn])" },
-    { "+", "\\+" }, { "-", "-" }, { "*", "\\*" }, { "/", "/" }, { "%", "%" },
-    { "<<", "<<" }, { ">>", ">>" }, { "&", "&" }, { "|", "\\|" }, { "^", "\\^" }, { "~", "~" },
-    { "+=", "\\+=" }, { "-=", "-=" }, { "*=", "\\*=" }, { "/=", "/=" }, { "%=", "%=" },
-    { "&=", "&=" }, { "|=", "\\|=" }, { "^=", "\\^=" }, { "<<=", "<<=" }, { ">>=", ">>=" },
-    { "(", "\\(" }, { ")", "\\)" }, { "=", "=" }, { ",", "," }, { "ID", "[a-zA-Z_][a-zA-Z_0-9]*" },
+namespace {
+  // Cost of reading the clock, which is in the time charged to each insn
+  uint64_t clockOverhead() {
+    static const uint64_t overhead = [] {
+      uint64_t m = UINT64_MAX;
+      for(int i=0;i<1000;i++) {
+	const uint64_t t = nanoseconds();
+	m = min(m, nanoseconds() - t);
+      }
+      return m;
+    }();
+    return overhead;
+  }
+
+  string formatNanoseconds(double ns) {
+    char buf[32];
+    if (ns < 1e3) snprintf(buf, sizeof(buf), "%.0f ns", ns);
+    else if (ns < 1e6) snprintf(buf, sizeof(buf), "%.2f us", ns * 1e-3);
+    else if (ns < 1e9) snprintf(buf, sizeof(buf), "%.2f ms", ns * 1e-6);
+    else snprintf(buf, sizeof(buf), "%.2f s", ns * 1e-9);
+    return buf;
+  }
+
+  string formatValue(tlfloat_octuple x) {
+    char buf[128];
+    tlfloat_snprintf(buf, sizeof(buf), "%.20Og", x);
+    return buf;
+  }
+
+  // A node of the expression tree, made of the insns that evaluate an
+  // operator, a function or a construct such as a conditional or a loop
+  struct ProfileNode {
+    size_t insn;			// The insn naming the node
+    vector<size_t> extra;		// The other insns of the node, such as the TEST and NEXT of a loop
+    vector<size_t> children;
+    bool choice = false;		// ?: , whose result is that of the branch run last
+    uint64_t count = 0, seq = 0, self = 0, total = 0;
+    tlfloat_octuple result = 0;
   };
 
+  // Rebuilds the tree from the postfix code, with the operands of each
+  // node on a stack like the values when the code runs, and returns the
+  // nodes reachable from the root with the children before their parents.
+  // The bodies of diff(), solve() and montecarlo() are not run in the
+  // normal flow, and are left out, so that their time is that of the node.
+  vector<size_t> profileTree(const Insn *code, size_t n, const InsnProfile *prof, vector<ProfileNode> &nodes) {
+    vector<size_t> st;
+    auto pop = [&]() { size_t k = st.back(); st.pop_back(); return k; };
+    auto node = [&](size_t i, vector<size_t> children) {
+      nodes.push_back(ProfileNode { i });
+      nodes.back().children = move(children);
+      return nodes.size() - 1;
+    };
+
+    // Nodes waiting for their last insns and operands : && and || until
+    // their CALL, ?: until the end of the false branch, and loops until NEXT
+    struct Frame { size_t node, end; };
+    vector<Frame> frames;
+
+    vector<bool> bodyJump(n);
+    for(size_t i=0;i<n;i++) {
+      if (code[i].opcode == Insn::DIFF || code[i].opcode == Insn::SOLVE) bodyJump[i - code[i].off - 1] = true;
+    }
+
+    auto close = [&](size_t i) {
+      const size_t k = frames.back().node;
+      frames.pop_back();
+      nodes[k].children.push_back(pop());
+      if (i < n) nodes[k].extra.push_back(i);
+      st.push_back(k);
+    };
+
+    for(size_t i=0;i<n;i++) {
+      while(!frames.empty() && frames.back().end == i && nodes[frames.back().node].choice) close(n);
+      const Insn &insn = code[i];
+      switch(insn.opcode) {
+      case Insn::NUM: case Insn::VAR: st.push_back(node(i, {})); break;
+      case Insn::CALL:
+	if (!frames.empty() && frames.back().end == i && !nodes[frames.back().node].choice) {
+	  close(i);
+	} else if (insn.name.empty()) {
+	  nodes[st.back()].extra.push_back(i);	// The + making a variable at the end of a false branch a value
+	} else {
+	  vector<size_t> args(insn.func->narg);
+	  for(size_t j=args.size();j-- > 0;) args[j] = pop();
+	  st.push_back(node(i, move(args)));
+	}
+	break;
+      case Insn::ASSIGN: {
+	const size_t v = pop(), target = pop();
+	st.push_back(node(i, { v }));
+	nodes.back().extra.push_back(nodes[target].insn);
+	break;
+      }
+      case Insn::AND: case Insn::OR: {
+	const size_t l = pop();
+	frames.push_back(Frame { node(i, { l }), i + insn.len });
+	break;
+      }
+      case Insn::BRANCH: {
+	const size_t c = pop();
+	frames.push_back(Frame { node(i, { c }), SIZE_MAX });
+	nodes.back().choice = true;
+	break;
+      }
+      case Insn::JUMP:
+	if (bodyJump[i]) {
+	  i += insn.len;
+	} else {
+	  Frame &f = frames.back();
+	  nodes[f.node].children.push_back(pop());
+	  nodes[f.node].extra.push_back(i);
+	  f.end = i + insn.len + 1;
+	}
+	break;
+      case Insn::DIFF: case Insn::SOLVE: {
+	const size_t x = pop();
+	st.push_back(node(i, { x }));
+	nodes.back().extra.push_back(i - insn.off - 1);
+	break;
+      }
+      case Insn::LOOP: {
+	vector<size_t> count;
+	if (insn.off) count.push_back(pop());
+	frames.push_back(Frame { node(i, move(count)), SIZE_MAX });
+	break;
+      }
+      case Insn::TEST:
+	nodes[frames.back().node].children.push_back(pop());
+	nodes[frames.back().node].extra.push_back(i);
+	break;
+      case Insn::NEXT: close(i); break;
+      case Insn::MONTECARLO: {
+	const size_t count = pop();
+	st.push_back(node(i, { count }));
+	i += insn.len;
+	break;
+      }
+      case Insn::ARRAY: case Insn::RANGE: case Insn::REDUCE: case Insn::MATRIX: abort();	// Rejected by explain()
+      }
+    }
+    while(!frames.empty()) close(n);
+
+    // Post-order, without recursion, as the tree may be deep
+    vector<size_t> order;
+    vector<pair<size_t, size_t>> todo { { st.back(), 0 } };
+    while(!todo.empty()) {
+      auto &t = todo.back();
+      if (t.second < nodes[t.first].children.size()) {
+	const size_t c = nodes[t.first].children[t.second++];
+	todo.push_back({ c, 0 });
+      } else {
+	order.push_back(t.first);
+	todo.pop_back();
+      }
+    }
+
+    const uint64_t overhead = clockOverhead();
+    for(size_t k : order) {
+      ProfileNode &nd = nodes[k];
+      size_t last = nd.insn;
+      auto add = [&](size_t i) {
+	nd.self += prof[i].ns - min(prof[i].ns, prof[i].count * overhead);
+	if (prof[i].seq > prof[last].seq) last = i;
+      };
+      add(nd.insn);
+      for(size_t i : nd.extra) add(i);
+      nd.count = prof[nd.insn].count;
+      nd.seq = prof[last].seq;
+      nd.result = prof[last].last;
+      nd.total = nd.self;
+      for(size_t c : nd.children) nd.total += nodes[c].total;
+      if (nd.choice && nd.children.size() == 3) {
+	const ProfileNode &a = nodes[nd.children[1]], &b = nodes[nd.children[2]];
+	nd.result = (a.seq > b.seq ? a : b).result;
+	nd.seq = max(nd.seq, max(a.seq, b.seq));
+      }
+    }
+    return order;
+  }
+
+  string nodeLabel(const Insn &insn) {
+    switch(insn.opcode) {
+    case Insn::NUM: return insn.name.empty() ? formatValue(insn.val) : string(insn.name);
+    case Insn::ASSIGN:
+      for(auto &op : binOpMap) if (&op.second.func == insn.func) return string(insn.name) + " " + string(op.first);
+      return string(insn.name) + " =";
+    case Insn::BRANCH: return "?:";
+    default: return string(insn.name);
+    }
+  }
+}
+
+// Profiles one evaluation of the code, which has no arrays, and reports the
+// tree of its nodes with the children of each sorted by their total time,
+// followed by the nodes taking the most time themselves. The expression is
+// evaluated on octuples only, without the exact integer path.
+bool OctCore::explain(Result &r) {
+  if (hasArrays) return fail(Error::ARRAY_IN_EXPLAIN, 0);
+
+  vector<InsnProfile> prof(code.size());
+  struct Unset { OctCore &c; ~Unset() { c.profile_ = nullptr; } } unset_ { *this };
+  profile_ = &prof;
+  profileSeq = 0;
+  clockOverhead();
+  const uint64_t t0 = nanoseconds();
+  r.value = run(code.data(), code.data() + code.size());
+  const uint64_t elapsed = nanoseconds() - t0;
+  profile_ = nullptr;
+  if (err_) return false;
+
+  vector<ProfileNode> nodes;
+  const vector<size_t> order = profileTree(code.data(), code.size(), prof.data(), nodes);
+  const ProfileNode &root = nodes[order.back()];
+  const double total = double(max<uint64_t>(1, root.total));
+
+  string &out = r.profile;
+  out = "explain : " + formatNanoseconds(double(root.total)) + " in " + to_string(order.size()) + " nodes, " +
+    formatNanoseconds(double(elapsed)) + " with the profiling\n";
+  out += "     total        self   share    runs  node\n";
+  char buf[64];
+  vector<pair<size_t, int>> todo { { order.back(), 0 } };
+  while(!todo.empty()) {
+    const size_t k = todo.back().first;
+    const int depth = todo.back().second;
+    todo.pop_back();
+    const ProfileNode &nd = nodes[k];
+    snprintf(buf, sizeof(buf), "%10s  %10s  %5.1f%%  %6llu  ", formatNanoseconds(double(nd.total)).c_str(),
+	     formatNanoseconds(double(nd.self)).c_str(), 100 * double(nd.total) / total, (unsigned long long)nd.count);
+    out += buf;
+    out.append(2 * depth, ' ');
+    out += nodeLabel(code[nd.insn]);
+    if (nd.count == 0) {
+      out += "  (not evaluated)";
+    } else if (!(code[nd.insn].opcode == Insn::NUM && !code[nd.insn].name.empty())) {
+      if (!nd.children.empty()) {
+	out += " (";
+	for(size_t j=0;j<nd.children.size();j++) {
+	  const ProfileNode &c = nodes[nd.children[j]];
+	  out += (j ? ", " : "") + (c.count != 0 ? formatValue(c.result) : string("-"));
+	}
+	out += ")";
+      }
+      out += " = " + formatValue(nd.result);
+    }
+    out += '\n';
+
+    vector<size_t> children = nd.children;
+    stable_sort(children.begin(), children.end(), [&](size_t a, size_t b) { return nodes[a].total < nodes[b].total; });
+    for(size_t c : children) todo.push_back({ c, depth + 1 });
+  }
+
+  vector<size_t> hot;
+  for(size_t k : order) if (nodes[k].self != 0 && code[nodes[k].insn].opcode != Insn::NUM) hot.push_back(k);
+  stable_sort(hot.begin(), hot.end(), [&](size_t a, size_t b) { return nodes[a].self > nodes[b].self; });
+  if (hot.size() > 5) hot.resize(5);
+  if (!hot.empty()) out += "most time in :\n";
+  for(size_t k : hot) {
+    snprintf(buf, sizeof(buf), "%10s  %5.1f%%  ", formatNanoseconds(double(nodes[k].self)).c_str(), 100 * double(nodes[k].self) / total);
+    out += buf + nodeLabel(code[nodes[k].insn]) + " at column " + to_string(code[nodes[k].insn].pos) + "\n";
+  }
+  out.pop_back();
+  return true;
+}
+
+void OctCore::release() {
+  decltype(code)(code.get_allocator()).swap(code);
+  decltype(stack)(stack.get_allocator()).swap(stack);
+  decltype(dstack)(dstack.get_allocator()).swap(dstack);
+  arena.reset();
+}
+
+Result OctCore::evaluate(string_view str) {
+  struct Release { OctCore &c; ~Release() { c.release(); } } release_ { *this };
+  Result r;
+  err_ = Error();
+
+  // Errors are returned in err_. Only exceptions from outside the
+  // evaluator, such as bad_alloc, are caught here.
+  auto failed = [&]() { r.error = move(err_); err_ = Error(); return r; };
+
   try {
-    Tokenizer tk(str, tokenDefs);
+    text_.clear();
+    checkRange = hasArrays = false;
+    Tokenizer tk(str, arena);
     auto t0 = tk.next();
-    if (t0.first == "") return pair<string, tlfloat_octuple>("RVAL", 0);
-    tk.pushBack(t0);
-    auto c = LTop(tk);
+    if (t0.first == "") { r.label = "RVAL"; return r; }
+
+    // explain(expression) as the whole line is profiled, and never cached
+    bool explaining = false;
+    if (t0.first == "ID" && t0.second == "explain") {
+      auto t1 = tk.next();
+      explaining = t1.first == "(";
+      if (!explaining) tk.pushBack(t1);
+    }
+
+    // The tokens separated by single spaces, so that spacing does not matter
+    string key;
+    if (cache.enabled() && !explaining) {
+      Tokenizer kt(str, arena);
+      for(auto t = kt.next();t.first != "";t = kt.next()) { key += t.second; key += ' '; }
+      ResultCache::Result c;
+      if (cache.lookup(key, c)) {
+	r.label = move(c.first);
+	r.value = c.second;
+	return r;
+      }
+    }
+
+    if (!explaining) tk.pushBack(t0);
+    if (!parse(tk)) return failed();
     auto t1 = tk.next();
-    if (t1.first != "") throw(runtime_error("Syntax error at column " + to_string(t1.pos)));
-    return c;
+    if (explaining) {
+      if (t1.first != ")") { fail(Error::EXPECTED, t1.pos, ")"); return failed(); }
+      t1 = tk.next();
+    }
+    if (t1.first != "") { fail(Error::SYNTAX, t1.pos); return failed(); }
+    r.label = isLval() ? "LVAL:" + string(code.back().name) : "RVAL";
+
+    // An explained assignment is a plain one in reactive mode
+    tlfloat_octuple *defined = nullptr;
+    if (reactive_ && !explaining && (defined = definedVar()) != nullptr && !checkCycle(defined, code.back().name)) return failed();
+
+    // Versions are updated before evaluation, in case it fails after an assignment
+    if (cache.enabled()) for(const Insn &insn : code) if (insn.opcode == Insn::ASSIGN) cache.touch(insn.var);
+
+    if (explaining) {
+      if (!explain(r)) return failed();
+      if (!text_.empty()) r.label = "TEXT:" + text_;
+      if (reactive_) react(str, nullptr);
+      if (err_) return failed();
+      return r;
+    }
+
+    if (hasArrays) {
+      r.value = runArray();
+      if (err_) return failed();
+      if (!text_.empty()) r.label = "TEXT:" + text_;
+      if (reactive_) react(str, defined);
+      if (err_) return failed();
+      if (cache.enabled()) updateCache(key, r);
+      return r;
+    }
+
+    // Integer expressions run on the fast path first. If a value reaches 2^127,
+    // the assigned variables are restored and the expression is evaluated again
+    // on exact integers.
+    typedef pair<tlfloat_octuple *, tlfloat_octuple> Saved;
+    vector<Saved, ArenaAllocator<Saved>> saved { ArenaAllocator<Saved>(arena) };
+    const bool exact = exactEligible();
+    if (exact) for(const Insn &insn : code) if (insn.opcode == Insn::ASSIGN) saved.push_back(Saved(insn.var, *insn.var));
+
+    checkRange = exact;
+    outOfRange = false;
+    r.value = run(code.data(), code.data() + code.size());
+    checkRange = false;
+    if (err_) return failed();
+
+    if (outOfRange) {
+      for(size_t i=saved.size();i-- > 0;) *saved[i].first = saved[i].second;
+      BigInt b;
+      if (runExact(b)) {
+	r.value = toOctuple(b);
+	if (!b.fitsInt128()) r.label = "INT:" + b.toString();
+      } else {
+	r.value = run(code.data(), code.data() + code.size());
+      }
+    }
+    if (!text_.empty()) r.label = "TEXT:" + text_;
+    if (reactive_) react(str, defined);
+    if (err_) return failed();
+    if (cache.enabled()) updateCache(key, r);
+    return r;
   } catch(exception &ex) {
-    return pair<string, tlfloat_octuple>(string("ERROR:") + ex.what(), 0);
+    checkRange = false;
+    r.error.code = Error::INTERNAL;
+    r.error.detail = ex.what();
+    return r;
+  }
+}
+
+namespace {
+  bool isVarName(string_view name) {
+    return !name.empty() && matchID(name) == name.size() && funcMap.count(name) == 0 && constMap.count(name) == 0 &&
+      arrayFuncMap.count(name) == 0 && name != "diff" && name != "solve" && name != "iterate" && name != "while" && name != "montecarlo";
+  }
+}
+
+Error OctCore::compile(string_view str, string_view param, Compiled &c) {
+  struct Release { OctCore &c; ~Release() { c.release(); } } release_ { *this };
+  err_ = Error();
+  c.code.clear();
+  c.text.assign(str.data(), str.size());
+
+  try {
+    if (!isVarName(param)) {
+      fail(Error::VAR_EXPECTED, 0);
+    } else {
+      const string name(param);
+      const bool existed = varMap.count(name) != 0;
+      hasArrays = false;
+      Tokenizer tk(c.text, arena);
+      if (parse(tk)) {
+	auto t1 = tk.next();
+	if (t1.first != "") fail(Error::SYNTAX, t1.pos);
+	else if (hasArrays) fail(Error::ARRAY_IN_COMPILED, 0);
+      }
+      if (!err_) {
+	// The parameter is read from the Compiled object, so that evaluating
+	// it leaves the variable of that name alone
+	const tlfloat_octuple *var = &varMap[name];
+	c.code.assign(code.begin(), code.end());
+	for(Insn &insn : c.code) if (insn.var == var) insn.var = &c.param;
+      }
+      if (!existed) varMap.erase(name);
+    }
+  } catch(exception &ex) {
+    c.code.clear();
+    err_.code = Error::INTERNAL;
+    err_.detail = ex.what();
+  }
+
+  Error e = move(err_);
+  err_ = Error();
+  return e;
+}
+
+tlfloat_octuple OctCore::evaluateAt(Compiled &c, tlfloat_octuple x) {
+  if (c.code.empty()) return NAN;
+  c.param = x;
+  err_ = Error();
+  tlfloat_octuple r = run(c.code.data(), c.code.data() + c.code.size());
+  if (err_) {
+    err_ = Error();
+    return NAN;
+  }
+  return r;
+}
+
+pair<string, tlfloat_octuple> OctCore::execute(string_view str) {
+  Result r = evaluate(str);
+  if (!r.ok()) return pair<string, tlfloat_octuple>("ERROR:" + r.error.message(), 0);
+  return pair<string, tlfloat_octuple>(move(r.label), r.value);
+}
+
+string Error::message() const {
+  const string col = " at column " + to_string(column);
+  switch(code) {
+  case NONE: return "";
+  case SYNTAX: return "Syntax error" + col;
+  case UNEXPECTED_END: return "Unexpected end of line" + col;
+  case UNEXPECTED_CHAR: return "Unexpected character '" + string(arg) + "'" + col;
+  case UNEXPECTED_TOKEN: return "Unexpected " + string(arg) + col;
+  case EXPECTED: return "'" + string(arg) + "' expected" + col;
+  case NOT_LVALUE: return "Expected l-value before assignment operator" + col;
+  case ARG_COUNT: return to_string(n0) + " argument(s) expected for " + string(arg) + col;
+  case VAR_EXPECTED: return "Variable name expected" + col;
+  case NESTING: return "Nesting too deep" + col;
+  case DIFF_ASSIGN: return "Assignment cannot be differentiated" + col;
+  case DIFF_NESTED: return "diff and solve cannot be nested" + col;
+  case NO_CONVERGENCE: return "solve did not converge";
+  case SCALAR_EXPECTED: return "Scalar argument expected for " + string(arg) + col;
+  case LENGTH_MISMATCH: return "Array lengths " + to_string(n0) + " and " + to_string(n1) + " do not match" + col;
+  case ARRAY_IN_DIFF: return "Arrays cannot be used in diff or solve" + col;
+  case NESTED_ARRAY: return "Arrays cannot be nested" + col;
+  case INVALID_RANGE: return "Invalid range" + col;
+  case CIRCULAR: return "Circular dependency " + detail;
+  case DIFF_LOOP: return "Loops cannot be differentiated" + col;
+  case ITERATION_COUNT: return "Invalid number of iterations for " + string(arg) + col;
+  case ITERATION_LIMIT: return "More than " + to_string(OctCore::maxIterations) + " iterations in " + string(arg) + col;
+  case ARRAY_IN_LOOP: return "Arrays cannot be used in loops" + col;
+  case ARRAY_IN_COMPILED: return "Arrays cannot be used in compiled expressions";
+  case ARRAY_IN_EXPLAIN: return "Arrays cannot be used in explain";
+  case MONTECARLO_ASSIGN: return "Assignment cannot be used in montecarlo" + col;
+  case MATRIX_EXPECTED: return string(n0 ? "Square matrix" : "Matrix") + " expected for " + string(arg) + col;
+  case SHAPE_MISMATCH: return "Matrix dimensions do not match" + (arg.empty() ? "" : " for " + string(arg)) + col;
+  case SINGULAR_MATRIX: return "Singular matrix in " + string(arg) + col;
+  case MATRIX_FILE: return (n0 != 0 ? "Line " + to_string(n0) + " of the matrix : " : string()) + detail;
+  case RECOMPUTE: return "Cannot recompute " + detail;
+  case INTERNAL: return detail;
+  }
+  return "";
+}
+
+// Caches the result unless the expression assigns or calls a function with side effects
+void OctCore::updateCache(const string &key, const Result &result) {
+  ResultCache::Deps deps;
+  for(const Insn &insn : code) {
+    if (insn.opcode == Insn::ASSIGN || (insn.opcode == Insn::CALL && insn.func->sideEffects)) { cache.bypass(); return; }
+    if (insn.opcode == Insn::VAR) deps.push_back(make_pair(insn.var, cache.version(insn.var)));
+  }
+  sort(deps.begin(), deps.end());
+  deps.erase(unique(deps.begin(), deps.end()), deps.end());
+  cache.insert(key, deps, ResultCache::Result(result.label, result.value));
+}
+
+// Returns the variable defined by the code, or null if the code is not of
+// the form "variable = expression" with a scalar expression without side effects
+tlfloat_octuple *OctCore::definedVar() const {
+  if (hasArrays || code.size() < 3 || code.back().opcode != Insn::ASSIGN || code.back().func != &binOpMap.at("=").func ||
+      code[0].opcode != Insn::VAR || code[0].var != code.back().var) return nullptr;
+  // An assignment reading its own variable, such as an accumulator, is not a definition
+  for(size_t i=1;i<code.size()-1;i++) {
+    if (code[i].opcode == Insn::ASSIGN || (code[i].opcode == Insn::CALL && code[i].func->sideEffects)) return nullptr;
+    if (code[i].opcode == Insn::VAR && code[i].var == code.back().var) return nullptr;
+  }
+  return code.back().var;
+}
+
+// Fails if a variable read by the expression defining var depends on var,
+// naming the variables on the cycle
+bool OctCore::checkCycle(const tlfloat_octuple *var, string_view name) {
+  // Each variable reached, with the variable whose definition reads it and its name
+  unordered_map<const tlfloat_octuple *, pair<const tlfloat_octuple *, string_view>> from;
+  vector<const tlfloat_octuple *> todo;
+  auto visit = [&](const tlfloat_octuple *v, const tlfloat_octuple *reader, string_view vname) {
+    if (from.emplace(v, make_pair(reader, vname)).second) todo.push_back(v);
+  };
+  for(size_t i=1;i<code.size()-1;i++) if (code[i].opcode == Insn::VAR) visit(code[i].var, var, code[i].name);
+
+  while(!todo.empty()) {
+    const tlfloat_octuple *v = todo.back();
+    todo.pop_back();
+    if (v == var) {
+      vector<string_view> path;
+      do { path.push_back(from.at(v).second); v = from.at(v).first; } while(v != var);
+      fail(Error::CIRCULAR, code.back().pos);
+      err_.detail = string(name);
+      for(size_t i=path.size();i-- > 0;) err_.detail += " -> " + string(path[i]);
+      return false;
+    }
+    auto it = defs.find(v);
+    if (it == defs.end()) continue;
+    for(auto &d : it->second.deps) visit(d.second, v, d.first);
+  }
+  return true;
+}
+
+// Records the definition made by the code just run, turns the other assigned
+// variables into plain values, and recomputes what depends on them
+void OctCore::react(string_view str, tlfloat_octuple *defined) {
+  vector<tlfloat_octuple *> changed;
+  for(const Insn &insn : code) {
+    if (insn.opcode != Insn::ASSIGN) continue;
+    undefine(insn.var);
+    changed.push_back(insn.var);
+  }
+
+  if (defined) {
+    // Variables bound by diff() and solve() are not read from outside
+    vector<const tlfloat_octuple *> bound;
+    for(const Insn &insn : code) if (insn.opcode == Insn::DIFF || insn.opcode == Insn::SOLVE) bound.push_back(insn.var);
+
+    Definition &d = defs[defined];
+    d.text = string(str);
+    d.code.assign(code.begin() + 1, code.end() - 1);
+    auto rebase = [&](string_view s) {
+      return s.data() >= str.data() && s.data() < str.data() + str.size() ? string_view(d.text).substr(s.data() - str.data(), s.size()) : s;
+    };
+    d.name = rebase(code[0].name);
+    for(Insn &insn : d.code) insn.name = rebase(insn.name);
+    for(size_t i=1;i<code.size()-1;i++) {
+      const Insn &insn = code[i];
+      if (insn.opcode != Insn::VAR || find(bound.begin(), bound.end(), insn.var) != bound.end()) continue;
+      if (find_if(d.deps.begin(), d.deps.end(), [&](auto &p) { return p.second == insn.var; }) != d.deps.end()) continue;
+      d.deps.push_back(make_pair(string(insn.name), insn.var));
+      dependents[insn.var].push_back(defined);
+    }
+  }
+
+  propagate(changed);
+}
+
+void OctCore::undefine(tlfloat_octuple *var) {
+  auto it = defs.find(var);
+  if (it == defs.end()) return;
+  for(auto &d : it->second.deps) {
+    auto &v = dependents[d.second];
+    v.erase(remove(v.begin(), v.end(), var), v.end());
+    if (v.empty()) dependents.erase(d.second);
+  }
+  defs.erase(it);
+}
+
+namespace {
+  // Definitions of a level below which they are recomputed on the calling thread
+  const size_t minParallelDefinitions = 16;
+}
+
+// Recomputes the definitions that depend on the changed variables. The
+// definitions whose dependencies are all up to date form a level, whose
+// members are independent. Their code reads the variables of this context,
+// which are not written until the level is done, and small levels run on
+// the calling thread. The first failure is recorded in err_.
+void OctCore::propagate(const vector<tlfloat_octuple *> &changed) {
+  recomputed_ = 0;
+
+  // The affected definitions, with the number of their dependencies still to be recomputed
+  unordered_map<const tlfloat_octuple *, int> waiting;
+  vector<tlfloat_octuple *> affected, todo(changed.begin(), changed.end());
+  while(!todo.empty()) {
+    auto it = dependents.find(todo.back());
+    todo.pop_back();
+    if (it == dependents.end()) continue;
+    for(tlfloat_octuple *v : it->second) {
+      if (!waiting.emplace(v, 0).second) continue;
+      affected.push_back(v);
+      todo.push_back(v);
+    }
+  }
+  if (affected.empty()) return;
+
+  vector<tlfloat_octuple *> level;
+  for(tlfloat_octuple *v : affected) {
+    for(auto &d : defs.at(v).deps) if (waiting.count(d.second) != 0) waiting[v]++;
+    if (waiting[v] == 0) level.push_back(v);
+  }
+
+  // Runs the code of a definition in the context c, which is this one or that of a worker
+  auto recompute = [&](OctCore &c, const Definition &d, tlfloat_octuple &value, Error &e) {
+    for(auto &p : d.deps) {
+      if (arrays.count(p.second) == 0) continue;
+      for(const Insn &insn : d.code) if (insn.var == p.second) { e.code = Error::SCALAR_EXPECTED; e.column = insn.pos; e.arg = p.first; break; }
+      value = NAN;
+      return;
+    }
+    value = c.run(d.code.data(), d.code.data() + d.code.size());
+    if (c.err_) {
+      e = move(c.err_);
+      c.err_ = Error();
+      value = NAN;
+    }
+  };
+
+  const string text = move(text_);
+  while(!level.empty()) {
+    vector<tlfloat_octuple> values(level.size());
+    vector<Error> errors(level.size());
+    if (level.size() < minParallelDefinitions || threads() <= 1) {
+      for(size_t i=0;i<level.size();i++) recompute(*this, defs.at(level[i]), values[i], errors[i]);
+    } else {
+      parallel::parallelFor<OctCore>(level.size(), threads(), [&](OctCore &c, size_t i) { recompute(c, defs.at(level[i]), values[i], errors[i]); });
+    }
+
+    vector<tlfloat_octuple *> nextLevel;
+    for(size_t i=0;i<level.size();i++) {
+      tlfloat_octuple *v = level[i];
+      *v = values[i];
+      exactVars.erase(v);
+      cache.touch(v);
+      if (errors[i] && !err_) {
+	fail(Error::RECOMPUTE, 0);
+	err_.detail = string(defs.at(v).name) + " : " + errors[i].message();
+      }
+      auto it = dependents.find(v);
+      if (it == dependents.end()) continue;
+      for(tlfloat_octuple *u : it->second) if (--waiting.at(u) == 0) nextLevel.push_back(u);
+    }
+    recomputed_ += level.size();
+    level.swap(nextLevel);
+  }
+  text_ = move(text);
+}
+
+bool OctCore::setVar(string_view name, tlfloat_octuple v) {
+  if (!isVarName(name)) return false;
+  tlfloat_octuple *var = &varMap[string(name)];
+  arrays.erase(var);
+  columns.erase(var);
+  exactVars.erase(var);
+  cache.touch(var);
+  *var = v;
+  if (reactive_) {
+    // Failed recomputations are left as NaN, as there is no evaluation to report them
+    undefine(var);
+    propagate(vector<tlfloat_octuple *> { var });
+    err_ = Error();
+  }
+  return true;
+}
+
+bool OctCore::getVar(string_view name, tlfloat_octuple &v) const {
+  auto it = varMap.find(string(name));
+  if (it == varMap.end()) return false;
+  v = it->second;
+  return true;
+}
+
+vector<pair<string, tlfloat_octuple>> OctCore::variables() const {
+  vector<pair<string, tlfloat_octuple>> v;
+  for(auto &p : varMap) if (arrays.count(&p.second) == 0) v.push_back(p);
+  return v;
+}
+
+Error OctCore::loadMatrix(string_view name, MappedFile &file) {
+  Error e;
+  auto bad = [&](size_t lineno, const string &detail) {
+    e.code = Error::MATRIX_FILE;
+    e.n0 = lineno;
+    e.detail = detail;
+    return e;
+  };
+  if (!isVarName(name)) {
+    e.code = Error::VAR_EXPECTED;
+    e.arg = name;
+    return e;
+  }
+
+  vector<tlfloat_octuple> v;
+  size_t cols = 0;
+  uint64_t tableRows;
+  uint32_t tableCols;
+  if (const tlfloat_octuple *t = tableValues(file.view(), tableRows, tableCols)) {
+    if (tableRows * tableCols > maxArraySize) return bad(0, "The matrix is too large");
+    v.assign(t, t + tableRows * tableCols);
+    cols = tableCols;
+  } else {
+    LineSplitter ls(file.view());
+    string_view line;
+    string buf;
+    for(size_t lineno = 1;ls.next(line);lineno++) {
+      buf.assign(line);
+      const char *p = buf.c_str();
+      size_t n = 0;
+      for(;;) {
+	while(*p == ',' || isspace((unsigned char)*p)) p++;
+	if (*p == '\0' || (n == 0 && *p == '#')) break;
+	const char *end;
+	v.push_back(tlfloat_strtoo(p, &end));
+	if (end == p) return bad(lineno, "Number expected");
+	if (v.size() > maxArraySize) return bad(lineno, "The matrix is too large");
+	p = end;
+	n++;
+      }
+      if (n == 0) continue;
+      if (cols != 0 && n != cols) return bad(lineno, to_string(n) + " numbers in a row of " + to_string(cols));
+      cols = n;
+    }
+  }
+  if (v.empty()) return bad(0, "The matrix is empty");
+
+  tlfloat_octuple *var = &varMap[string(name)];
+  exactVars.erase(var);
+  cache.touch(var);
+  if (reactive_) undefine(var);
+  arrays[var] = move(v);
+  columns[var] = cols;
+  *var = NAN;
+  if (reactive_) propagate(vector<tlfloat_octuple *> { var });
+  return e;
+}
+
+void OctCore::executeFile(MappedFile &file, const function<void(size_t, string_view, const Result &)> &callback) {
+  LineSplitter ls(file.view());
+  string_view line;
+  for(size_t lineno = 1;ls.next(line);lineno++) {
+    callback(lineno, line, evaluate(line));
+    file.discard(ls.position());
   }
 }
@@ -1,81 +1,288 @@
 #include <vector>
 #include <unordered_map>
-#include <regex>
 #include <string>
+#include <string_view>
+#include <functional>
 
 #include <tlfloat/tlfloat.h>
 
+#include "arena.hpp"
+#include "rng.hpp"
+#include "bigint.hpp"
+#include "cache.hpp"
+
 using namespace std;
 
 namespace octcore {
+  // Tokens are views into the input line, and first is a view of a string literal
   struct Token {
-    string first, second;
+    string_view first, second;
     int pos = 0;
-    Token(const string& f, const string& s, int p = 0) : first(f), second(s), pos(p) {}
-    Token(const char *f, const char *s, int p = 0) : first(f), second(s), pos(p) {}
   };
 
   class Tokenizer {
-    string str;
-    vector<pair<string, regex>> tokenDefs;
-    vector<Token> pushedBack;
+    string_view str;
+    vector<Token, ArenaAllocator<Token>> pushedBack;
 
   public:
     size_t pos = 0, lastpos = 0;
 
-    Tokenizer(const string &in, const vector<pair<string, string>> &tokenDefs_) : str(in) {
-      for(auto a : tokenDefs_) tokenDefs.push_back(pair<string, regex>(a.first, regex("(" + a.second + ").*")));
-    }
+    Tokenizer(string_view in, Arena &arena) : str(in), pushedBack(ArenaAllocator<Token>(arena)) {}
 
-    Token next() {
-      if (pushedBack.size() != 0) { Token t = pushedBack.back(); pushedBack.pop_back(); return t; }
-      Token ret("", "");
-      int maxnp = 0, sp = 0;
+    Token next();
+    void pushBack(const Token &p) { pushedBack.push_back(p); }
+  };
 
-      while(isspace(char(str[sp]))) sp++;
-      str = str.substr(sp);
-      lastpos = pos + sp;
+  struct Func;
+  struct Kernel;
+  class MappedFile;
 
-      if (str != "") ret = Token(string("character '") + str[0] + "'", "");
+  // A value paired with its derivative, for forward-mode automatic differentiation
+  struct Dual {
+    tlfloat_octuple v, d;
+  };
 
-      for(auto a : tokenDefs) {
-	smatch m;
-	if (!regex_match(str, m, a.second)) continue;
-	int np = (int)m.position(1) + (int)m[1].str().size();
-	if (np > maxnp) { maxnp = np; ret = Token(a.first, m[1].str()); }
-      }
+  // Expressions are compiled into postfix code, which is then run on a value stack
+  struct Insn {
+    enum Opcode { NUM, VAR, CALL, ASSIGN, JUMP, AND, OR, BRANCH, DIFF, SOLVE, LOOP, TEST, NEXT, MONTECARLO, ARRAY, RANGE, REDUCE, MATRIX } opcode;
+    int pos = 0;
+    tlfloat_octuple val = 0;		// NUM : the constant
+    const Func *func = nullptr;		// CALL, ASSIGN : the operator or function
+    tlfloat_octuple *var = nullptr;	// VAR, ASSIGN, DIFF, SOLVE : the variable
+    string_view name;			// NUM : the literal, VAR, ASSIGN : the variable, CALL, DIFF, SOLVE, LOOP, NEXT, MONTECARLO : the operator or function
+    int len = 0, off = 0;		// JUMP : insns to skip, DIFF, SOLVE : body length and distance back to the body,
+					// ARRAY : number of elements, REDUCE : the reduction, MATRIX : the operation,
+					// AND, OR : insns to skip if the top decides the result, BRANCH : insns to skip if the top is zero,
+					// LOOP : insns to skip if the count is zero, off is 1 if the count is on the stack,
+					// TEST : insns to skip if the condition is false, NEXT : distance back to the LOOP,
+					// MONTECARLO : length of the body, which follows it
+    Insn(Opcode o, int p) : opcode(o), pos(p) {}
+  };
 
-      if (maxnp > 0) { pos += sp + maxnp; str = str.substr(maxnp); }
+  // Times an insn was run, the time taken in ns, and the value on top of
+  // the stack after the last run, which seq orders among the insns
+  struct InsnProfile {
+    uint64_t count = 0, ns = 0, seq = 0;
+    tlfloat_octuple last = 0;
+  };
 
-      ret.pos = (int)lastpos;
+  // An error of parsing or evaluation, reported without exceptions. Only the
+  // code, the column and views of the offending text are recorded, and the
+  // message is formatted by message() when a caller needs it. The views
+  // point into the evaluated input, which has to be alive at that time.
+  struct Error {
+    enum Code {
+      NONE, SYNTAX, UNEXPECTED_END, UNEXPECTED_CHAR, UNEXPECTED_TOKEN, EXPECTED, NOT_LVALUE, ARG_COUNT,
+      VAR_EXPECTED, NESTING, DIFF_ASSIGN, DIFF_NESTED, NO_CONVERGENCE, SCALAR_EXPECTED, LENGTH_MISMATCH,
+      ARRAY_IN_DIFF, NESTED_ARRAY, INVALID_RANGE, CIRCULAR, DIFF_LOOP, ITERATION_COUNT, ITERATION_LIMIT,
+      ARRAY_IN_LOOP, ARRAY_IN_COMPILED, MONTECARLO_ASSIGN, MATRIX_EXPECTED, SHAPE_MISMATCH, SINGULAR_MATRIX,
+      MATRIX_FILE, ARRAY_IN_EXPLAIN, RECOMPUTE, INTERNAL,
+    } code = NONE;
+    int column = 0;
+    string_view arg;		// The token, function or expected text concerned
+    size_t n0 = 0, n1 = 0;	// ARG_COUNT : arguments expected, LENGTH_MISMATCH : the lengths, MATRIX_FILE : the line
+    string detail;		// CIRCULAR : the variables on the cycle, MATRIX_FILE : the problem,
+				// RECOMPUTE : the definition and its error, INTERNAL : the message
 
-      return ret;
-    }
+    explicit operator bool() const { return code != NONE; }
+    string message() const;
+  };
 
-    void pushBack(const Token &p) { pushedBack.push_back(p); }
+  // The outcome of an evaluation. On success, label is "RVAL", "LVAL:"
+  // followed by the assigned variable, "TEXT:" followed by the text to show
+  // instead of the value, or "INT:" followed by the exact integer. profile
+  // is the report of explain(), and is empty for other expressions.
+  struct Result {
+    Error error;
+    string label;
+    tlfloat_octuple value = 0;
+    string profile;
+    bool ok() const { return !error; }
+  };
+
+  // An expression compiled once by OctCore::compile, to be evaluated at many
+  // values of its parameter by OctCore::evaluateAt. It refers to the
+  // variables of the context that compiled it, is evaluated only by that
+  // context, and is invalidated by OctCore::clear().
+  class Compiled {
+    friend class OctCore;
+    string text;			// The names in code are views of it
+    vector<Insn> code;
+    tlfloat_octuple param = 0;	// Read by the VAR insns of the parameter
+  public:
+    Compiled() {}
+    Compiled(const Compiled &) = delete;
+    Compiled &operator=(const Compiled &) = delete;
   };
 
+  // Conversions between integral values and BigInt. toOctuple rounds to nearest.
+  BigInt toBigInt(tlfloat_octuple x);
+  tlfloat_octuple toOctuple(const BigInt &b);
+
   class OctCore {
-    vector<pair<string, tlfloat_octuple>> L0p(class Tokenizer& tk, vector<pair<string, tlfloat_octuple>> v);
-    pair<string, tlfloat_octuple> L1(class Tokenizer& tk), L0(class Tokenizer& tk);
-    pair<string, tlfloat_octuple> L2p(class Tokenizer& tk, pair<string, tlfloat_octuple> lhs);
-    pair<string, tlfloat_octuple> L2(class Tokenizer& tk) { return L2p(tk, L1(tk)); } // L2 ::= L1 L2p
-    pair<string, tlfloat_octuple> L3p(class Tokenizer& tk, pair<string, tlfloat_octuple> lhs);
-    pair<string, tlfloat_octuple> L3(class Tokenizer& tk) { return L3p(tk, L2(tk)); } // L3 ::= L2 L3p
-    pair<string, tlfloat_octuple> L4p(class Tokenizer& tk, pair<string, tlfloat_octuple> lhs);
-    pair<string, tlfloat_octuple> L4(class Tokenizer& tk) { return L4p(tk, L3(tk)); } // L4 ::= L3 L4p
-    pair<string, tlfloat_octuple> L5p(class Tokenizer& tk, pair<string, tlfloat_octuple> lhs);
-    pair<string, tlfloat_octuple> L5(class Tokenizer& tk) { return L5p(tk, L4(tk)); } // L5 ::= L4 L5p
-    pair<string, tlfloat_octuple> L6p(class Tokenizer& tk, pair<string, tlfloat_octuple> lhs);
-    pair<string, tlfloat_octuple> L6(class Tokenizer& tk) { return L6p(tk, L5(tk)); } // L6 ::= L5 L6p
-    pair<string, tlfloat_octuple> L7p(class Tokenizer& tk, pair<string, tlfloat_octuple> lhs);
-    pair<string, tlfloat_octuple> L7(class Tokenizer& tk) { return L7p(tk, L6(tk)); } // L7 ::= L6 L7p
-    pair<string, tlfloat_octuple> L8(class Tokenizer& tk), L8p(class Tokenizer& tk, const pair<string, tlfloat_octuple> &lval);
-    pair<string, tlfloat_octuple> LTop(class Tokenizer& tk) { return L8(tk); }
+    bool parse(class Tokenizer& tk);
+
+    // Records the first error of the evaluation, and returns false
+    bool fail(Error::Code code, int column, string_view arg = string_view(), size_t n0 = 0, size_t n1 = 0) {
+      if (!err_) { err_.code = code; err_.column = column; err_.arg = arg; err_.n0 = n0; err_.n1 = n1; }
+      return false;
+    }
+
+    void emit(Insn::Opcode o, int pos, const Func *func = nullptr) { code.push_back(Insn(o, pos)); code.back().func = func; }
+    bool isLval() const { return !code.empty() && (code.back().opcode == Insn::VAR || code.back().opcode == Insn::ASSIGN); }
+
+    tlfloat_octuple run(const Insn *pc, const Insn *end);
+    template<bool profiled> tlfloat_octuple runCode(const Insn *pc, const Insn *end);
+    Dual runDual(const Insn *pc, const Insn *end, const tlfloat_octuple *var, Dual x);
+    tlfloat_octuple solve(const Insn *pc, const Insn *end, const tlfloat_octuple *var, tlfloat_octuple x, int pos);
+    tlfloat_octuple monteCarlo(const Insn *pc, const Insn *end, uint64_t n, bool show);
+    size_t threads() const;
+
+    tlfloat_octuple call(const Func &f, const tlfloat_octuple *a);
+
+    void checkShift(tlfloat_octuple x, tlfloat_octuple y);
+    bool exactEligible() const;
+    bool runExact(BigInt &result);
+
+    tlfloat_octuple runArray();
+    tlfloat_octuple evalKernel(const Kernel &k, size_t i, tlfloat_octuple *stk);
+    void runKernel(const Kernel &k, tlfloat_octuple *out);
+    tlfloat_octuple reduceKernel(const Kernel &k, int kind);
+
+    void updateCache(const string &key, const Result &result);
+
+    // Recorded by run() for the insns of code while explain() profiles an evaluation
+    vector<InsnProfile> *profile_ = nullptr;
+    uint64_t profileSeq = 0;
+    bool explain(Result &r);
+
+    tlfloat_octuple *definedVar() const;
+    bool checkCycle(const tlfloat_octuple *var, string_view name);
+    void react(string_view str, tlfloat_octuple *defined);
+    void undefine(tlfloat_octuple *var);
+    void propagate(const vector<tlfloat_octuple *> &changed);
+
+    void release();
 
     unordered_map<string, tlfloat_octuple> varMap;
+
+    // State of rnd(), uniform() and seed(), so that contexts do not share a generator
+    Xoshiro256 rng_;
+
+    // The first error of the current evaluation
+    Error err_;
+
+    // Text shown in place of the value, set by builtins such as factor()
+    string text_;
+
+    // Exact values of the variables last assigned by the exact integer
+    // evaluation, valid while the variable still holds the rounded value
+    unordered_map<const tlfloat_octuple *, pair<BigInt, tlfloat_octuple>> exactVars;
+
+    // While checkRange is set, run() sets outOfRange if a value reaches 2^127
+    bool checkRange = false, outOfRange = false;
+
+    // Contents of the variables holding arrays, whose scalar value is NaN
+    unordered_map<const tlfloat_octuple *, vector<tlfloat_octuple>> arrays;
+
+    // Number of columns of the arrays that are matrices, which are stored by rows
+    unordered_map<const tlfloat_octuple *, size_t> columns;
+
+    // Set by the parser if the code builds, reduces or reads arrays
+    bool hasArrays = false;
+
+    // Threads used by array and matrix kernels, montecarlo() and reactive recomputation, 0 for all cores
+    unsigned threads_ = 0;
+
+    ResultCache cache;
+
+    // Reactive mode : the statement defining each variable with its code and
+    // the variables it reads, and the variables whose definitions read each
+    // variable. The code is that of the right-hand side, with the names
+    // viewing text.
+    struct Definition {
+      string text;
+      string_view name;
+      vector<Insn> code;
+      vector<pair<string, tlfloat_octuple *>> deps;
+    };
+    bool reactive_ = false;
+    unordered_map<const tlfloat_octuple *, Definition> defs;
+    unordered_map<const tlfloat_octuple *, vector<tlfloat_octuple *>> dependents;
+    size_t recomputed_ = 0;
+
+    // Per-evaluation temporaries, all allocated from the arena
+    Arena arena;
+    vector<Insn, ArenaAllocator<Insn>> code { ArenaAllocator<Insn>(arena) };
+    vector<tlfloat_octuple, ArenaAllocator<tlfloat_octuple>> stack { ArenaAllocator<tlfloat_octuple>(arena) };
+    vector<Dual, ArenaAllocator<Dual>> dstack { ArenaAllocator<Dual>(arena) };
   public:
-    pair<string, tlfloat_octuple> execute(const string &str);
-    void clear() { varMap.clear(); }
+    // Limit of the nesting of parentheses and function calls
+    static const int maxDepth = 1000;
+
+    // Limit of the number of iterations of iterate() and while(), and of the samples of montecarlo()
+    static const int maxIterations = 100000000;
+
+    // Evaluates an expression. The whole line may be explain(expression),
+    // which evaluates the expression once while timing each node of it, and
+    // gives the tree of the nodes in Result::profile.
+    Result evaluate(string_view str);
+
+    // As evaluate(), with an error given as the label "ERROR:" followed by the message
+    pair<string, tlfloat_octuple> execute(string_view str);
+
+    // Evaluates each line of a mapped script in place, passing the line number
+    // (from 1), the line and its result to the callback
+    void executeFile(MappedFile &file, const function<void(size_t, string_view, const Result &)> &callback);
+
+    // Compiles an expression of the variable param, which is bound to the
+    // Compiled object rather than to the variable of that name. Expressions
+    // with arrays cannot be compiled.
+    Error compile(string_view str, string_view param, Compiled &c);
+
+    // The value of a compiled expression at x, or NaN if the evaluation fails
+    tlfloat_octuple evaluateAt(Compiled &c, tlfloat_octuple x);
+
+    void clear() { varMap.clear(); exactVars.clear(); arrays.clear(); columns.clear(); cache.clear(); defs.clear(); dependents.clear(); }
+
+    // Access to scalar variables from outside expressions. setVar returns
+    // false if the name cannot be a variable, getVar if there is no such variable.
+    bool setVar(string_view name, tlfloat_octuple v);
+    bool getVar(string_view name, tlfloat_octuple &v) const;
+    // The scalar variables, to be copied to another context
+    vector<pair<string, tlfloat_octuple>> variables() const;
+
+    // Assigns a matrix read from a file to the variable. The file is either
+    // text, with the numbers of a row on each line separated by spaces or
+    // commas, where blank lines and lines starting with # are skipped, or a
+    // binary table written by Tabulator.
+    Error loadMatrix(string_view name, MappedFile &file);
+
+    // Results of expressions without side effects are cached within this
+    // many bytes. The cache is disabled with the default of 0.
+    void setCacheBudget(size_t bytes) { cache.setBudget(bytes); }
+    const ResultCache::Stats &cacheStats() const { return cache.getStats(); }
+
+    // Limits the threads used by array and matrix kernels, montecarlo() and reactive
+    // recomputation, which all cores are used for with the default of 0.
+    // Results do not depend on the number of threads.
+    void setThreads(unsigned n) { threads_ = n; }
+
+    // In reactive mode, "variable = expression" defines the variable by the
+    // expression, like a spreadsheet cell. Whenever a variable is assigned,
+    // the variables defined from it are recomputed in dependency order,
+    // independent ones in parallel. Any other assignment to a defined
+    // variable turns it back into a plain value, as does an assignment
+    // reading the variable it assigns, such as x = x + 1. A definition that
+    // would make a variable depend on itself through others is an error. A
+    // definition that fails to recompute is set to NaN, and the failure is
+    // the error of the evaluation.
+    void setReactive(bool on) { reactive_ = on; if (!on) { defs.clear(); dependents.clear(); } }
+    bool reactive() const { return reactive_; }
+    // Number of definitions recomputed by the last assignment
+    size_t recomputed() const { return recomputed_; }
+
+    Xoshiro256 &rng() { return rng_; }
+    void setText(const string &s) { text_ = s; }
   };
 }
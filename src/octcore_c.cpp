@@ -0,0 +1,96 @@
+#include <cstring>
+#include <new>
+
+#include "octcore.hpp"
+#include "octcore_c.h"
+
+using namespace octcore;
+
+struct octcore_context {
+  OctCore core;
+};
+
+namespace {
+  static_assert(sizeof(tlfloat_octuple) == sizeof(octcore_octuple), "tlfloat_octuple must be 256 bits wide");
+
+  octcore_octuple toRaw(tlfloat_octuple x) {
+    octcore_octuple r;
+    memcpy(&r, &x, sizeof(r));
+    return r;
+  }
+
+  tlfloat_octuple fromRaw(const octcore_octuple &r) {
+    tlfloat_octuple x;
+    memcpy(&x, &r, sizeof(x));
+    return x;
+  }
+
+  void copyOut(const string &s, char *msg, size_t msgsize) {
+    if (msg == nullptr || msgsize == 0) return;
+    size_t n = s.copy(msg, msgsize - 1);
+    msg[n] = '\0';
+  }
+}
+
+extern "C" {
+  octcore_context *octcore_create(void) {
+    return new(nothrow) octcore_context();
+  }
+
+  void octcore_destroy(octcore_context *ctx) {
+    delete ctx;
+  }
+
+  int octcore_eval(octcore_context *ctx, const char *expr, octcore_octuple *result, char *msg, size_t msgsize) {
+    if (ctx == nullptr || expr == nullptr || (msg == nullptr && msgsize != 0)) return OCTCORE_ERROR_ARG;
+    try {
+      Result r = ctx->core.evaluate(expr);
+      if (!r.ok()) {
+	if (msgsize != 0) copyOut(r.error.message(), msg, msgsize);
+	return OCTCORE_ERROR_EVAL;
+      }
+      if (result) *result = toRaw(r.value);
+      copyOut(r.label, msg, msgsize);
+      return OCTCORE_OK;
+    } catch(bad_alloc &) {
+      return OCTCORE_ERROR_NOMEM;
+    } catch(...) {
+      copyOut("Internal error", msg, msgsize);
+      return OCTCORE_ERROR_EVAL;
+    }
+  }
+
+  int octcore_set_var(octcore_context *ctx, const char *name, const octcore_octuple *value) {
+    if (ctx == nullptr || name == nullptr || value == nullptr) return OCTCORE_ERROR_ARG;
+    try {
+      return ctx->core.setVar(name, fromRaw(*value)) ? OCTCORE_OK : OCTCORE_ERROR_ARG;
+    } catch(...) {
+      return OCTCORE_ERROR_NOMEM;
+    }
+  }
+
+  int octcore_get_var(octcore_context *ctx, const char *name, octcore_octuple *value) {
+    if (ctx == nullptr || name == nullptr || value == nullptr) return OCTCORE_ERROR_ARG;
+    try {
+      tlfloat_octuple v;
+      if (!ctx->core.getVar(name, v)) return OCTCORE_ERROR_NOTFOUND;
+      *value = toRaw(v);
+      return OCTCORE_OK;
+    } catch(...) {
+      return OCTCORE_ERROR_NOMEM;
+    }
+  }
+
+  int octcore_format(const octcore_octuple *value, int hex, char *buf, size_t bufsize) {
+    if (value == nullptr || (buf == nullptr && bufsize != 0)) return -1;
+    return tlfloat_snprintf(buf, bufsize, hex ? "%Oa" : "%.70Og", fromRaw(*value));
+  }
+
+  octcore_octuple octcore_from_double(double d) {
+    return toRaw(tlfloat_octuple(d));
+  }
+
+  double octcore_to_double(const octcore_octuple *value) {
+    return value == nullptr ? 0 : (double)fromRaw(*value);
+  }
+}
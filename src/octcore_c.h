@@ -0,0 +1,71 @@
+/* C interface of octcore, for embedding from C and through FFI.
+ *
+ * Every call takes an opaque context, and nothing is shared between
+ * contexts, so any number of contexts can be used concurrently from
+ * different threads. A single context must not be used from two threads
+ * at the same time. No C++ exception crosses this interface.
+ */
+
+#ifndef OCTCORE_C_H
+#define OCTCORE_C_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(_WIN32)
+#if defined(OCTCORE_BUILDING_C_API)
+#define OCTCORE_API __declspec(dllexport)
+#else
+#define OCTCORE_API __declspec(dllimport)
+#endif
+#else
+#define OCTCORE_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct octcore_context octcore_context;
+
+/* An octuple-precision value as its raw IEEE 754 binary256 bits, least
+ * significant word first */
+typedef struct {
+  uint64_t w[4];
+} octcore_octuple;
+
+enum {
+  OCTCORE_OK = 0,
+  OCTCORE_ERROR_EVAL = 1,	/* Syntax or evaluation error, described in the message */
+  OCTCORE_ERROR_ARG = 2,	/* Null pointer or invalid variable name */
+  OCTCORE_ERROR_NOTFOUND = 3,	/* No such variable */
+  OCTCORE_ERROR_NOMEM = 4,
+};
+
+/* Returns NULL if memory cannot be allocated */
+OCTCORE_API octcore_context *octcore_create(void);
+OCTCORE_API void octcore_destroy(octcore_context *ctx);
+
+/* Evaluates one expression. On success, the value is stored in result if
+ * it is not NULL, and the label of the result ("RVAL", "LVAL:<variable>",
+ * "TEXT:<text>" or "INT:<digits>") is copied to msg. On OCTCORE_ERROR_EVAL,
+ * msg receives the error message. msg is truncated to msgsize bytes
+ * including the terminating NUL, and may be NULL if msgsize is 0. */
+OCTCORE_API int octcore_eval(octcore_context *ctx, const char *expr, octcore_octuple *result, char *msg, size_t msgsize);
+
+OCTCORE_API int octcore_set_var(octcore_context *ctx, const char *name, const octcore_octuple *value);
+OCTCORE_API int octcore_get_var(octcore_context *ctx, const char *name, octcore_octuple *value);
+
+/* Formats a value in decimal, or in hexadecimal if hex is nonzero. Returns
+ * the length of the whole text, as snprintf does. */
+OCTCORE_API int octcore_format(const octcore_octuple *value, int hex, char *buf, size_t bufsize);
+
+/* Converts between octuple and double, rounding to nearest */
+OCTCORE_API octcore_octuple octcore_from_double(double d);
+OCTCORE_API double octcore_to_double(const octcore_octuple *value);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* OCTCORE_C_H */
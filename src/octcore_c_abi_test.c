@@ -0,0 +1,49 @@
+/* Checks that the C interface compiles as C, and works when called from C.
+ * The header is included twice, as headers of a program may do. */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "octcore_c.h"
+#include "octcore_c.h"
+
+static int failures = 0;
+
+static void check(int ok, const char *what) {
+  if (!ok) {
+    printf("%s failed\n", what);
+    failures++;
+  }
+}
+
+int main(void) {
+  octcore_context *ctx = octcore_create();
+  octcore_octuple v, w;
+  char msg[256], buf[128];
+
+  check(ctx != NULL, "octcore_create");
+  if (ctx == NULL) return 1;
+
+  check(octcore_eval(ctx, "x = 1 + 2", &v, msg, sizeof(msg)) == OCTCORE_OK && strcmp(msg, "LVAL:x") == 0, "eval of an assignment");
+  check(octcore_to_double(&v) == 3, "value of an assignment");
+  check(octcore_get_var(ctx, "x", &w) == OCTCORE_OK && memcmp(&v, &w, sizeof(v)) == 0, "octcore_get_var");
+
+  v = octcore_from_double(0.25);
+  check(octcore_set_var(ctx, "y", &v) == OCTCORE_OK, "octcore_set_var");
+  check(octcore_eval(ctx, "x + y", &v, msg, sizeof(msg)) == OCTCORE_OK && strcmp(msg, "RVAL") == 0, "eval of an expression");
+  check(octcore_format(&v, 0, buf, sizeof(buf)) > 0 && strcmp(buf, "3.25") == 0, "octcore_format");
+
+  check(octcore_eval(ctx, "1 +", &v, msg, sizeof(msg)) == OCTCORE_ERROR_EVAL && strlen(msg) > 0, "eval error");
+  check(octcore_set_var(ctx, "sqrt", &v) == OCTCORE_ERROR_ARG, "invalid variable name");
+  check(octcore_get_var(ctx, "undefined_variable", &v) == OCTCORE_ERROR_NOTFOUND, "missing variable");
+  check(octcore_eval(NULL, "1", &v, msg, sizeof(msg)) == OCTCORE_ERROR_ARG, "null context");
+
+  octcore_destroy(ctx);
+
+  if (failures != 0) {
+    printf("Test failed\n");
+    return 1;
+  }
+  printf("Test passed\n");
+  return 0;
+}
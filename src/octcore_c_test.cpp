@@ -0,0 +1,106 @@
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+
+// Only the C interface is used, as an embedding program would
+#include "octcore_c.h"
+
+using namespace std;
+
+// Stress test of the C interface. Many threads create, use and destroy
+// their own contexts at the same time, and every result must be
+// bit-identical to the one computed by a single context beforehand.
+
+namespace {
+  const int nThreads = 16, nContexts = 4, nIter = 300;
+
+  const char *exprs[] = {
+    "y = x * x + sqrt(x)", "sin(x) * exp(-x / 7)", "seed(x) + rnd(1000000)", "z = y / (x + 1)",
+    "diff(tgamma(t), t, x / 10 + 1)", "sum(range(1, x, 1) * 2)", "factor(x * 6)", "x << 100",
+  };
+  const int nExprs = sizeof(exprs) / sizeof(exprs[0]);
+
+  struct Result {
+    int status;
+    octcore_octuple value;
+    string msg;
+  };
+
+  bool same(const Result &a, const Result &b) {
+    return a.status == b.status && memcmp(&a.value, &b.value, sizeof(a.value)) == 0 && a.msg == b.msg;
+  }
+
+  // Runs the expressions for one value of x in a context
+  void runOne(octcore_context *ctx, int x, Result *out) {
+    octcore_octuple v = octcore_from_double(x);
+    if (octcore_set_var(ctx, "x", &v) != OCTCORE_OK) { out[0].status = -1; return; }
+    for(int i=0;i<nExprs;i++) {
+      char msg[256];
+      memset(&out[i].value, 0, sizeof(out[i].value));
+      out[i].status = octcore_eval(ctx, exprs[i], &out[i].value, msg, sizeof(msg));
+      out[i].msg = msg;
+    }
+    octcore_octuple z;
+    if (octcore_get_var(ctx, "z", &z) != OCTCORE_OK || memcmp(&z, &out[3].value, sizeof(z)) != 0) out[0].status = -2;
+  }
+}
+
+int main(int argc, char **argv) {
+  // Reference results from one context
+  vector<Result> ref(nIter * nExprs);
+  octcore_context *ctx = octcore_create();
+  for(int x=0;x<nIter;x++) runOne(ctx, x, &ref[x * nExprs]);
+  octcore_destroy(ctx);
+
+  for(auto &r : ref) {
+    if (r.status < 0) {
+      printf("Reference run failed\n");
+      return -1;
+    }
+  }
+
+  octcore_octuple v = octcore_from_double(1.5);
+  ctx = octcore_create();
+  char buf[128];
+  if (octcore_set_var(ctx, "sqrt", &v) != OCTCORE_ERROR_ARG || octcore_set_var(ctx, "1x", &v) != OCTCORE_ERROR_ARG ||
+      octcore_get_var(ctx, "nosuchvar", &v) != OCTCORE_ERROR_NOTFOUND || octcore_eval(ctx, "1 +", nullptr, buf, sizeof(buf)) != OCTCORE_ERROR_EVAL ||
+      octcore_format(&v, 0, buf, sizeof(buf)) != 3 || string(buf) != "1.5") {
+    printf("Error handling failed\n");
+    return -1;
+  }
+  octcore_destroy(ctx);
+
+  atomic<int> nFailed(0);
+  vector<thread> threads;
+  for(int t=0;t<nThreads;t++) {
+    threads.emplace_back([&, t]() {
+      octcore_context *c[nContexts];
+      for(int i=0;i<nContexts;i++) c[i] = octcore_create();
+      vector<Result> res(nExprs);
+      for(int k=0;k<nIter;k++) {
+	const int x = (k * 7 + t * 13) % nIter, i = (k + t) % nContexts;
+	runOne(c[i], x, res.data());
+	for(int j=0;j<nExprs;j++) if (!same(res[j], ref[x * nExprs + j])) nFailed++;
+	if (k % 50 == 49) {
+	  // Contexts are destroyed and created while others are running
+	  octcore_destroy(c[i]);
+	  c[i] = octcore_create();
+	}
+      }
+      for(int i=0;i<nContexts;i++) octcore_destroy(c[i]);
+    });
+  }
+  for(auto &th : threads) th.join();
+
+  if (nFailed != 0) {
+    printf("%d result(s) differ from the reference\n", nFailed.load());
+    printf("Test failed\n");
+    return -1;
+  }
+
+  printf("Test passed\n");
+  return 0;
+}
@@ -0,0 +1,1010 @@
+#include <iostream>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <new>
+#include <atomic>
+#include <cstdlib>
+#include <stdexcept>
+#include <thread>
+#include <chrono>
+#include <algorithm>
+#if !defined(_WIN32)
+#include <unistd.h>
+#endif
+
+#include "octcore.hpp"
+#include "modarith.hpp"
+#include "factor.hpp"
+#include "bitops.hpp"
+#include "matrix.hpp"
+#include "history.hpp"
+#include "plot.hpp"
+#include "tabulate.hpp"
+#include "stats.hpp"
+#include "mappedfile.hpp"
+#include "server.hpp"
+
+using namespace octcore;
+
+// Counting allocator : every global allocation made while counting is on is tallied
+
+static std::atomic<bool> counting(false);
+static std::atomic<size_t> nAlloc(0);
+
+void *operator new(size_t size) {
+  if (counting) nAlloc++;
+  void *p = malloc(size == 0 ? 1 : size);
+  if (!p) throw std::bad_alloc();
+  return p;
+}
+void *operator new[](size_t size) { return operator new(size); }
+void operator delete(void *p) noexcept { free(p); }
+void operator delete[](void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+void operator delete[](void *p, size_t) noexcept { free(p); }
+
+static void testNoAllocation() {
+  static const char *exprs[] = {
+    "1+2*3", "x = 3", "x += (x = 5)", "a = b = 0x1.8p1", "-a*b/7 % 3", "(x) = ~x & 0xff | 1 ^ 2 << 3 >> 1",
+    "4*(4*atan(1/5) - atan(1/239))", "fma(x, 2, hypot(3, 4))", "pow(2, 0.5) + M_PI", "sqrt(2)*sqrt(2) - 2",
+    "diff(sin(x)*exp(x), x, 1)", "diff(tgamma(x), x, 3.5)", "solve(cos(x) - x, x, 1)", "seed(1) + rnd(6) + uniform()", "   ",
+    "y = 1", "iterate(1000, y = y - (y * y - 2) / (2 * y))", "while(y < 1e6, y = y * 3)",
+  };
+
+  OctCore oc;
+  for(auto e : exprs) oc.execute(e); // Warm up the arena and the lazily built tables
+
+  for(auto e : exprs) {
+    string s = e;
+    nAlloc = 0;
+    counting = true;
+    auto r = oc.execute(s);
+    counting = false;
+    cout << "\"" << e << "\" : " << nAlloc << " allocation(s)" << endl;
+    if (r.first.substr(0, 6) == "ERROR:") throw(runtime_error("unexpected error : " + r.first));
+    if (nAlloc != 0) throw(runtime_error(string("heap allocation during evaluation of ") + e));
+  }
+}
+
+// Machine-generated expressions with many terms, and deep nesting
+static void testLongExpression() {
+  const int n = 100000;
+  OctCore oc;
+
+  string s = "1";
+  for(int i=1;i<n;i++) s += i % 2 ? "+2*x" : "-x";
+  oc.execute("x = 1");
+  auto r = oc.execute(s);
+  cout << "long expression : " << r.first << endl;
+  if (r.first != "RVAL" || r.second != 1 + (n / 2) * 2 - (n / 2 - 1)) throw(runtime_error("long expression"));
+
+  s = "";
+  for(int i=0;i<n;i++) s += i % 4 < 2 ? "-" : "~";
+  r = oc.execute(s + "5");
+  if (r.first != "RVAL" || r.second != 5) throw(runtime_error("long chain of unary operators"));
+
+  s = "";
+  for(int i=0;i<n;i++) s += "v" + to_string(i % 100) + " = ";
+  r = oc.execute(s + "3");
+  if (r.first != "LVAL:v0" || r.second != 3) throw(runtime_error("long chain of assignments"));
+
+  s = string(OctCore::maxDepth, '(') + "1" + string(OctCore::maxDepth, ')');
+  r = oc.execute(s);
+  if (r.first != "RVAL" || r.second != 1) throw(runtime_error("nesting at the limit"));
+
+  s = string(n, '(') + "1" + string(n, ')');
+  r = oc.execute(s);
+  cout << "deep nesting : " << r.first << endl;
+  if (r.first.substr(0, 24) != "ERROR:Nesting too deep a") throw(runtime_error("deep nesting"));
+}
+
+// Seeded contexts reproduce each other, and jumped generators give different streams
+static void testRandom() {
+  OctCore a, b;
+  a.execute("seed(12345)");
+  b.execute("seed(12345)");
+  for(int i=0;i<1000;i++) {
+    auto e = i % 3 == 0 ? "rnd(0)" : i % 3 == 1 ? "rnd(1000)" : "uniform()";
+    auto ra = a.execute(e), rb = b.execute(e);
+    if (ra.first != "RVAL" || ra.second != rb.second) throw(runtime_error("seeded sequences differ"));
+    if (i % 3 == 1 && !(ra.second >= 0 && ra.second < 1000)) throw(runtime_error("rnd out of range"));
+    if (i % 3 == 2 && !(ra.second >= 0 && ra.second < 1)) throw(runtime_error("uniform out of range"));
+  }
+  auto rs = a.execute("seed(-1)");
+  if (rs.second == rs.second) throw(runtime_error("seed accepted a negative value"));
+
+  Xoshiro256 g(1), h(1);
+  h.jump();
+  if (g.next64() == h.next64()) throw(runtime_error("jump did not change the stream"));
+
+  Xoshiro256 p(7), q(7);
+  unsigned char buf[20];
+  p.nextBytes(buf, sizeof(buf));
+  uint64_t u0 = q.next64(), u1 = q.next64();
+  for(int i=0;i<8;i++) {
+    if (buf[i] != ((u0 >> (i * 8)) & 0xff) || buf[i + 8] != ((u1 >> (i * 8)) & 0xff)) throw(runtime_error("nextBytes"));
+  }
+}
+
+// 128-bit modular arithmetic, directly and through the builtins
+static void testModular() {
+  const U128 m127(~0ULL, ~0ULL >> 1), m128(0 - 159ULL, ~0ULL);	// 2^127-1 and 2^128-159 are prime
+  if (!isprime(m127) || !isprime(m128)) throw(runtime_error("isprime on a 128-bit prime"));
+  if (isprime(mul64(0 - 59ULL, 0 - 83ULL))) throw(runtime_error("isprime on a semiprime"));
+  if (isprime(U128(3825123056546413051ULL))) throw(runtime_error("isprime on a strong pseudoprime"));
+
+  U128 a(0x0123456789abcdefULL, 0x0fedcba987654321ULL), inv, e = m128;
+  e.subFrom(U128(1));
+  if (powmod(a, e, m128) != U128(1)) throw(runtime_error("Fermat's little theorem"));
+  if (!invmod(a, m128, inv) || mulmod(a, inv, m128) != U128(1)) throw(runtime_error("invmod"));
+  if (gcd(U128(0, 6), U128(0, 4)) != U128(0, 2)) throw(runtime_error("gcd"));
+  U128 p;
+  if (!mul128(U128(3, 1), U128(1ULL << 62), p) || p != U128(3ULL << 62, 1ULL << 62) || mul128(U128(0, 4), U128(1ULL << 62), p) ||
+      mul128(U128(0, 1), U128(0, 1), p) || mul128(m128, U128(2), p) || mul128(U128(~0ULL, 0x5555555555555555ULL), U128(3), p)) throw(runtime_error("mul128"));
+
+  OctCore oc;
+  static const struct { const char *expr; double val; } cases[] = {
+    { "powmod(3, 200, 1000000007)", 136318165 }, { "mulmod(123456789, 987654321, 1000000007)", 259106859 },
+    { "powmod(2, 10, 1024)", 0 }, { "invmod(3, 7)", 5 }, { "isprime(1000000007)", 1 }, { "isprime(561)", 0 },
+    { "gcd(12, -18)", 6 }, { "lcm(4, 6)", 12 }, { "lcm(0, 0)", 0 }, { "lcm(0, 5)", 0 }, { "lcm(4.5, 6)", 12 },
+    { "lcm(-4.5, 6)", -12 }, { "lcm(0.5, 7)", 0 }, { "lcm(pow(2, 100) + 0.5, pow(2, 27) * 3)", 0x3p+100 },
+  };
+  for(auto &c : cases) {
+    auto r = oc.execute(c.expr);
+    if (r.first != "RVAL" || r.second != c.val) throw(runtime_error(string("wrong result of ") + c.expr));
+  }
+  auto r = oc.execute("invmod(2, 4)");
+  if (r.second == r.second) throw(runtime_error("invmod of a non-invertible number"));
+  r = oc.execute("lcm(pow(2, 127) + 0.5, 3)");
+  if (r.second == r.second) throw(runtime_error("lcm overflowing 128 bits"));
+}
+
+static void testFactor() {
+  const uint64_t p = 1099511627791ULL, q = 0xffffffffffffffc5ULL;	// A 41-bit prime, and 2^64-59
+  const U128 n = mul64(p, q);
+  auto f = factorize(mulmod(n, U128(4), U128(~0ULL, ~0ULL)));
+  if (f.size() != 4 || f[0] != U128(2) || f[1] != U128(2) || f[2] != U128(p) || f[3] != U128(q))
+    throw(runtime_error("factorize"));
+  for(int t=1;t<=4;t++) if (factorize(n, t).size() != 2) throw(runtime_error("factorize with threads"));
+
+  OctCore oc;
+  auto r = oc.execute("factor(600851475143)");
+  if (r.first != "TEXT:71 * 839 * 1471 * 6857" || r.second != 600851475143.0) throw(runtime_error("factor : " + r.first));
+  r = oc.execute("factor(360)");
+  if (r.first != "TEXT:2^3 * 3^2 * 5") throw(runtime_error("factor : " + r.first));
+  r = oc.execute("x = 360");
+  if (r.first != "LVAL:x") throw(runtime_error("text of factor() left over"));
+}
+
+static void testBits() {
+  cout << "bit instructions : " << (bitops::features().empty() ? "none" : bitops::features()) << endl;
+
+  // The accelerated implementations must match the portable ones bit for bit,
+  // on sparse and dense words alike
+  Xoshiro256 rng(42);
+  auto word = [&](int density) {
+    uint64_t w[2];
+    for(auto &x : w) {
+      x = rng.next64();
+      for(int i=0;i<density;i++) x = density < 0 ? x | rng.next64() : x & rng.next64();
+    }
+    return U128(w[0], rng.next64() % 4 == 0 ? 0 : w[1]);
+  };
+  for(int i=0;i<100000;i++) {
+    const U128 u = word(i % 5), m = word(i % 7 - 2);
+    if (bitops::popcount(u) != bitops::portable::popcount(u) || bitops::clz(u) != bitops::portable::clz(u) ||
+	bitops::ctz(u) != bitops::portable::ctz(u) || bitops::pdep(u, m) != bitops::portable::pdep(u, m) ||
+	bitops::pext(u, m) != bitops::portable::pext(u, m))
+      throw(runtime_error("bits : the accelerated result differs from the portable one"));
+    if (bitops::pdep(bitops::pext(u, m), m) != U128(u.lo & m.lo, u.hi & m.hi) ||
+	bitops::bitreverse(bitops::bitreverse(u)) != u || bitops::rotr(bitops::rotl(u, i), i) != u)
+      throw(runtime_error("bits : identities"));
+  }
+
+  OctCore oc;
+  struct { const char *expr; double value; } cases[] = {
+    { "popcount(0xff)", 8 }, { "popcount(-1)", 128 }, { "parity(7)", 1 }, { "clz(1)", 127 }, { "clz(0)", 128 },
+    { "ctz(0)", 128 }, { "ctz(1 << 100)", 100 }, { "bswap(1) == 1 << 120", 1 }, { "bitreverse(1) == 0x1p127", 1 },
+    { "rotl(1, 130)", 4 }, { "rotr(1, 1) == 0x1p127", 1 }, { "rotl(-1, 5) == 0x1p128 - 1", 1 }, { "pdep(5, 0xf0)", 0x50 },
+    { "pext(0x50, 0xf0)", 5 }, { "pext(0x1p64 + 0x1p63, 0x1p64 + 0x1p63)", 3 }, { "pdep(3, 0x1p64 + 0x1p63) == 0x1p64 + 0x1p63", 1 },
+    { "popcount(0.5)", NAN }, { "clz(0x1p128)", NAN }, { "rotl(1, 0.5)", NAN },
+  };
+  for(auto &c : cases) {
+    auto r = oc.execute(c.expr);
+    if (r.first.substr(0, 6) == "ERROR:" || !(r.second == c.value || (isnan(c.value) && r.second != r.second)))
+      throw(runtime_error(string("bits : ") + c.expr + " : " + r.first));
+  }
+}
+
+static void testExact() {
+  BigInt a;
+  if (!BigInt::parse("0x123456789abcdef0123456789abcdef0123456789", a) || a.toString(16) != "0x123456789abcdef0123456789abcdef0123456789")
+    throw(runtime_error("BigInt::parse"));
+  if ((a * a - BigInt(1)).toString() != ((a - BigInt(1)) * (a + BigInt(1))).toString()) throw(runtime_error("BigInt multiplication"));
+  BigInt q, r;
+  BigInt::divMod(BigInt::factorial(3000), BigInt::factorial(2998), q, r);
+  if (q != BigInt(3000 * 2999) || !r.isZero()) throw(runtime_error("BigInt division"));
+
+  // Divisors on both sides of the threshold of the recursive division, with
+  // random limbs, with limbs of all ones that make the estimated quotients
+  // too large, and with dividends y B^k - 1 whose top halves equal those of y
+  Xoshiro256 rng(3);
+  for(size_t nb : { 1, 2, 63, 64, 65, 127, 130, 300, 517 }) {
+    for(size_t nq : { 0, 1, 2, 64, 300, 1100 }) {
+      for(int pattern=0;pattern<5;pattern++) {
+	vector<uint64_t> la(nb + nq), lb(nb);
+	for(auto &x : la) x = pattern & 1 ? ~0ULL : rng.next64();
+	for(auto &x : lb) x = pattern & 2 ? ~0ULL : rng.next64();
+	lb[0] ^= rng.next64() & 0xff;
+	const BigInt y = BigInt::fromLimbs(lb, pattern == 2);
+	const BigInt x = pattern == 4 ? (y << (64 * nq)) - BigInt(1) : BigInt::fromLimbs(la, pattern == 1);
+	BigInt::divMod(x, y, q, r);
+	BigInt ar = r.isNegative() ? -r : r, ay = y.isNegative() ? -y : y;
+	if (q * y + r != x || !(ar < ay) || (!r.isZero() && r.isNegative() != x.isNegative())) {
+	  throw(runtime_error("BigInt division of " + to_string(nb + nq) + " limbs by " + to_string(nb)));
+	}
+      }
+    }
+  }
+  BigInt::parse("1" + string(30000, '0') + "7", a);
+  const string d = a.toString();
+  if (d.size() != 30002 || d.front() != '1' || d.back() != '7' || d.find_first_not_of('0', 1) != 30001) throw(runtime_error("BigInt::toString"));
+
+  OctCore oc;
+  auto p = oc.execute("factorial(1000)");
+  if (p.first.size() != 4 + 2568 || p.first.substr(0, 16) != "INT:402387260077") throw(runtime_error("factorial(1000) : " + p.first.substr(0, 16)));
+  p = oc.execute("(1 << 200) >> 199");
+  if (p.first != "RVAL" || p.second != 2) throw(runtime_error("exact shift"));
+  p = oc.execute("binomial(200, 100) % 1000000007");
+  if (p.first != "RVAL" || p.second != 407336795) throw(runtime_error("binomial"));
+  p = oc.execute("(factorial(40) + 7) / 2");
+  if (p.first.substr(0, 4) == "INT:") throw(runtime_error("inexact division"));
+
+  // Integers in [2^128, 2^237) from literals with exponents, and from variables
+  // holding them without an exact value
+  const struct { const char *expr; string label; } big[] = {
+    { "1e40 * 3", "INT:30000000000000000000000000000000000000000" },
+    { "0x1p130 + 1", "INT:1361129467683753853853498429727072845825" },
+    { "1e300 + 1", "INT:1" + string(299, '0') + "1" },
+    { "(1 << 200) + 120e-1", "INT:1606938044258990275541962092341162602522202993782792835301388" },
+    { "(1 << 200) + 0x1.8p1", "INT:1606938044258990275541962092341162602522202993782792835301379" },
+    { "u = sqrt(4) * 0x1p140", "LVAL:u" }, { "u + 1", "INT:2787593149816327892691964784081045188247553" },
+    { "v = -sqrt(4) * 0x1p159", "LVAL:v" }, { "v - 1", "INT:-1461501637330902918203684832716283019655932542977" },
+    { "w = sqrt(4) * 0x1p235", "LVAL:w" },
+    { "w + 1", "INT:110427941548649020598956093796432407239217743554726184882600387580788737" },
+  };
+  for(auto &c : big) {
+    p = oc.execute(c.expr);
+    if (p.first != c.label) throw(runtime_error(string("exact integer : ") + c.expr + " : " + p.first.substr(0, 60)));
+  }
+  // A literal whose fraction is lost to rounding is not exact
+  p = oc.execute("(1 << 200) + 0.12345678901234567890123456789012345678901234567890123456789012345678901234567890123e80");
+  if (p.first.substr(0, 4) == "INT:") throw(runtime_error("exact integer : literal with a fraction"));
+
+  oc.execute("x = 1 << 150");
+  oc.execute("x += 1");
+  p = oc.execute("x - (1 << 150)");
+  if (p.first != "RVAL" || p.second != 1) throw(runtime_error("exact variable"));
+}
+
+static void testArray() {
+  OctCore oc;
+  auto r = oc.execute("[1, 2, 3] * 2 + 1");
+  if (r.first != "TEXT:[3, 5, 7]" || r.second != 3) throw(runtime_error("array literal : " + r.first));
+  r = oc.execute("dot([1, 2, 3], [4, 5, 6])");
+  if (r.first != "RVAL" || r.second != 32) throw(runtime_error("dot"));
+  r = oc.execute("[1, 2] + [1, 2, 3]");
+  if (r.first.substr(0, 6) != "ERROR:") throw(runtime_error("length mismatch"));
+
+  // Large enough to be split into chunks over several threads
+  oc.execute("x = range(1, 1e6, 1)");
+  r = oc.execute("sum(x)");
+  if (r.second != 500000500000.0) throw(runtime_error("sum over a range"));
+  r = oc.execute("max(fmod(x * 7, 1000003)) + min(x - 1) + prod([2, 3, 4])");
+  if (r.second != 1000002 + 0 + 24) throw(runtime_error("reductions"));
+  oc.execute("x *= 0.5");
+  r = oc.execute("sum(x) - sum(range(0.5, 500000, 0.5))");
+  if (r.second != 0) throw(runtime_error("compound assignment to an array"));
+  oc.execute("x = 3");
+  r = oc.execute("x * 2");
+  if (r.first != "RVAL" || r.second != 6) throw(runtime_error("array variable replaced by a scalar"));
+}
+
+static void testMatrix() {
+  OctCore oc;
+  oc.execute("a = [[4, 3], [6, 3]]");
+  auto r = oc.execute("a * 2 - 1");
+  if (r.first != "TEXT:[[7, 5], [11, 5]]" || r.second != 4) throw(runtime_error("matrix literal : " + r.first));
+  r = oc.execute("det(a)");
+  if (r.first != "RVAL" || r.second != -6) throw(runtime_error("det"));
+  r = oc.execute("matmul(a, inv(a))");
+  if (r.first != "TEXT:[[1, 0], [0, 1]]") throw(runtime_error("inv : " + r.first));
+  r = oc.execute("linsolve(a, [10, 12])");
+  if (r.first != "TEXT:[1, 2]") throw(runtime_error("linsolve : " + r.first));
+  r = oc.execute("matmul([[1, 2, 3], [4, 5, 6]], transpose([[1, 2, 3], [4, 5, 6]]))");
+  if (r.first != "TEXT:[[14, 32], [32, 77]]") throw(runtime_error("matmul : " + r.first));
+  r = oc.execute("matmul([1, 1], a)");
+  if (r.first != "TEXT:[10, 6]") throw(runtime_error("matmul with a vector : " + r.first));
+
+  auto code = [&](const char *e) { oc.evaluate("0"); return oc.evaluate(e).error.code; };
+  if (code("a + [1, 2, 3, 4]") != Error::SHAPE_MISMATCH || code("matmul(a, [[1, 2]])") != Error::SHAPE_MISMATCH ||
+      code("det([[1, 2, 3], [4, 5, 6]])") != Error::MATRIX_EXPECTED || code("inv([1, 2])") != Error::MATRIX_EXPECTED ||
+      code("inv([[1, 2], [2, 4]])") != Error::SINGULAR_MATRIX || code("[[1, 2], [3]]") != Error::LENGTH_MISMATCH ||
+      code("[[1, 2], 3]") != Error::NESTED_ARRAY || code("[[[1]]]") != Error::NESTED_ARRAY) throw(runtime_error("matrix errors"));
+  if (oc.execute("det([[1, 2], [2, 4]])").second != 0) throw(runtime_error("det of a singular matrix"));
+
+  // The blocked kernels give the bits of the textbook algorithms, on any number of threads
+  const size_t n = 75;
+  Xoshiro256 rng(11);
+  vector<tlfloat_octuple> m(n * n), m2(n * n);
+  for(auto &x : m) x = tlfloat_octuple(double(int64_t(rng.next64())) * 0x1p-63);
+  for(auto &x : m2) x = tlfloat_octuple(double(int64_t(rng.next64())) * 0x1p-63);
+
+  vector<tlfloat_octuple> p1(n * n), p3(n * n), ref(n * n, tlfloat_octuple(0));
+  for(size_t i=0;i<n;i++) for(size_t k=0;k<n;k++) for(size_t j=0;j<n;j++) ref[i * n + j] += m[i * n + k] * m2[k * n + j];
+  matrix::multiply(m.data(), m2.data(), p1.data(), n, n, n, 1);
+  matrix::multiply(m.data(), m2.data(), p3.data(), n, n, n, 3);
+  if (p1 != ref || p3 != ref) throw(runtime_error("matrix : multiply"));
+
+  vector<tlfloat_octuple> f1 = m, f3 = m, lu = m;
+  vector<size_t> perm1, perm3;
+  int sign1, sign3;
+  if (!matrix::lu(f1.data(), n, perm1, sign1, 1) || !matrix::lu(f3.data(), n, perm3, sign3, 3)) throw(runtime_error("matrix : singular"));
+  for(size_t j=0;j<n;j++) {
+    size_t piv = j;
+    for(size_t i=j+1;i<n;i++) if (tlfloat_fabso(lu[i * n + j]) > tlfloat_fabso(lu[piv * n + j])) piv = i;
+    swap_ranges(lu.begin() + j * n, lu.begin() + (j + 1) * n, lu.begin() + piv * n);
+    for(size_t i=j+1;i<n;i++) {
+      lu[i * n + j] /= lu[j * n + j];
+      for(size_t c=j+1;c<n;c++) lu[i * n + c] -= lu[i * n + j] * lu[j * n + c];
+    }
+  }
+  if (f1 != lu || f3 != lu || perm1 != perm3 || sign1 != sign3) throw(runtime_error("matrix : LU factorization"));
+
+  // The inverse through the language
+  string lit = "b = [";
+  for(size_t i=0;i<n;i++) {
+    lit += i == 0 ? "[" : ", [";
+    for(size_t j=0;j<n;j++) {
+      char buf[128];
+      tlfloat_snprintf(buf, sizeof(buf), "%.70Og", m[i * n + j]);
+      lit += string(j == 0 ? "" : ", ") + buf;
+    }
+    lit += "]";
+  }
+  if (oc.execute(lit + "]").first.substr(0, 6) == "ERROR:") throw(runtime_error("matrix : literal"));
+  r = oc.execute("max(fabs(linsolve(b, matmul(b, range(1, 75, 1))) - range(1, 75, 1))) + max(fabs(matmul(inv(b), b) - inv(inv(matmul(inv(b), b)))))");
+  if (!(r.second < 1e-60)) throw(runtime_error("matrix : inverse"));
+
+  const string path = "octcore_test_matrix.txt";
+  {
+    FILE *fp = fopen(path.c_str(), "wb");
+    if (!fp) throw(runtime_error("matrix : cannot create the file"));
+    fputs("# 2 x 3\n1, 2, 3\n\n4 5 6\n", fp);
+    fclose(fp);
+  }
+  {
+    MappedFile file(path);
+    if (oc.loadMatrix("c", file)) throw(runtime_error("matrix : load"));
+  }
+  remove(path.c_str());
+  r = oc.execute("matmul(c, transpose(c))");
+  if (r.first != "TEXT:[[14, 32], [32, 77]]") throw(runtime_error("matrix : loaded " + r.first));
+  oc.execute("c = 1");
+  if (oc.execute("c + 1").second != 2) throw(runtime_error("matrix variable replaced by a scalar"));
+}
+
+static void testCache() {
+  OctCore oc;
+  oc.setCacheBudget(1 << 16);
+  oc.execute("a = 2");
+  auto r = oc.execute("tgamma(a + 0.5)");
+  r = oc.execute(" tgamma( a+0.5 ) ");
+  auto &st = oc.cacheStats();
+  if (st.hits != 1 || st.misses != 1 || st.bypassed != 1) throw(runtime_error("cache : expected a hit"));
+  oc.execute("a += 1");
+  auto r2 = oc.execute("tgamma(a + 0.5)");
+  if (st.hits != 1 || r2.second == r.second) throw(runtime_error("cache : stale result after an assignment"));
+  oc.execute("seed(1)");
+  auto u1 = oc.execute("uniform()"), u2 = oc.execute("uniform()");
+  if (u1.second == u2.second || st.hits != 1) throw(runtime_error("cache : side effects must bypass the cache"));
+
+  // Entries are evicted to stay within the budget
+  for(int i=0;i<1000;i++) oc.execute("sqrt(" + to_string(i) + ")");
+  if (st.bytes > st.budget || st.evictions == 0) throw(runtime_error("cache : budget exceeded"));
+  r = oc.execute("sqrt(999)");
+  if (st.hits != 2) throw(runtime_error("cache : the most recent entry was evicted"));
+}
+
+static void testConditional() {
+  OctCore oc;
+  struct { const char *expr; double value; } cases[] = {
+    { "1 < 2", 1 }, { "2 <= 1", 0 }, { "3 > 3", 0 }, { "3 >= 3", 1 }, { "1 == 1 == 1", 1 }, { "2 != 2", 0 },
+    { "!0 + !5", 1 }, { "2 && 3", 1 }, { "2 && 0", 0 }, { "0 || -0", 0 }, { "0 || 7", 1 },
+    { "1 + 2 == 3 && 4 > 3 || 0", 1 }, { "0 ? 10 : 1 ? 20 : 30", 20 }, { "(1 ? 2 : 3) * 5", 10 },
+    { "0 < 1 ? 1 < 0 ? 1 : 2 : 3", 2 }, { "(1 << 200) > (1 << 199)", 1 }, { "nan == nan", 0 }, { "nan && 1", 1 },
+    { "diff(x > 0 ? x * x : -x, x, 3)", 6 }, { "diff(x > 0 ? x * x : -x, x, -3)", -1 },
+    { "sum(range(1, 10, 1) > 5)", 5 }, { "1 ? sum([1, 2]) : max([3])", 3 },
+  };
+  for(auto &c : cases) {
+    auto r = oc.execute(c.expr);
+    if (r.first.substr(0, 6) == "ERROR:" || r.second != c.value) throw(runtime_error(string("conditional : ") + c.expr + " : " + r.first));
+  }
+
+  // The operand not taken is never evaluated
+  oc.execute("n = 0");
+  for(auto e : { "0 && (n = 1)", "1 || (n = 1)", "1 ? 2 : (n = 1)", "0 ? (n = 1) : 2", "0 ? 1 : 0 ? (n = 1) : 2", "1 ? 1 : [n = 1]" }) {
+    oc.execute(e);
+    if (oc.execute("n").second != 0) throw(runtime_error(string("conditional : ") + e + " evaluated the branch not taken"));
+  }
+  if (oc.execute("1 && (n = 5)").second != 1 || oc.execute("n").second != 5) throw(runtime_error("conditional : branch taken"));
+
+  if (oc.execute("0 ? 1 : n").first != "RVAL") throw(runtime_error("conditional : the result is not a variable"));
+  if (oc.execute("1 ? 2").first != "ERROR:':' expected at column 5") throw(runtime_error("conditional : missing ':'"));
+  if (oc.execute("[1, 2] ? 1 : 2").first.substr(0, 31) != "ERROR:Scalar argument expected ") throw(runtime_error("conditional : array condition"));
+}
+
+// Every function of funcMap with a derivative rule, at a point inside its
+// domain, is checked against an 8th order central difference. The ones
+// without a rule are piecewise constant, and differentiate to 0.
+static void testDerivatives() {
+  OctCore oc;
+  struct { const char *expr; double at; } cases[] = {
+    { "sqrt(t)", 2 }, { "cbrt(t)", 2 }, { "sin(t)", 0.7 }, { "cos(t)", 0.7 }, { "tan(t)", 0.4 },
+    { "asin(t)", 0.4 }, { "acos(t)", 0.4 }, { "atan(t)", 0.8 }, { "sinh(t)", 0.9 }, { "cosh(t)", 0.9 },
+    { "tanh(t)", 0.6 }, { "asinh(t)", 1.3 }, { "acosh(t)", 2 }, { "atanh(t)", 0.3 }, { "log(t)", 1.5 },
+    { "log2(t)", 1.5 }, { "log10(t)", 1.5 }, { "log1p(t)", 0.5 }, { "exp(t)", 0.6 }, { "exp2(t)", 0.6 },
+    { "exp10(t)", 0.6 }, { "expm1(t)", 0.6 }, { "erf(t)", 0.7 }, { "erfc(t)", 0.7 }, { "tgamma(t)", 3.5 },
+    { "lgamma(t)", 2.5 }, { "fabs(t)", -2 }, { "fabs(t)", 3 }, { "sinpi(t)", 0.3 }, { "cospi(t)", 0.3 },
+    { "tanpi(t)", 0.1 }, { "pow(t, 2.5)", 1.7 }, { "pow(1.7, t)", 2.5 }, { "pow(t, t)", 1.3 },
+    { "atan2(t, 2)", 1.5 }, { "atan2(2, t)", 1.5 }, { "hypot(t, 2)", 1.5 }, { "hypot(2, t)", 1.5 },
+    { "fdim(t, 1)", 2 }, { "fdim(t, 1)", 0.5 }, { "fdim(1, t)", 0.5 }, { "fmax(t, 1)", 2 }, { "fmax(t, 1)", 0.5 },
+    { "fmin(t, 1)", 2 }, { "fmin(t, 1)", 0.5 }, { "fmod(t, 1.3)", 3.7 }, { "fmod(5.2, t)", 1.5 },
+    { "fmod(-5.2, t)", 1.5 }, { "remainder(t, 1.3)", 3.7 }, { "remainder(5.2, t)", 1.5 },
+    { "copysign(t, -1)", 2 }, { "copysign(2, t)", 1 }, { "fma(t, 2, 3)", 1.5 }, { "fma(2, t, 3)", 1.5 },
+    { "fma(2, 3, t)", 1.5 }, { "fma(t, t, t)", 1.5 }, { "ldexp(t, 3)", 1.1 }, { "ldexp(1.1, t)", 3.5 },
+  };
+  const tlfloat_octuple h = tlfloat_octuple(1) / 100000;
+  const double w[] = { 672, -168, 32, -3 };
+  for(auto &c : cases) {
+    Compiled f, df;
+    if (oc.compile(c.expr, "t", f) || oc.compile(string("diff(") + c.expr + ", t, t)", "t", df)) throw(runtime_error(string("derivatives : ") + c.expr + " : compile"));
+    tlfloat_octuple n = 0;
+    for(int k=1;k<=4;k++) n += w[k-1] * (oc.evaluateAt(f, c.at + k * h) - oc.evaluateAt(f, c.at - k * h));
+    n /= 840 * h;
+    const tlfloat_octuple d = oc.evaluateAt(df, c.at);
+    if (!(tlfloat_fabso(d - n) <= 1e-28 * (1 + tlfloat_fabso(d)))) {
+      char buf[200];
+      tlfloat_snprintf(buf, sizeof(buf), "%s at %g : %.30Og, expected %.30Og", c.expr, c.at, d, n);
+      throw(runtime_error(string("derivatives : ") + buf));
+    }
+  }
+
+  for(auto e : { "trunc(t)", "floor(t)", "ceil(t)", "round(t)", "rint(t)", "int(t)", "gcd(t, 4)", "lcm(t, 4)",
+      "mulmod(t, 5, 7)", "powmod(t, 5, 7)", "invmod(t, 7)", "isprime(t)", "popcount(t)", "parity(t)",
+      "clz(t)", "ctz(t)", "bswap(t)", "bitreverse(t)", "rotl(t, 3)", "rotr(t, 3)", "pdep(t, 255)", "pext(t, 255)",
+      "factorial(t)", "binomial(t, 3)" }) {
+    auto r = oc.execute(string("diff(") + e + ", t, 6)");
+    if (r.first != "RVAL" || r.second != 0) throw(runtime_error(string("derivatives : ") + e + " : " + r.first));
+  }
+}
+
+static void testLoop() {
+  OctCore oc;
+  // Newton's iteration for sqrt(2), a million steps in one evaluation
+  oc.execute("x = 1");
+  auto r = oc.execute("iterate(1000000, x = x - (x * x - 2) / (2 * x))");
+  if (r.first != "RVAL" || tlfloat_fabso(r.second - tlfloat_sqrto(2)) > 1e-70 || oc.execute("x").second != r.second)
+    throw(runtime_error("loop : newton : " + r.first));
+
+  struct { const char *expr; double value; } cases[] = {
+    { "n = 0", 0 }, { "iterate(10, n += 1)", 10 }, { "iterate(0, n += 1)", NAN }, { "n", 10 },
+    { "while(n < 100, n = n * 2)", 160 }, { "while(n < 100, n = n * 2)", NAN }, { "n", 160 },
+    { "f = 1", 1 }, { "k = 0", 0 }, { "while((k += 1) <= 10, f *= k)", 3628800 },
+    { "iterate(3, iterate(4, n += 1))", 172 }, { "1 < 2 ? iterate(2, n -= 1) : 0", 170 }, { "0 && iterate(5, n = 0)", 0 },
+    { "n", 170 }, { "iterate(2, iterate(0, 1))", NAN },
+  };
+  for(auto &c : cases) {
+    r = oc.execute(c.expr);
+    if (r.first.substr(0, 6) == "ERROR:" || !(r.second == c.value || (isnan(c.value) && r.second != r.second)))
+      throw(runtime_error(string("loop : ") + c.expr + " : " + r.first));
+  }
+
+  for(auto &c : vector<pair<const char *, const char *>> {
+      { "iterate(-1, 1)", "ERROR:Invalid number of iterations for iterate at column 0" },
+      { "iterate(1.5, 1)", "ERROR:Invalid number of iterations for iterate at column 0" },
+      { "iterate(1)", "ERROR:2 argument(s) expected for iterate at column 0" },
+      { "diff(iterate(2, t * t), t, 1)", "ERROR:Loops cannot be differentiated at column 5" },
+      { "iterate(2, [1, 2])", "ERROR:Arrays cannot be used in loops at column 0" },
+    }) {
+    if (oc.execute(c.first).first != c.second) throw(runtime_error(string("loop : ") + c.first + " : " + oc.execute(c.first).first));
+  }
+}
+
+static void testMonteCarlo() {
+  OctCore oc;
+  // The mean of uniform() is 1/2, with a standard error of sqrt(1/12/n)
+  oc.execute("seed(1)");
+  const auto t0 = chrono::steady_clock::now();
+  auto r = oc.execute("montecarlo(1000000, uniform())");
+  const double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count();
+  const double se = sqrt(1.0 / 12 / 1000000);
+  const size_t pm = r.first.find(" +/- ");
+  if (r.first.substr(0, 5) != "TEXT:" || pm == string::npos || fabs((double)r.second - 0.5) > 5 * se ||
+      !(fabs(strtod(r.first.c_str() + pm + 5, nullptr) / se - 1) < 0.01)) throw(runtime_error("montecarlo : uniform : " + r.first));
+  cout << "montecarlo : " << r.first.substr(5) << " in " << ms << " ms" << endl;
+
+  // The same seed gives the same bits on any number of threads
+  auto run = [&](unsigned threads, const char *expr) {
+    oc.setThreads(threads);
+    oc.execute("seed(12345)");
+    return oc.execute(expr);
+  };
+  for(const char *expr : { "montecarlo(20000, rnd(6) + 1)", "montecarlo(10000, a * uniform() + diff(t * t, t, uniform()))" }) {
+    oc.execute("a = 3");
+    auto r1 = run(1, expr), r3 = run(3, expr), rAll = run(0, expr);
+    if (r1.first.substr(0, 5) != "TEXT:" || r1.second != r3.second || r1.second != rAll.second ||
+	r1.first != r3.first || r1.first != rAll.first)
+      throw(runtime_error(string("montecarlo : reproducibility : ") + expr + " : " + r1.first + " " + r3.first));
+  }
+  // The streams of the chunks are independent of each other, and of the next evaluation
+  if (oc.execute("montecarlo(2048, rnd(0))").second == oc.execute("montecarlo(2048, rnd(0))").second)
+    throw(runtime_error("montecarlo : streams"));
+  r = oc.execute("m = montecarlo(1, 7)");
+  if (r.first != "LVAL:m" || r.second != 7) throw(runtime_error("montecarlo : in an assignment : " + r.first));
+
+  for(auto &c : vector<pair<const char *, const char *>> {
+      { "montecarlo(0, 1)", "ERROR:Invalid number of iterations for montecarlo at column 0" },
+      { "montecarlo(10, x = 1)", "ERROR:Assignment cannot be used in montecarlo at column 17" },
+      { "montecarlo(5000, solve(t * t + uniform() + 1, t, 1))", "ERROR:solve did not converge" },
+      { "diff(montecarlo(2, t), t, 1)", "ERROR:Loops cannot be differentiated at column 5" },
+      { "montecarlo(2, [1, 2])", "ERROR:Arrays cannot be used in loops at column 0" },
+    }) {
+    if (oc.execute(c.first).first != c.second) throw(runtime_error(string("montecarlo : ") + c.first + " : " + oc.execute(c.first).first));
+  }
+}
+
+static void testExplain() {
+  OctCore oc;
+  oc.execute("x = 2");
+  // The costly sum of the loop is listed before the cheap sqrt, with the arguments and results of the nodes
+  Result r = oc.evaluate("explain(sqrt(x) + iterate(200, z = log(z + x)) * (x > 1 ? y = 3 : 4))");
+  const string &p = r.profile;
+  const size_t add = p.find("  + ("), mul = p.find("    * ("), loop = p.find("iterate (200, "), sq = p.find("sqrt (2) = 1.4142135623730950488");
+  if (!r.ok() || r.label != "RVAL" || p.substr(0, 10) != "explain : " || add == string::npos || mul == string::npos ||
+      loop == string::npos || sq == string::npos || !(add < mul && mul < loop && loop < sq) ||
+      p.find("?: (1, 3, -) = 3") == string::npos || p.find("y = (3) = 3") == string::npos || p.find("most time in :") == string::npos)
+    throw(runtime_error("explain : profile :\n" + p));
+  oc.execute("z = 0");
+  if (tlfloat_fabso(r.value - oc.execute("sqrt(x) + iterate(200, z = log(z + x)) * 3").second) != 0 || oc.execute("y").second != 3)
+    throw(runtime_error("explain : value"));
+  cout << p << endl;
+
+  // Branches that are not run, and operands skipped by && are shown as such
+  r = oc.evaluate("explain(x < 1 ? 5 : 0 && x)");
+  if (!r.ok() || r.value != 0 || r.profile.find("5  (not evaluated)") == string::npos || r.profile.find("x  (not evaluated)") == string::npos)
+    throw(runtime_error("explain : not evaluated :\n" + r.profile));
+
+  // The bodies of diff() and solve() are timed as part of them
+  r = oc.evaluate("explain(diff(t * t, t, x) + solve(cos(t) - t, t, 1))");
+  if (!r.ok() || r.profile.find("diff (2) = 4") == string::npos || r.profile.find("solve (1) = 0.73908513321516") == string::npos)
+    throw(runtime_error("explain : diff :\n" + r.profile));
+
+  // explain is a variable unless called, and is not nested
+  if (oc.execute("explain = 7").first != "LVAL:explain" || oc.evaluate("explain + 1").value != 8 || !oc.evaluate("explain + 1").profile.empty())
+    throw(runtime_error("explain : variable"));
+  for(auto &c : vector<pair<const char *, const char *>> {
+      { "explain([1, 2])", "ERROR:Arrays cannot be used in explain" },
+      { "explain(1 + 2", "ERROR:')' expected at column 13" },
+      { "1 + explain(2)", "ERROR:Syntax error at column 11" },
+    }) {
+    if (oc.execute(c.first).first != c.second) throw(runtime_error(string("explain : ") + c.first + " : " + oc.execute(c.first).first));
+  }
+}
+
+static void testErrors() {
+  OctCore oc;
+  struct { const char *expr; Error::Code code; int column; const char *message; } cases[] = {
+    { "1 +", Error::UNEXPECTED_END, 3, "Unexpected end of line at column 3" },
+    { "2 * $", Error::UNEXPECTED_CHAR, 4, "Unexpected character '$' at column 4" },
+    { "sqrt 2", Error::EXPECTED, 5, "'(' expected at column 5" },
+    { "pow(2)", Error::ARG_COUNT, 0, "2 argument(s) expected for pow at column 0" },
+    { "1 = 2", Error::NOT_LVALUE, 2, "Expected l-value before assignment operator at column 2" },
+    { "1 2", Error::SYNTAX, 2, "Syntax error at column 2" },
+    { "diff(x = 1, x, 0)", Error::DIFF_ASSIGN, 7, "Assignment cannot be differentiated at column 7" },
+    { "solve(x * x + 1, x, 1)", Error::NO_CONVERGENCE, 0, "solve did not converge" },
+    { "[1, 2] + [1, 2, 3]", Error::LENGTH_MISMATCH, 7, "Array lengths 2 and 3 do not match at column 7" },
+  };
+  for(auto &c : cases) {
+    Result r = oc.evaluate(c.expr);
+    if (r.ok() || r.error.code != c.code || r.error.column != c.column || r.error.message() != c.message)
+      throw(runtime_error(string("errors : ") + c.expr + " : " + r.error.message()));
+  }
+
+  // A failed evaluation does not assign
+  oc.execute("y = 5");
+  oc.execute("y = solve(x * x + 1, x, 1)");
+  if (oc.execute("y").second != 5) throw(runtime_error("errors : assignment after a failure"));
+}
+
+static void testReactive() {
+  OctCore oc, ref;
+  oc.setReactive(true);
+  auto check = [&](const char *e, const char *ex) {
+    if (oc.execute(e).second != ref.execute(ex).second) throw(runtime_error(string("reactive : ") + e + " differs from " + ex));
+  };
+  for(auto e : { "a = 3", "b = a * 2", "c = sqrt(b) + a", "d = diff(t * t * a, t, 2)", "e = 7", "f = e + c" }) oc.execute(e);
+  if (oc.recomputed() != 0) throw(runtime_error("reactive : nothing should have been recomputed"));
+
+  oc.execute("a = 5");
+  if (oc.recomputed() != 4) throw(runtime_error("reactive : b, c, d and f should have been recomputed"));
+  check("c", "sqrt(10) + 5");
+  check("d", "20");
+  check("f", "7 + sqrt(10) + 5");
+
+  oc.execute("e += 1");
+  if (oc.recomputed() != 1) throw(runtime_error("reactive : only f should have been recomputed"));
+  check("f", "8 + sqrt(10) + 5");
+
+  auto r = oc.execute("a = c - 1");
+  if (r.first != "ERROR:Circular dependency a -> c -> a")
+    throw(runtime_error("reactive : cycle not reported : " + r.first));
+  check("a", "5");
+
+  // An assignment reading its own variable is a plain one, as in an accumulator
+  oc.execute("x = 1");
+  oc.execute("y = x * 2");
+  if (oc.execute("x = x + 1").first != "LVAL:x" || oc.recomputed() != 1) throw(runtime_error("reactive : accumulator"));
+  check("y", "4");
+  oc.execute("y = y + x");
+  oc.execute("x = 10");
+  if (oc.recomputed() != 0) throw(runtime_error("reactive : y should have become a plain value"));
+  check("y", "6");
+
+  // A definition that cannot be recomputed is NaN, and the assignment reports it
+  oc.execute("n = 2");
+  oc.execute("m = iterate(n, 5)");
+  r = oc.execute("n = -1");
+  if (r.first != "ERROR:Cannot recompute m : Invalid number of iterations for iterate at column 4" || oc.execute("m").second == oc.execute("m").second)
+    throw(runtime_error("reactive : failed recomputation : " + r.first));
+  if (oc.execute("n = 3").first != "LVAL:n") throw(runtime_error("reactive : recovery"));
+  check("m", "5");
+
+  // Large levels are recomputed in parallel
+  oc.setThreads(4);
+  oc.execute("g = 1");
+  for(int i=0;i<100;i++) oc.execute("g" + to_string(i) + " = g * " + to_string(i) + " + sqrt(g)");
+  oc.execute("g = 4");
+  if (oc.recomputed() != 100) throw(runtime_error("reactive : parallel level"));
+  check("g37", "4 * 37 + 2");
+
+  // Assigning an expression with side effects makes b a plain value
+  oc.execute("b = rnd(1) + 4");
+  oc.execute("a = 9");
+  check("b", "4");
+  check("c", "2 + 9");
+
+  oc.setVar("a", 16);
+  check("c", "2 + 16");
+}
+
+static void testHistory() {
+  const string path = "octcore_test_history.log";
+  vector<string> ref;
+  {
+    FILE *fp = fopen(path.c_str(), "wb");
+    if (!fp) throw(runtime_error("history : cannot create the log"));
+    Xoshiro256 rng(7);
+    for(int i=0;i<100000;i++) {
+      ref.push_back(to_string(i) + "*x + " + (i % 3 == 0 ? "sqrt(" : "sin(") + to_string(rng.next64() % 1000) + ")");
+      fprintf(fp, "%s\n", ref.back().c_str());
+    }
+    fputs("1 + ", fp);	// A write cut short
+    ref.push_back("1 + ");
+    fclose(fp);
+  }
+
+  {
+    History h;
+    if (!h.open(path)) throw(runtime_error("history : open"));
+    h.add("pi = M_PI");
+    ref.push_back("pi = M_PI");
+    if (h.size() != ref.size()) throw(runtime_error("history : size"));
+    for(size_t i=0;i<ref.size();i+=97) if (h.at(i) != ref[i]) throw(runtime_error("history : entry " + to_string(i)));
+
+    auto t0 = chrono::steady_clock::now();
+    h.search("");
+    const double indexUs = chrono::duration<double, micro>(chrono::steady_clock::now() - t0).count();
+
+    // Each search must agree with a scan, including those refining the
+    // previous one and those after entries are added
+    const char *queries[] = { "sqrt(99", "7*x", "x", "s", "(12)", "", "9*x + sin(1", "1", "12", "123", "1234", "12345*x", "pi", "none" };
+    double us = 0;
+    int n = 0;
+    for(bool prefix : { false, true }) {
+      for(auto q : queries) {
+	if (strcmp(q, "1234") == 0) {
+	  h.add("1234 + 1");
+	  ref.push_back("1234 + 1");
+	}
+	t0 = chrono::steady_clock::now();
+	auto &r = h.search(q, prefix);
+	us += chrono::duration<double, micro>(chrono::steady_clock::now() - t0).count();
+	n++;
+	vector<uint32_t> expected;
+	for(size_t i=0;i<ref.size();i++) {
+	  if (prefix ? ref[i].compare(0, strlen(q), q) == 0 : ref[i].find(q) != string::npos) expected.push_back(uint32_t(i));
+	}
+	if (r != expected) throw(runtime_error(string("history : search ") + (prefix ? "prefix " : "") + q));
+      }
+    }
+    cout << "history : " << indexUs << " us to index " << ref.size() << " entries, " << us / n << " us per search" << endl;
+  }
+
+  {
+    // The entries added are appended to the log
+    History h;
+    h.open(path);
+    if (h.size() != ref.size()) throw(runtime_error("history : reopen"));
+    for(size_t i=ref.size()-5;i<ref.size();i++) if (h.at(i) != ref[i]) throw(runtime_error("history : reopen"));
+    h.clear();
+    if (h.size() != 0 || h.search("1").size() != 0) throw(runtime_error("history : clear"));
+    h.add("2 + 2");
+  }
+  {
+    History h;
+    h.open(path);
+    if (h.size() != 1 || h.at(0) != "2 + 2") throw(runtime_error("history : truncated log"));
+  }
+  remove(path.c_str());
+}
+
+static void testPlot() {
+  OctCore oc;
+  oc.execute("a = 2");
+  oc.execute("x = 5");
+  Compiled f;
+  if (oc.compile("a * x * x + diff(t * t, t, x)", "x", f) || oc.evaluateAt(f, 3) != 24 || oc.evaluateAt(f, -1) != 0) {
+    throw(runtime_error("plot : compiled expression"));
+  }
+  tlfloat_octuple x;
+  if (!oc.getVar("x", x) || x != 5) throw(runtime_error("plot : the parameter changed the variable"));
+  if (oc.compile("y", "u", f) || oc.getVar("u", x)) throw(runtime_error("plot : the parameter was defined"));
+  if (oc.compile("solve(t * t + 1, t, x)", "x", f) || oc.evaluateAt(f, 1) == oc.evaluateAt(f, 1)) {
+    throw(runtime_error("plot : failed evaluation"));
+  }
+  if (oc.compile("sum([x, 1])", "x", f).code != Error::ARRAY_IN_COMPILED || oc.compile("x +", "x", f).code != Error::UNEXPECTED_END ||
+      oc.compile("x", "sqrt", f).code != Error::VAR_EXPECTED) throw(runtime_error("plot : compile errors"));
+
+  Sampler bad("sin(", "x", oc.variables());
+  vector<Sampler::Point> pts;
+  if (!bad.error() || !bad.samples(-1, 1, pts) || !pts.empty()) throw(runtime_error("plot : sampler error"));
+
+  Sampler s("sin(a * x) + sqrt(x + 3)", "x", oc.variables());
+  if (s.error()) throw(runtime_error("plot : " + s.error().message()));
+  auto wait = [&](double x0, double x1) {
+    const auto t0 = chrono::steady_clock::now();
+    double first = -1;
+    for(;;) {
+      const bool done = s.samples(x0, x1, pts);
+      const double us = chrono::duration<double, micro>(chrono::steady_clock::now() - t0).count();
+      if (first < 0 && !pts.empty()) first = us;
+      if (done) return first;
+      if (us > 60e6) throw(runtime_error("plot : timeout"));
+      this_thread::sleep_for(chrono::microseconds(100));
+    }
+  };
+
+  s.setView(Sampler::View { -4, 4, -1.5, 3.5, 400, 300 });
+  const double first = wait(-4, 4);
+  if (pts.size() < 100) throw(runtime_error("plot : too few samples"));
+  size_t nan = 0;
+  for(size_t i=0;i<pts.size();i++) {
+    if (i != 0 && pts[i].x <= pts[i-1].x) throw(runtime_error("plot : samples out of order"));
+    const double y = sin(2 * pts[i].x) + sqrt(pts[i].x + 3);
+    if (pts[i].x < -3) { nan += pts[i].y != pts[i].y; continue; }
+    if (fabs(pts[i].y - y) > 1e-12) throw(runtime_error("plot : wrong sample at " + to_string(pts[i].x)));
+  }
+  if (nan == 0) throw(runtime_error("plot : samples outside the domain"));
+  // The edge of the domain is found to a pixel
+  for(size_t i=1;i<pts.size();i++) {
+    if (pts[i-1].x < -3 && pts[i].x >= -3 && pts[i].x - pts[i-1].x > 8.0 / 400) throw(runtime_error("plot : edge of the domain"));
+  }
+
+  // Panning reuses the samples in the part of the view that stays visible
+  const size_t n0 = s.evaluations();
+  s.setView(Sampler::View { -2, 6, -1.5, 3.5, 400, 300 });
+  wait(-2, 6);
+  const size_t n1 = s.evaluations() - n0;
+  if (n1 == 0 || n1 * 2 > n0) throw(runtime_error("plot : samples not reused"));
+
+  // A view narrower than the spacing of doubles at its ends is sampled to the end
+  s.setView(Sampler::View { 1e20, 1e20 + 1e6, -1.5, 3.5, 400, 300 });
+  wait(1e20, 1e20 + 1e6);
+  if (pts.empty()) throw(runtime_error("plot : view far from 0"));
+  cout << "plot : first samples after " << first << " us, " << n0 << " points, " << n1 << " more after panning" << endl;
+}
+
+static string tabulated(Tabulator &t, Tabulator::Format format, tlfloat_octuple x0, tlfloat_octuple x1, size_t n) {
+  FILE *fp = tmpfile();
+  if (!fp) throw(runtime_error("tabulate : tmpfile"));
+  if (!t.writeRange(fp, format, x0, x1, n)) { fclose(fp); throw(runtime_error("tabulate : write")); }
+  string s(size_t(ftell(fp)), '\0');
+  rewind(fp);
+  const size_t r = fread(&s[0], 1, s.size(), fp);
+  fclose(fp);
+  if (r != s.size()) throw(runtime_error("tabulate : read"));
+  return s;
+}
+
+static void testTabulate() {
+  OctCore oc;
+  oc.execute("a = 3");
+  Tabulator bad("x +", "x", oc.variables());
+  if (bad.error().code != Error::UNEXPECTED_END || bad.writeRange(stdout, Tabulator::CSV, 0, 1, 10)) {
+    throw(runtime_error("tabulate : compile error"));
+  }
+
+  // The rows do not depend on the number of threads
+  Tabulator t("a * x + sqrt(x)", "x", oc.variables());
+  if (t.error()) throw(runtime_error("tabulate : " + t.error().message()));
+  t.setThreads(1);
+  const string csv1 = tabulated(t, Tabulator::CSV, -1, 9, 10001);
+  t.setThreads(3);
+  if (tabulated(t, Tabulator::CSV, -1, 9, 10001) != csv1) throw(runtime_error("tabulate : rows depend on the threads"));
+  const string head = "\"x\",\"a * x + sqrt(x)\"\n-1,";
+  if (csv1.compare(0, head.size(), head) != 0 || count(csv1.begin(), csv1.end(), '\n') != 10002 ||
+      csv1.find("\n9,30\n") != csv1.size() - 6) throw(runtime_error("tabulate : CSV"));
+
+  const string path = "octcore_test_table.bin";
+  {
+    FILE *fp = fopen(path.c_str(), "wb");
+    if (!fp) throw(runtime_error("tabulate : cannot create the table"));
+    const bool ok = t.writeRange(fp, Tabulator::BINARY, 0, 1, 10000);
+    if (fclose(fp) != 0 || !ok) throw(runtime_error("tabulate : write"));
+  }
+  {
+    MappedFile file(path);
+    uint64_t rows;
+    uint32_t columns;
+    const tlfloat_octuple *v = tableValues(file.view(), rows, columns);
+    if (!v || rows != 10000 || columns != 2 || file.view().size() != 64 + rows * columns * 32) throw(runtime_error("tabulate : binary table"));
+    for(size_t i=0;i<rows;i+=999) {
+      const tlfloat_octuple x = tlfloat_octuple(1) / 9999 * int(i);
+      if (v[i*2] != x || v[i*2+1] != 3 * x + tlfloat_sqrto(x)) throw(runtime_error("tabulate : row " + to_string(i)));
+    }
+    if (v[rows*2-2] != 1 || v[rows*2-1] != 4) throw(runtime_error("tabulate : last row"));
+    if (tableValues(file.view().substr(0, 64 + 32 * 3), rows, columns)) throw(runtime_error("tabulate : truncated table"));
+  }
+  remove(path.c_str());
+}
+
+static void testStats() {
+  for(const char *str : { "0", "-0", "123.456", "+6.02214076e23", "-1.5E-7", "0.000123", "1234567890123456789", "12345678901234567890123",
+			  "1e400", "0x1.8p3", "inf", "-2.5e+10", "7." }) {
+    tlfloat_octuple x;
+    if (!parseNumber(str, x) || x != tlfloat_strtoo(str, nullptr)) throw(runtime_error(string("stats : parse ") + str));
+  }
+  for(const char *str : { "", "nan", "1e", "abc", "1.2.3", "--1", "." }) {
+    tlfloat_octuple x;
+    if (parseNumber(str, x)) throw(runtime_error(string("stats : accepted ") + str));
+  }
+
+  const string path = "octcore_test_stats.csv";
+  const int n = 100000;
+  {
+    FILE *fp = fopen(path.c_str(), "wb");
+    if (!fp) throw(runtime_error("stats : cannot create the file"));
+    fputs("\"i\";\"value\"\n# comment\n\n", fp);
+    for(int i=0;i<n;i++) {
+      if (i % 1000 == 999) fprintf(fp, "%d; NA\r\n", i);
+      else fprintf(fp, "%d; %d.%d\r\n", i, i % 777 - 300, i % 2 * 5);
+    }
+    fclose(fp);
+  }
+  vector<tlfloat_octuple> v;
+  for(int i=0;i<n;i++) {
+    const int a = i % 777 - 300;
+    if (i % 1000 != 999) v.push_back(tlfloat_octuple(a) + (i % 2 == 0 ? 0 : a < 0 ? -0.5 : 0.5));
+  }
+  tlfloat_octuple sum = 0, m2 = 0, m4 = 0;
+  for(auto x : v) sum += x;
+  const tlfloat_octuple mean = sum / int(v.size());
+  for(auto x : v) { m2 += (x - mean) * (x - mean); m4 += (x - mean) * (x - mean) * (x - mean) * (x - mean); }
+
+  MappedFile file(path);
+  const ColumnStats s1 = columnStats(file, 1, 1, 4096), s3 = columnStats(file, 1, 3, 4096), s = columnStats(file, 1);
+  remove(path.c_str());
+  if (s.n != v.size() || s.skipped != n - v.size() + 1 || s.sum != sum || s.min != -300.5 || s.max != 476.5) {
+    throw(runtime_error("stats : summary"));
+  }
+  if (!(tlfloat_fabso(s.mean / mean - 1) < 1e-30 && tlfloat_fabso(s.m2 / m2 - 1) < 1e-30 && tlfloat_fabso(s.m4 / m4 - 1) < 1e-30 &&
+	tlfloat_fabso(s1.m2 / m2 - 1) < 1e-30 && tlfloat_fabso(s1.m4 / m4 - 1) < 1e-30)) throw(runtime_error("stats : moments"));
+  if (s1.n != s3.n || s1.sum != s3.sum || s1.mean != s3.mean || s1.m2 != s3.m2 || s1.m3 != s3.m3 || s1.m4 != s3.m4) {
+    throw(runtime_error("stats : results depend on the threads"));
+  }
+  if (columnStats(file, 2).n != 0) throw(runtime_error("stats : missing column"));
+}
+
+static void testServer() {
+#if !defined(_WIN32)
+  const string path = "/tmp/octcore_test_" + to_string(getpid()) + ".sock";
+  Server server(path, 2);
+  thread th([&]() { server.run(); });
+  struct Stop { Server &s; thread &t; ~Stop() { s.stop(); t.join(); } } stop_ { server, th };
+  {
+    Connection a(path), b(path);
+    // Pipelined requests are answered in order, and variables are per connection
+    a.send("{\"id\": 1, \"expr\": \"x = 6\"}\n{\"id\": \"two\", \"expr\": \"x * 7\"}\n{\"expr\": \"1 +\", \"id\": 3}\n");
+    b.send("{\"id\": 1, \"expr\": \"x\"}\nnot json\n");
+    string l[5];
+    for(int i=0;i<3;i++) if (!a.readLine(l[i])) throw(runtime_error("server : connection closed"));
+    for(int i=3;i<5;i++) if (!b.readLine(l[i])) throw(runtime_error("server : connection closed"));
+    if (l[0] != "{\"id\":1,\"result\":\"LVAL\",\"var\":\"x\",\"value\":\"6\"}") throw(runtime_error("server : " + l[0]));
+    if (l[1] != "{\"id\":\"two\",\"result\":\"RVAL\",\"value\":\"42\"}") throw(runtime_error("server : " + l[1]));
+    if (l[2].substr(0, 17) != "{\"id\":3,\"error\":\"") throw(runtime_error("server : " + l[2]));
+    if (l[3] != "{\"id\":1,\"result\":\"LVAL\",\"var\":\"x\",\"value\":\"0\"}") throw(runtime_error("server : " + l[3]));
+    if (l[4] != "{\"id\":null,\"error\":\"Malformed request\"}") throw(runtime_error("server : " + l[4]));
+
+    // Only JSON values are taken as ids
+    a.send("{\"id\": abc, \"expr\": \"1\"}\n{\"id\": -1.5e3, \"expr\": \"1\"}\n{\"id\": 01, \"expr\": \"1\"}\n{\"id\": true, \"expr\": \"1\"}\n");
+    const char *ids[] = { "{\"id\":null,\"error\"", "{\"id\":-1.5e3,", "{\"id\":null,\"error\"", "{\"id\":true," };
+    for(auto id : ids) {
+      if (!a.readLine(l[0]) || l[0].substr(0, strlen(id)) != id) throw(runtime_error("server : id : " + l[0]));
+    }
+  }
+  {
+    // Clients that send many requests without reading the responses hold no worker
+    const int n = 5000;
+    string burst;
+    for(int i=0;i<n;i++) burst += "{\"id\": " + to_string(i) + ", \"expr\": \"1 / 3\"}\n";
+    Connection slow0(path), slow1(path), c(path);
+    slow0.send(burst);
+    slow1.send(burst);
+    this_thread::sleep_for(chrono::milliseconds(200));
+    string l;
+    c.send("{\"id\": 1, \"expr\": \"6 * 7\"}\n");
+    if (!c.readLine(l) || l != "{\"id\":1,\"result\":\"RVAL\",\"value\":\"42\"}") throw(runtime_error("server : blocked by slow clients : " + l));
+    for(int i=0;i<n;i++) {
+      const string prefix = "{\"id\":" + to_string(i) + ",";
+      if (!slow0.readLine(l) || l.substr(0, prefix.size()) != prefix) throw(runtime_error("server : slow client : " + l));
+    }
+  }
+#endif
+}
+
+int main(int argc, char **argv) {
+  try {
+    testNoAllocation();
+    testLongExpression();
+    testRandom();
+    testModular();
+    testFactor();
+    testBits();
+    testExact();
+    testArray();
+    testMatrix();
+    testCache();
+    testConditional();
+    testDerivatives();
+    testLoop();
+    testMonteCarlo();
+    testExplain();
+    testErrors();
+    testReactive();
+    testHistory();
+    testPlot();
+    testTabulate();
+    testStats();
+    testServer();
+  } catch(exception &ex) {
+    cout << ex.what() << endl;
+    cout << "Test failed" << endl;
+    return -1;
+  }
+
+  cout << "Test passed" << endl;
+  return 0;
+}
@@ -1,6 +1,8 @@
 #include <cstdio>
+#include <cstring>
 #include <cmath>
 #include <memory>
+#include <algorithm>
 #include <unordered_map>
 #include <string>
 #include <QtWidgets>
@@ -14,6 +16,8 @@
 #include <QPaintDevice>
 
 #include "octcore.hpp"
+#include "history.hpp"
+#include "plot.hpp"
 #include "octcalc64x64.hpp"
 
 using namespace std;
@@ -40,6 +44,264 @@ public:
   }
 };
 
+// Rows of the history, or of the entries matching the search. The view has
+// uniform row heights, so that only the rows in view are asked for.
+class HistoryModel : public QAbstractListModel {
+  octcore::History &history;
+  const vector<uint32_t> *matches = nullptr;	// All the entries if null
+  string query;
+  bool prefix = false;
+
+  void refresh() { matches = query.empty() ? nullptr : &history.search(query, prefix); }
+
+public:
+  explicit HistoryModel(octcore::History &h) : history(h) {}
+
+  int rowCount(const QModelIndex &parent = QModelIndex()) const override {
+    if (parent.isValid()) return 0;
+    return int(matches ? matches->size() : history.size());
+  }
+
+  QVariant data(const QModelIndex &index, int role) const override {
+    if (role != Qt::DisplayRole || !index.isValid()) return QVariant();
+    string_view s = entry(index.row());
+    return QString::fromUtf8(s.data(), int(s.size()));
+  }
+
+  string_view entry(int row) const { return history.at(matches ? (*matches)[row] : row); }
+
+  void setFilter(const string &q, bool p) {
+    beginResetModel();
+    query = q;
+    prefix = p;
+    refresh();
+    endResetModel();
+  }
+
+  void add(const string &s) {
+    if (s.empty()) return;
+    if (matches) {
+      beginResetModel();
+      history.add(s);
+      refresh();
+      endResetModel();
+    } else {
+      const int n = int(history.size());
+      beginInsertRows(QModelIndex(), n, n);
+      history.add(s);
+      endInsertRows();
+    }
+  }
+
+  void clear() {
+    beginResetModel();
+    history.clear();
+    refresh();
+    endResetModel();
+  }
+};
+
+// Plot of a function of x. The samples are computed on worker threads by an
+// octcore::Sampler, and the view is repainted with the samples computed so
+// far until the sampler has refined it. Dragging pans and the wheel zooms.
+class PlotView : public QWidget {
+  unique_ptr<octcore::Sampler> sampler;
+  octcore::Sampler::View view { -1, 1, 0, 0, 1, 1 };
+  bool fitY = false;		// The y range is set from the first samples
+  bool done = false;
+  vector<octcore::Sampler::Point> points;
+  QTimer timer;
+  QPointF dragFrom;
+  octcore::Sampler::View dragView {};
+
+  void setView(const octcore::Sampler::View &v) {
+    view = v;
+    view.width = max(1, width());
+    view.height = max(1, height());
+    if (!sampler) return;
+    sampler->setView(view);
+    done = false;
+    timer.start();
+  }
+
+  // Sets the y range to hold most of the finite samples, leaving out the
+  // poles. Returns false until there are enough samples.
+  bool fitRange() {
+    vector<double> ys;
+    for(auto &p : points) if (isfinite(p.y)) ys.push_back(p.y);
+    if (ys.size() < 48 && !done) return false;
+    double lo = -1, hi = 1;
+    if (!ys.empty()) {
+      sort(ys.begin(), ys.end());
+      lo = ys[ys.size() / 50];
+      hi = ys[ys.size() - 1 - ys.size() / 50];
+      if (!(hi - lo > 1e-300 * max(fabs(lo), 1.0))) { lo -= 1; hi += 1; }
+    }
+    octcore::Sampler::View v = view;
+    v.y0 = lo - (hi - lo) * 0.05;
+    v.y1 = hi + (hi - lo) * 0.05;
+    setView(v);
+    return true;
+  }
+
+  void poll() {
+    if (!sampler) { timer.stop(); return; }
+    // The curve is drawn up to the edges from the samples just outside them
+    const double margin = (view.x1 - view.x0) / 32;
+    done = sampler->samples(view.x0 - margin, view.x1 + margin, points);
+    if (fitY && fitRange()) fitY = false;
+    else if (done) timer.stop();
+    update();
+  }
+
+public:
+  PlotView() {
+    setMinimumSize(480, 320);
+    timer.setInterval(16);
+    connect(&timer, &QTimer::timeout, this, [this]{ poll(); });
+  }
+
+  // Returns the error message, or an empty string
+  string plot(const string &expr, const vector<pair<string, tlfloat_octuple>> &vars, double x0, double x1) {
+    timer.stop();
+    points.clear();
+    sampler = make_unique<octcore::Sampler>(expr, "x", vars);
+    if (sampler->error()) {
+      string msg = sampler->error().message();
+      sampler.reset();
+      update();
+      return msg;
+    }
+    fitY = true;
+    setView(octcore::Sampler::View { x0, x1, 0, 0, 1, 1 });
+    return "";
+  }
+
+  bool finished() const { return !sampler || (done && !fitY); }
+  size_t sampleCount() const { return points.size(); }
+
+protected:
+  void paintEvent(QPaintEvent *) override {
+    QPainter p(this);
+    p.fillRect(rect(), Qt::white);
+    if (!(view.x1 > view.x0) || !(view.y1 > view.y0)) return;
+    const double w = width(), h = height();
+    auto px = [&](double x) { return (x - view.x0) / (view.x1 - view.x0) * w; };
+    auto py = [&](double y) { return h - (y - view.y0) / (view.y1 - view.y0) * h; };
+
+    p.setPen(QColor(180, 180, 180));
+    if (view.x0 < 0 && 0 < view.x1) p.drawLine(QPointF(px(0), 0), QPointF(px(0), h));
+    if (view.y0 < 0 && 0 < view.y1) p.drawLine(QPointF(0, py(0)), QPointF(w, py(0)));
+    p.setPen(QColor(100, 100, 100));
+    auto num = [](double d) { return QString::number(d, 'g', 6); };
+    p.drawText(rect().adjusted(4, 2, -4, -2), Qt::AlignLeft | Qt::AlignBottom, num(view.x0));
+    p.drawText(rect().adjusted(4, 2, -4, -2), Qt::AlignRight | Qt::AlignBottom, num(view.x1));
+    p.drawText(rect().adjusted(4, 2, -4, -2), Qt::AlignLeft | Qt::AlignTop, num(view.y1));
+    p.drawText(rect().adjusted(4, 16, -4, -16), Qt::AlignLeft | Qt::AlignBottom, num(view.y0));
+
+    // Lines break where the function is undefined, and at jumps taller than
+    // the view, which are poles or discontinuities
+    QPainterPath path;
+    bool penDown = false;
+    double lastY = 0;
+    for(auto &pt : points) {
+      if (!isfinite(pt.y)) { penDown = false; continue; }
+      const double y = min(max(py(pt.y), -4 * h), 5 * h);
+      if (penDown && fabs(y - lastY) > h) penDown = false;
+      if (penDown) path.lineTo(px(pt.x), y); else path.moveTo(px(pt.x), y);
+      penDown = true;
+      lastY = y;
+    }
+    p.setRenderHint(QPainter::Antialiasing);
+    p.setPen(QPen(QColor(40, 80, 200), 1.5));
+    p.drawPath(path);
+  }
+
+  void resizeEvent(QResizeEvent *) override { setView(view); }
+
+  void mousePressEvent(QMouseEvent *event) override {
+    dragFrom = event->position();
+    dragView = view;
+  }
+
+  void mouseMoveEvent(QMouseEvent *event) override {
+    if (!(event->buttons() & Qt::LeftButton)) return;
+    const QPointF d = event->position() - dragFrom;
+    const double dx = d.x() / width() * (dragView.x1 - dragView.x0), dy = d.y() / height() * (dragView.y1 - dragView.y0);
+    octcore::Sampler::View v = dragView;
+    v.x0 -= dx; v.x1 -= dx;
+    v.y0 += dy; v.y1 += dy;
+    setView(v);
+  }
+
+  // Zooms around the cursor, in down to a span of a few ulps of x
+  void wheelEvent(QWheelEvent *event) override {
+    double f = pow(0.8, event->angleDelta().y() / 120.0);
+    const double cx = view.x0 + event->position().x() / width() * (view.x1 - view.x0);
+    const double minSpan = 16 * (nextafter(fabs(cx), INFINITY) - fabs(cx));
+    if (f < 1 && (view.x1 - view.x0) * f < minSpan) f = min(1.0, minSpan / (view.x1 - view.x0));
+    if (f == 1) return;
+    const double cy = view.y1 - event->position().y() / height() * (view.y1 - view.y0);
+    octcore::Sampler::View v = view;
+    v.x0 = cx - (cx - v.x0) * f; v.x1 = cx + (v.x1 - cx) * f;
+    v.y0 = cy - (cy - v.y0) * f; v.y1 = cy + (v.y1 - cy) * f;
+    setView(v);
+  }
+};
+
+// Window with the function to plot, its range, and the plot. The bounds
+// of the range are expressions evaluated with the variables of the calculator.
+class PlotWindow : public QWidget {
+public:
+  shared_ptr<QLineEdit> function, from, to;
+  shared_ptr<QLabel> status;
+  shared_ptr<PlotView> view;
+  vector<pair<string, tlfloat_octuple>> vars;
+
+  explicit PlotWindow(QWidget *parent) : QWidget(parent, Qt::Window) {
+    function = make_shared<QLineEdit>();
+    from = make_shared<QLineEdit>("-10");
+    to = make_shared<QLineEdit>("10");
+    from->setMaximumWidth(120);
+    to->setMaximumWidth(120);
+    status = make_shared<QLabel>();
+    view = make_shared<PlotView>();
+
+    auto row = new QHBoxLayout();
+    row->addWidget(new QLabel("f(x) ="));
+    row->addWidget(function.get(), 1);
+    row->addWidget(new QLabel("x from"));
+    row->addWidget(from.get());
+    row->addWidget(new QLabel("to"));
+    row->addWidget(to.get());
+    auto layout = new QVBoxLayout(this);
+    layout->addLayout(row);
+    layout->addWidget(view.get(), 1);
+    layout->addWidget(status.get());
+
+    for(auto e : { function, from, to }) connect(e.get(), &QLineEdit::returnPressed, this, [this]{ replot(); });
+    setWindowTitle(tr("OctCalc Plot"));
+  }
+
+  void plot(const string &expr, const vector<pair<string, tlfloat_octuple>> &v) {
+    function->setText(QString::fromStdString(expr));
+    vars = v;
+    replot();
+  }
+
+  void replot() {
+    octcore::OctCore core;
+    for(auto &v : vars) core.setVar(v.first, v.second);
+    octcore::Result r0 = core.evaluate(from->text().toStdString()), r1 = core.evaluate(to->text().toStdString());
+    const double x0 = (double)r0.value, x1 = (double)r1.value;
+    if (!r0.ok() || !r1.ok() || !(x0 < x1) || !isfinite(x1 - x0)) {
+      status->setText("Invalid range");
+      return;
+    }
+    status->setText(QString::fromStdString(view->plot(function->text().toStdString(), vars, x0, x1)));
+  }
+};
+
 class OctCalc : public QWidget {
 public:
   OctCalc(QWidget *parent, QApplication *app_);
@@ -49,6 +311,9 @@ private:
   const QApplication *app;
   bool eventFilter(QObject *obj, QEvent *event);
   void processButtonPress(const string &s);
+  void showExact(int base);
+  void recallHistory(int row);
+  void plot();
 
   const QPixmap octPixmap = QPixmap::fromImage(QImage::fromData(octcalc64x64, sizeof(octcalc64x64)));
   const QIcon octIcon = QIcon(octPixmap);
@@ -58,13 +323,20 @@ private:
   shared_ptr<QGridLayout> mainLayout;
   shared_ptr<QLineEdit> display;
   shared_ptr<QLabel> label;
-  shared_ptr<QFrame> vline0, vline1, vline2, hline0;
+  shared_ptr<QFrame> vline0, vline1, vline2, vline3, hline0;
+  shared_ptr<QWidget> historyPanel;
+  shared_ptr<QLineEdit> historySearch;
+  shared_ptr<QCheckBox> historyPrefix;
+  shared_ptr<QListView> historyView;
+  shared_ptr<QPushButton> plotButton;
+  shared_ptr<PlotWindow> plotWindow;
 
   const QColor bdef = QColor(220, 220, 220), red = QColor(220, 120, 120), green = QColor(170, 220, 170), blue = QColor(100, 140, 250);
 
   octcore::OctCore octCore;
 
-  vector<string> history;
+  octcore::History history;
+  shared_ptr<HistoryModel> historyModel;
   int histPos = -1;
 
   bool shuttingDown = false;
@@ -75,6 +347,8 @@ private:
 
   string displayString = "", subdisplayString = "";
   tlfloat_octuple displayNumber = 0;
+  BigInt displayExact;	// The exact value if the result is an integer beyond the range of tlfloat_int128_t
+  bool exactValid = false;
   bool showingResult = false;
 
   bool selectAll = false;
@@ -83,9 +357,21 @@ private:
 public:
   int doTest();
 #endif
+#ifdef BENCH
+public:
+  int doBench(int rounds);
+#endif
 };
 
 OctCalc::OctCalc(QWidget *parent, QApplication *app_) : QWidget(parent), app(app_) {
+#ifdef BENCH
+  // The benchmark replays the same scripts every round, and would time
+  // cache hits instead of evaluations
+  octCore.setCacheBudget(0);
+#else
+  octCore.setCacheBudget(1 << 22);
+#endif
+
   mainLayout = make_shared<QGridLayout>();
   mainLayout->setSizeConstraint(QLayout::SetFixedSize);
 
@@ -171,6 +457,50 @@ OctCalc::OctCalc(QWidget *parent, QApplication *app_) : QWidget(parent), app(app
     mainLayout->addWidget(b.get(), butdefs[i].y, butdefs[i].x, butdefs[i].h, butdefs[i].w);
   }
 
+  vline3 = make_shared<QFrame>();
+  vline3->setFrameShape(QFrame::VLine);
+  vline3->setStyleSheet("border: 0px solid black");
+  mainLayout->addWidget(vline3.get(), 0, 14, 0, 1);
+
+  // The history is only kept in memory while testing
+#if !defined(TEST) && !defined(BENCH)
+  const QString dataDir = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation);
+  QDir().mkpath(dataDir);
+  history.open((dataDir + "/history.log").toStdString());
+#endif
+  historyModel = make_shared<HistoryModel>(history);
+
+  historySearch = make_shared<QLineEdit>();
+  historySearch->setPlaceholderText("Search history");
+  historySearch->setClearButtonEnabled(true);
+  historyPrefix = make_shared<QCheckBox>("Prefix");
+  historyView = make_shared<QListView>();
+  historyView->setUniformItemSizes(true);
+  historyView->setEditTriggers(QAbstractItemView::NoEditTriggers);
+  historyView->setFont(font);
+  historyView->setModel(historyModel.get());
+  historyView->scrollToBottom();
+
+  auto refilter = [this]{ historyModel->setFilter(historySearch->text().toStdString(), historyPrefix->isChecked()); historyView->scrollToBottom(); };
+  connect(historySearch.get(), &QLineEdit::textChanged, this, refilter);
+  connect(historyPrefix.get(), &QCheckBox::toggled, this, refilter);
+  connect(historyView.get(), &QListView::doubleClicked, this, [this](const QModelIndex &index) { recallHistory(index.row()); });
+
+  historyPanel = make_shared<QWidget>();
+  auto searchRow = new QHBoxLayout();
+  searchRow->setContentsMargins(0, 0, 0, 0);
+  searchRow->addWidget(historySearch.get());
+  searchRow->addWidget(historyPrefix.get());
+  auto panelLayout = new QVBoxLayout(historyPanel.get());
+  panelLayout->setContentsMargins(0, 0, 0, 0);
+  panelLayout->addLayout(searchRow);
+  panelLayout->addWidget(historyView.get());
+  plotButton = make_shared<QPushButton>("Plot");
+  connect(plotButton.get(), &QPushButton::clicked, this, [this]{ plot(); });
+  panelLayout->addWidget(plotButton.get());
+  historyPanel->setFixedWidth(display->fontMetrics().horizontalAdvance(QString(28, '0')));
+  mainLayout->addWidget(historyPanel.get(), 0, 15, 8, 1);
+
   setLayout(mainLayout.get());
   setWindowTitle(tr("OctCalc"));
 }
@@ -183,6 +513,37 @@ shared_ptr<Button> OctCalc::createButton(const QString &text, const QColor& c) {
 
 //
 
+// Puts a row of the history panel on the display, as PageUp does
+void OctCalc::recallHistory(int row) {
+  if (row < 0 || row >= historyModel->rowCount()) return;
+  displayString = string(historyModel->entry(row));
+  histPos = -1;
+  selectAll = true;
+  processButtonPress("SHOW");
+  display->setFocus();
+}
+
+// Plots the expression on the display, or the one just evaluated. The
+// profile of explain() that follows it on the subdisplay is left out.
+void OctCalc::plot() {
+  if (!plotWindow) plotWindow = make_shared<PlotWindow>(this);
+  plotWindow->show();
+  plotWindow->raise();
+  plotWindow->plot(showingResult ? subdisplayString.substr(0, subdisplayString.find('\n')) : displayString, octCore.variables());
+}
+
+// Shows the result in INT mode when it is beyond the range of tlfloat_int128_t
+void OctCalc::showExact(int base) {
+  string str = "OVERFLOW";
+  if (exactValid) {
+    str = displayExact.toString(base);
+  } else if (displayNumber - displayNumber == 0) {
+    str = octcore::toBigInt(tlfloat_trunco(displayNumber)).toString(base);
+  }
+  if (displayBuffer.size() < str.size() + 1) displayBuffer.resize(str.size() + 1);
+  memcpy(displayBuffer.data(), str.c_str(), str.size() + 1);
+}
+
 void OctCalc::processButtonPress(const string &s) {
 #ifdef DEBUG
   qDebug() << "processButtonPress : " << s.c_str();
@@ -194,31 +555,38 @@ void OctCalc::processButtonPress(const string &s) {
   //
 
   if (s == "Enter" || s == "Return" || s == "ENTER" || s == "HEX" || s == "INT") {
-    bool error = false;
+    bool error = false, text = false;
 
     if (s == "HEX") modeHex = !modeHex;
     if (s == "INT") modeInt = !modeInt;
 
     if (!(s == "HEX" || s == "INT") || !showingResult) {
       subdisplayString = displayString;
-      history.push_back(displayString);
+      historyModel->add(displayString);
+      historyView->scrollToBottom();
       histPos = -1;
-      pair<string, tlfloat_octuple> p = octCore.execute(displayString);
-      if (p.first.substr(0, 6) == "ERROR:") {
-	displayString = p.first.substr(6);
+      octcore::Result r = octCore.evaluate(displayString);
+      exactValid = r.ok() && r.label.substr(0, 4) == "INT:" && BigInt::parse(r.label.substr(4), displayExact);
+      if (!r.ok()) {
+	displayString = r.error.message();
 	displayNumber = 0;
 	error = true;
+      } else if (r.label.substr(0, 5) == "TEXT:") {
+	displayString = r.label.substr(5);
+	displayNumber = r.value;
+	text = true;
       } else {
-	displayNumber = p.second;
+	displayNumber = r.value;
       }
+      if (r.ok() && !r.profile.empty()) subdisplayString += "\n" + r.profile;
       showingResult = true;
     }
 
-    if (!error) {
+    if (!error && !text) {
       if (modeHex) {
 	if (modeInt) {
 	  if (displayNumber <= -tlfloat_ldexpo(1, 127) || tlfloat_ldexpo(1, 127) <= displayNumber) {
-	    tlfloat_snprintf(displayBuffer.data(), displayBuffer.size()-1, "OVERFLOW");
+	    showExact(16);
 	  } else {
 	    tlfloat_snprintf(displayBuffer.data(), displayBuffer.size()-1, "0x%Qx", (tlfloat_int128_t)displayNumber);
 	  }
@@ -232,7 +600,7 @@ void OctCalc::processButtonPress(const string &s) {
       } else {
 	if (modeInt) {
 	  if (displayNumber <= -tlfloat_ldexpo(1, 127) || tlfloat_ldexpo(1, 127) <= displayNumber) {
-	    tlfloat_snprintf(displayBuffer.data(), displayBuffer.size()-1, "OVERFLOW");
+	    showExact(10);
 	  } else {
 	    tlfloat_snprintf(displayBuffer.data(), displayBuffer.size()-1, "%Qd", (tlfloat_int128_t)displayNumber);
 	  }
@@ -260,7 +628,7 @@ void OctCalc::processButtonPress(const string &s) {
     selectionStart = -1;
     showingResult = false;
     octCore.clear();
-    history.clear();
+    historyModel->clear();
     histPos = -1;
   } else if (s == "SHIFT") {
     modeShift = !modeShift;
@@ -272,12 +640,12 @@ void OctCalc::processButtonPress(const string &s) {
     } else if (histPos > 0) {
       histPos--;
     }
-    if (histPos >= 0 && histPos < history.size()) displayString = history[histPos];
+    if (histPos >= 0 && histPos < history.size()) displayString = history.at(histPos);
     showingResult = false;
     selectAll = true;
   } else if (s == "PageDown" || s == "DOWN") {
     if (histPos != -1 && histPos < history.size() - 1) histPos++;
-    if (histPos >= 0 && histPos < history.size()) displayString = history[histPos];
+    if (histPos >= 0 && histPos < history.size()) displayString = history.at(histPos);
     showingResult = false;
     selectAll = true;
   } else if (s == "COPY") {
@@ -435,6 +803,12 @@ void OctCalc::processButtonPress(const string &s) {
     display->setSelection(selectionStart, selectionEnd - selectionStart);
   }
   if (!showingResult && s != "SHOW") subdisplayString = "";
+  // The profile of explain() is a table, shown left aligned in the fixed font of the display
+  const bool table = subdisplayString.find('\n') != string::npos;
+  QFont labelFont = table ? display->font() : QFont();
+  labelFont.setPointSize(QFont().pointSize());
+  label->setFont(labelFont);
+  label->setAlignment(table ? Qt::AlignLeft : Qt::AlignRight);
   label->setText(subdisplayString.c_str());
 }
 
@@ -478,13 +852,22 @@ bool OctCalc::eventFilter(QObject *obj, QEvent *event) {
     case Qt::Key_PageDown: case Qt::Key_Down: processButtonPress("PageDown"); return true;
     }
     processButtonPress("");
+  } else if ((obj == historySearch.get() || obj == historyView.get()) && event->type() == QEvent::KeyPress) {
+    // Enter recalls the selected row, or the newest match from the search box.
+    // Other keys, including Home, are left to the panel.
+    QKeyEvent *keyEvent = static_cast<QKeyEvent *>(event);
+    if (keyEvent->key() == Qt::Key_Enter || keyEvent->key() == Qt::Key_Return) {
+      recallHistory(obj == historyView.get() ? historyView->currentIndex().row() : historyModel->rowCount() - 1);
+      return true;
+    }
   } else if (event->type() == QEvent::MouseButtonRelease) {
     Button *clickedButton = dynamic_cast<Button *>(obj);
 #ifdef DEBUG
     if (clickedButton) qDebug() << "MouseButtonRelease : " << clickedButton->text().toStdString().c_str();
 #endif
     if (clickedButton) processButtonPress(clickedButton->text().toStdString());
-  } else if (event->type() == QEvent::KeyPress) {
+  } else if (event->type() == QEvent::KeyPress && obj->isWidgetType() && static_cast<QWidget *>(obj)->window() == this) {
+    // Keys in the plot window are left to it
     QKeyEvent *keyEvent = static_cast<QKeyEvent *>(event);
     switch(keyEvent->key()) {
     case ' ': {
@@ -628,6 +1011,76 @@ int OctCalc::doTest() {
     QTest::keyClick(QApplication::focusWidget(), Qt::Key_Enter);
     qDebug() << "10: " << display->text();
     if (display->text().toStdString().substr(0, 10) != "1.10000000") throw(runtime_error("10: composite operation"));
+
+    QTest::keyClicks(display.get(), "solve(x*x-2, x, 1)");
+    QTest::keyClick(display.get(), Qt::Key_Enter);
+    qDebug() << "11: " << display->text();
+    if (display->text().toStdString().substr(0, 10) != "1.41421356") throw(runtime_error("11: solve"));
+
+    QTest::keyClicks(display.get(), "diff(exp(2*x), x, 0)");
+    QTest::keyClick(display.get(), Qt::Key_Enter);
+    qDebug() << "12: " << display->text();
+    if (display->text().toStdString() != "2") throw(runtime_error("12: diff"));
+
+    QTest::keyClicks(display.get(), "factor(360)");
+    QTest::keyClick(display.get(), Qt::Key_Enter);
+    qDebug() << "13: " << display->text();
+    if (display->text().toStdString() != "2^3 * 3^2 * 5") throw(runtime_error("13: factor"));
+
+    processButtonPress("INT");
+    QTest::keyClicks(display.get(), "factorial(40) / factorial(5)");
+    QTest::keyClick(display.get(), Qt::Key_Enter);
+    qDebug() << "14: " << display->text();
+    if (display->text().toStdString() != "6799294027065814452880093913300965785600000000") throw(runtime_error("14: exact integer"));
+    QTest::keyClicks(display.get(), "sqrt(2) * 1e50");
+    QTest::keyClick(display.get(), Qt::Key_Enter);
+    qDebug() << "14: " << display->text();
+    if (display->text().toStdString() != "141421356237309504880168872420969807856967187537694") throw(runtime_error("14: large inexact integer"));
+    QTest::keyClicks(display.get(), "1e300 + 1");
+    QTest::keyClick(display.get(), Qt::Key_Enter);
+    qDebug() << "14: " << display->text();
+    if (display->text().toStdString() != "1" + string(299, '0') + "1") throw(runtime_error("14: exact literal with an exponent"));
+    processButtonPress("INT");
+
+    QTest::keyClicks(display.get(), "dot(range(1, 3, 1), [4, 5, 6])");
+    QTest::keyClick(display.get(), Qt::Key_Enter);
+    qDebug() << "15: " << display->text();
+    if (display->text().toStdString() != "32") throw(runtime_error("15: arrays"));
+
+    QTest::keyClicks(display.get(), "12345 + 1");
+    QTest::keyClick(display.get(), Qt::Key_Enter);
+    QTest::keyClicks(historySearch.get(), "2345");
+    qDebug() << "16: " << historyModel->rowCount();
+    if (historyModel->rowCount() != 1) throw(runtime_error("16: history search"));
+    historyPrefix->setChecked(true);
+    if (historyModel->rowCount() != 0) throw(runtime_error("16: history prefix search"));
+    historySearch->setText("1234");
+    QTest::keyClick(historySearch.get(), Qt::Key_Enter);
+    qDebug() << "16: " << display->text();
+    if (display->text() != QString("12345 + 1")) throw(runtime_error("16: history recall"));
+    historySearch->clear();
+    historyPrefix->setChecked(false);
+    if (historyModel->rowCount() != int(history.size())) throw(runtime_error("16: history filter cleared"));
+
+    QTest::keyClicks(display.get(), "a = 2");
+    QTest::keyClick(display.get(), Qt::Key_Enter);
+    QTest::keyClicks(display.get(), "sin(a * x) / x");
+    QTest::mouseClick(plotButton.get(), Qt::LeftButton);
+    for(int i=0;i<10000 && !plotWindow->view->finished();i++) {
+      QCoreApplication::processEvents();
+      QThread::msleep(1);
+    }
+    qDebug() << "17: " << plotWindow->view->sampleCount() << plotWindow->status->text();
+    if (plotWindow->function->text() != QString("sin(a * x) / x") || !plotWindow->status->text().isEmpty() ||
+	!plotWindow->view->finished() || plotWindow->view->sampleCount() < 100) throw(runtime_error("17: plot"));
+    plotWindow->function->setText("sin(");
+    plotWindow->replot();
+    if (plotWindow->status->text().isEmpty()) throw(runtime_error("17: plot error"));
+    plotWindow->function->setText("x");
+    plotWindow->from->setText("20");
+    plotWindow->replot();
+    if (plotWindow->status->text() != QString("Invalid range")) throw(runtime_error("17: plot range"));
+    plotWindow->close();
   } catch(exception &ex) {
     qDebug() << ex.what();
     qDebug() << "Test failed";
@@ -639,6 +1092,94 @@ int OctCalc::doTest() {
 }
 #endif
 
+#ifdef BENCH
+#include <chrono>
+#include <algorithm>
+#include <QtTest/QTest>
+
+namespace {
+  // Latencies in microseconds, summarized by their median and 99th percentile
+  struct Latencies {
+    vector<double> samples;
+
+    double percentile(double p) const {
+      if (samples.empty()) return 0;
+      vector<double> v = samples;
+      sort(v.begin(), v.end());
+      size_t i = (size_t)ceil(p * v.size());
+      return v[i == 0 ? 0 : i - 1];
+    }
+
+    string toJSON() const {
+      char buf[256];
+      snprintf(buf, sizeof(buf), "{ \"count\": %zu, \"p50\": %.1f, \"p99\": %.1f }", samples.size(), percentile(0.5), percentile(0.99));
+      return buf;
+    }
+  };
+
+  // Runs f, and then the events it posted, which include the repaint of
+  // the display, the label and the relabeled buttons
+  template<typename F> double timeToRepaint(F f) {
+    auto t0 = chrono::steady_clock::now();
+    f();
+    QCoreApplication::sendPostedEvents();
+    QCoreApplication::processEvents();
+    return chrono::duration<double, micro>(chrono::steady_clock::now() - t0).count();
+  }
+}
+
+// Replays scripted sessions through the same event paths as doTest, and
+// prints the latencies as JSON. Each key press and button click is timed
+// until the widgets are repainted, and each Enter until the result is shown.
+// The result cache is off, so that each Enter includes the evaluation.
+int OctCalc::doBench(int rounds) {
+  static const char *keyScripts[] = {
+    "4*(4*atan(1/5) - atan(1/239))", "sqrt(2) * tgamma(1/3) + erf(0.5)", "solve(x*x-2, x, 1)",
+    "diff(exp(2*x), x, 0)", "factorial(40) / factorial(5)", "sum(range(1, 1000, 1) * 0.5)",
+  };
+  static const vector<vector<string>> buttonScripts = {
+    { "SHIFT", "asinh", "SHIFT", "ALT", "asinh", "ALT", "asinh", ".", "1", ")", ")", ")" },
+    { "HEX", "1", "<<", "7", "0", "HEX" },
+    { "M_PI", "*", "2", "BS", "3" },
+  };
+
+  Latencies key, button, enter;
+  for(int r=0;r<rounds;r++) {
+    for(auto script : keyScripts) {
+      for(const char *p = script;*p;p++) {
+	double t = timeToRepaint([&]{ QTest::keyClicks(display.get(), QString(QChar(*p))); });
+	if (r != 0) key.samples.push_back(t);
+      }
+      double t = timeToRepaint([&]{ QTest::keyClick(display.get(), Qt::Key_Enter); });
+      if (r != 0) enter.samples.push_back(t);
+      if (display->text().isEmpty()) {
+	fprintf(stderr, "No result for %s\n", script);
+	return -1;
+      }
+    }
+    for(auto &script : buttonScripts) {
+      for(auto &b : script) {
+	double t = timeToRepaint([&]{ QTest::mouseClick(buttons[b].get(), Qt::LeftButton); });
+	if (r != 0) button.samples.push_back(t);
+      }
+      double t = timeToRepaint([&]{ QTest::mouseClick(buttons["ENTER"].get(), Qt::LeftButton); });
+      if (r != 0) enter.samples.push_back(t);
+    }
+  }
+
+  // The first round warms up the caches and is not counted
+  printf("{\n");
+  printf("  \"platform\": \"%s\",\n", QGuiApplication::platformName().toStdString().c_str());
+  printf("  \"rounds\": %d,\n", rounds - 1);
+  printf("  \"displayWidth\": %d,\n", displayWidth);
+  printf("  \"key_to_repaint_us\": %s,\n", key.toJSON().c_str());
+  printf("  \"button_to_repaint_us\": %s,\n", button.toJSON().c_str());
+  printf("  \"enter_to_result_us\": %s\n", enter.toJSON().c_str());
+  printf("}\n");
+  return 0;
+}
+#endif
+
 //
 
 int main_(int argc, char **argv) {
@@ -648,9 +1189,12 @@ int main_(int argc, char **argv) {
   OctCalc calc(nullptr, &app);
   app.installEventFilter(&calc);
   calc.show();
-#if !defined(TEST)
-  return app.exec();
-#else
+#if defined(TEST)
   return calc.doTest();
+#elif defined(BENCH)
+  // Qt options such as -platform have been removed from argv by QApplication
+  return calc.doBench(argc >= 2 ? max(2, atoi(argv[1])) : 51);
+#else
+  return app.exec();
 #endif
 }
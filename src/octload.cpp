@@ -0,0 +1,114 @@
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <algorithm>
+#include <stdexcept>
+
+#include "server.hpp"
+
+using namespace std;
+using namespace octcore;
+
+// Load generator for octcli --serve. Each connection keeps up to the
+// pipeline depth of requests in flight, and the latency of a request is
+// measured from its send to the arrival of its response.
+
+namespace {
+  typedef chrono::steady_clock Clock;
+
+  void showUsage(const char *argv0) {
+    fprintf(stderr, "Usage : %s [-c <connections>] [-n <requests per connection>] [-p <pipeline depth>] [-e <expression>] <socket path or port>\n", argv0);
+  }
+
+  // Latencies of the requests of one connection in nanoseconds
+  void runConnection(const string &addr, const string &expr, int nReq, int depth, vector<double> &lat, string &err) {
+    try {
+      Connection c(addr);
+      vector<Clock::time_point> sent(nReq);
+      string line, esc;
+      for(char ch : expr) {
+	if (ch == '"' || ch == '\\') esc += '\\';
+	esc += ch;
+      }
+      auto request = [&](int id) {
+	sent[id] = Clock::now();
+	c.send("{\"id\":" + to_string(id) + ",\"expr\":\"" + esc + "\"}\n");
+      };
+
+      int next = 0;
+      for(;next < nReq && next < depth;next++) request(next);
+      for(int i=0;i<nReq;i++) {
+	if (!c.readLine(line)) throw(runtime_error("Connection closed by the server"));
+	lat[i] = (double)chrono::duration_cast<chrono::nanoseconds>(Clock::now() - sent[i]).count();
+	if (line.find("\"error\"") != string::npos && err.empty()) err = line;
+	if (next < nReq) request(next++);
+      }
+    } catch(exception &ex) {
+      err = ex.what();
+    }
+  }
+
+  double percentile(const vector<double> &v, double p) {
+    if (v.empty()) return 0;
+    size_t i = min(v.size() - 1, (size_t)(p / 100 * v.size()));
+    return v[i];
+  }
+}
+
+int main(int argc, char **argv) {
+  int nConn = 1, nReq = 10000, depth = 1;
+  string expr = "sqrt(2) * M_PI", addr;
+
+  for(int i=1;i<argc;i++) {
+    string a = argv[i];
+    if (a == "-c" && i+1 < argc) {
+      nConn = atoi(argv[++i]);
+    } else if (a == "-n" && i+1 < argc) {
+      nReq = atoi(argv[++i]);
+    } else if (a == "-p" && i+1 < argc) {
+      depth = atoi(argv[++i]);
+    } else if (a == "-e" && i+1 < argc) {
+      expr = argv[++i];
+    } else if (a.size() > 1 && a[0] == '-') {
+      showUsage(argv[0]);
+      return -1;
+    } else {
+      addr = a;
+    }
+  }
+  if (addr.empty() || nConn < 1 || nReq < 1 || depth < 1) {
+    showUsage(argv[0]);
+    return -1;
+  }
+
+  vector<vector<double>> lat(nConn, vector<double>(nReq));
+  vector<string> err(nConn);
+  vector<thread> threads;
+
+  auto t0 = Clock::now();
+  for(int i=0;i<nConn;i++) threads.emplace_back([&, i]() { runConnection(addr, expr, nReq, depth, lat[i], err[i]); });
+  for(auto &t : threads) t.join();
+  double elapsed = chrono::duration<double>(Clock::now() - t0).count();
+
+  for(auto &e : err) {
+    if (!e.empty()) {
+      fprintf(stderr, "%s\n", e.c_str());
+      return 1;
+    }
+  }
+
+  vector<double> all;
+  for(auto &l : lat) all.insert(all.end(), l.begin(), l.end());
+  sort(all.begin(), all.end());
+
+  printf("connections %d, pipeline depth %d, requests %zu\n", nConn, depth, all.size());
+  printf("throughput : %.0f requests/s\n", all.size() / elapsed);
+  printf("latency (us) : p50 %.1f, p90 %.1f, p99 %.1f, p99.9 %.1f, max %.1f\n",
+	 percentile(all, 50) / 1000, percentile(all, 90) / 1000, percentile(all, 99) / 1000,
+	 percentile(all, 99.9) / 1000, all.back() / 1000);
+
+  return 0;
+}
@@ -0,0 +1,117 @@
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <algorithm>
+
+#include <tlfloat/tlfloat.h>
+
+#include "rng.hpp"
+#include "matrix.hpp"
+
+using namespace std;
+
+// Scaling benchmark of the matrix kernels. A random n x n system is solved
+// by LU factorization, and two random matrices are multiplied, with 1, 2,
+// 4, ... threads up to the given maximum. The results have to be the same
+// bits for all thread counts.
+
+namespace {
+  typedef chrono::steady_clock Clock;
+
+  void showUsage(const char *argv0) {
+    fprintf(stderr, "Usage : %s [-n <size>] [-t <max threads>] [-s <seed>]\n", argv0);
+  }
+
+  vector<tlfloat_octuple> randomMatrix(Xoshiro256 &rng, size_t n, size_t m) {
+    vector<tlfloat_octuple> v(n * m);
+    for(auto &x : v) x = tlfloat_octuple(double(int64_t(rng.next64())) * 0x1p-63);
+    return v;
+  }
+
+  template<typename F> double seconds(F f) {
+    auto t0 = Clock::now();
+    f();
+    return chrono::duration<double>(Clock::now() - t0).count();
+  }
+}
+
+int main(int argc, char **argv) {
+  size_t n = 500, maxThreads = max(1U, thread::hardware_concurrency());
+  uint64_t seed = 1;
+
+  for(int i=1;i<argc;i++) {
+    string a = argv[i];
+    if (a == "-n" && i+1 < argc) {
+      n = strtoull(argv[++i], nullptr, 10);
+    } else if (a == "-t" && i+1 < argc) {
+      maxThreads = strtoull(argv[++i], nullptr, 10);
+    } else if (a == "-s" && i+1 < argc) {
+      seed = strtoull(argv[++i], nullptr, 10);
+    } else {
+      showUsage(argv[0]);
+      return -1;
+    }
+  }
+  if (n < 1 || maxThreads < 1) {
+    showUsage(argv[0]);
+    return -1;
+  }
+
+  Xoshiro256 rng(seed);
+  const vector<tlfloat_octuple> a = randomMatrix(rng, n, n), b = randomMatrix(rng, n, 1), c = randomMatrix(rng, n, n);
+
+  vector<size_t> counts;
+  for(size_t t=1;t<maxThreads;t*=2) counts.push_back(t);
+  counts.push_back(maxThreads);
+
+  // Multiply-adds, in millions
+  const double luOps = (double(n) * n * n / 3 + double(n) * n) * 1e-6, mulOps = double(n) * n * n * 1e-6;
+
+  printf("%zu x %zu, octuple precision\n", n, n);
+  printf("threads       solve (s)  Mmadd/s  speedup      matmul (s)  Mmadd/s  speedup\n");
+  vector<tlfloat_octuple> x0, p0;
+  double solve1 = 0, mul1 = 0;
+  for(size_t t : counts) {
+    vector<tlfloat_octuple> f = a, x = b, p(n * n);
+    vector<size_t> perm;
+    int sign;
+    bool regular = true;
+    const double ts = seconds([&]() {
+      regular = matrix::lu(f.data(), n, perm, sign, t);
+      matrix::luSolve(f.data(), perm, x.data(), n, 1, t);
+    });
+    const double tm = seconds([&]() { matrix::multiply(a.data(), c.data(), p.data(), n, n, n, t); });
+    if (!regular) {
+      fprintf(stderr, "The matrix is singular\n");
+      return 1;
+    }
+    if (x0.empty()) {
+      x0 = x;
+      p0 = p;
+      solve1 = ts;
+      mul1 = tm;
+    } else if (x != x0 || p != p0) {
+      fprintf(stderr, "The results with %zu threads differ from those with 1 thread\n", t);
+      return 1;
+    }
+    printf("%7zu  %14.3f %8.2f %8.2f  %14.3f %8.2f %8.2f\n", t, ts, luOps / ts, solve1 / ts, tm, mulOps / tm, mul1 / tm);
+  }
+
+  // Residual of the solution, relative to the norms of the matrix and the solution
+  tlfloat_octuple r = 0, na = 0, nx = 0;
+  for(size_t i=0;i<n;i++) {
+    tlfloat_octuple s = -b[i];
+    for(size_t j=0;j<n;j++) {
+      s += a[i * n + j] * x0[j];
+      na = tlfloat_fmaxo(na, tlfloat_fabso(a[i * n + j]));
+    }
+    r = tlfloat_fmaxo(r, tlfloat_fabso(s));
+    nx = tlfloat_fmaxo(nx, tlfloat_fabso(x0[i]));
+  }
+  printf("relative residual of the solution : %.3g\n", (double)(r / (na * nx * n)));
+
+  return 0;
+}
@@ -0,0 +1,42 @@
+#include <cstddef>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+
+using namespace std;
+
+// The fork-join loop shared by the parallel parts of the library. Items are
+// handed out in increasing order from a shared counter, so that a thread
+// taking an item knows that all the items before it have been taken.
+namespace parallel {
+  // nthreads, or the hardware concurrency if it is 0
+  inline size_t threadCount(size_t nthreads) { return nthreads != 0 ? nthreads : max(1U, thread::hardware_concurrency()); }
+
+  // The threads that run n items when nthreads are asked for
+  inline size_t threadsFor(size_t n, size_t nthreads) { return max<size_t>(1, min(n, threadCount(nthreads))); }
+
+  // Calls f(state, i) for i in [0, n) on threadsFor(n, nthreads) threads,
+  // the calling thread being one of them. Each thread passes a State of its
+  // own, constructed on the thread. No more items are handed out once
+  // *stop is set.
+  template<class State, class F> void parallelFor(size_t n, size_t nthreads, F f, const atomic<bool> *stop = nullptr) {
+    atomic<size_t> next(0);
+    auto worker = [&]() {
+      State s;
+      for(size_t i;!(stop && *stop) && (i = next++) < n;) f(s, i);
+    };
+    const size_t nt = threadsFor(n, nthreads);
+    vector<thread> threads;
+    for(size_t i=1;i<nt;i++) threads.emplace_back(worker);
+    worker();
+    for(auto &t : threads) t.join();
+  }
+
+  struct NoState {};
+
+  // Calls f(i) for i in [0, n) as above
+  template<class F> void parallelFor(size_t n, size_t nthreads, F f, const atomic<bool> *stop = nullptr) {
+    parallelFor<NoState>(n, nthreads, [&](NoState &, size_t i) { f(i); }, stop);
+  }
+}
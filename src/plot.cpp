@@ -0,0 +1,204 @@
+#include <cmath>
+#include <map>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+
+#include "octcore.hpp"
+#include "plot.hpp"
+#include "parallel.hpp"
+
+using namespace octcore;
+
+namespace {
+  // Points evaluated between two locks of the samples
+  const size_t chunkSize = 8;
+
+  // Samples kept beyond which those far from the view are dropped
+  const size_t maxSamples = 1 << 20;
+
+  // Intervals of the coarse grid per view, and pixels per interval below which refinement stops
+  const double coarseIntervals = 64, sparsePixels = 4;
+
+  // The largest power of 2 not exceeding x
+  double dyadicFloor(double x) { return exp2(floor(log2(x))); }
+}
+
+struct Sampler::State {
+  Error error;
+
+  mutable mutex mtx;
+  condition_variable cv;	// Signalled on a new view, a finished job and stop
+  map<double, double> points;
+  View view {};
+  uint64_t gen = 0;		// Incremented by setView
+  bool finished = false, stop = false;
+  atomic<size_t> evaluations { 0 };
+
+  // A pass of the sampling of one view
+  struct Job {
+    uint64_t gen;
+    vector<double> xs;
+    atomic<size_t> next { 0 };
+    size_t done = 0;		// Guarded by mtx
+    Job(uint64_t g, vector<double> &&v) : gen(g), xs(move(v)) {}
+  };
+  shared_ptr<Job> job;
+
+  thread planner;
+  vector<thread> workers;
+
+  bool jobPending() const { return job && job->gen == gen && job->done < job->xs.size(); }
+  vector<double> plan();
+  void plannerLoop();
+  void workerLoop(const string &expr, const string &param, const vector<pair<string, tlfloat_octuple>> &vars);
+};
+
+// The points to evaluate next for the view: the missing points of the
+// coarse grid, then the midpoints of the intervals to refine. Called with
+// mtx held.
+vector<double> Sampler::State::plan() {
+  const View v = view;
+  vector<double> xs;
+  const double span = v.x1 - v.x0;
+  if (!(span > 0) || !isfinite(span) || v.width <= 0) return xs;
+  const double pixel = span / v.width, hCoarse = dyadicFloor(span / coarseIntervals), hMin = dyadicFloor(pixel);
+
+  if (points.size() > maxSamples) {
+    points.erase(points.begin(), points.lower_bound(v.x0 - span));
+    points.erase(points.upper_bound(v.x1 + span), points.end());
+  }
+
+  // The grid has at most span / hCoarse + 3 points, and stops early where
+  // the multiples of hCoarse are no longer apart in doubles
+  const double k0 = floor(v.x0 / hCoarse);
+  double last = -INFINITY;
+  for(int i=0;i<int(2 * coarseIntervals) + 3;i++) {
+    const double x = (k0 + i) * hCoarse;
+    if (!(x > last) || x > v.x1 + hCoarse) break;
+    if (points.count(x) == 0) xs.push_back(x);
+    last = x;
+  }
+  if (!xs.empty()) return xs;
+
+  vector<Point> p;
+  for(auto it = points.lower_bound(v.x0 - hCoarse);it != points.end() && it->first <= v.x1 + hCoarse;++it) {
+    p.push_back(Point { it->first, it->second });
+  }
+  if (p.size() < 2) return xs;
+
+  // split[i] is set if the interval from p[i] to p[i+1] is to be halved
+  vector<char> split(p.size() - 1, 0);
+  for(size_t i=0;i+1<p.size();i++) {
+    if (p[i+1].x - p[i].x > sparsePixels * pixel || isfinite(p[i].y) != isfinite(p[i+1].y)) split[i] = 1;
+  }
+  const double scale = v.y1 > v.y0 ? v.height / (v.y1 - v.y0) : 0;
+  for(size_t i=1;i+1<p.size();i++) {
+    const Point &a = p[i-1], &b = p[i], &c = p[i+1];
+    if (!isfinite(a.y) || !isfinite(b.y) || !isfinite(c.y)) continue;
+    // Distance in pixels from b to the chord from a to c
+    const double chord = a.y + (c.y - a.y) * (b.x - a.x) / (c.x - a.x);
+    if (fabs(b.y - chord) * scale > 0.5) split[i-1] = split[i] = 1;
+  }
+  for(size_t i=0;i+1<p.size();i++) {
+    // The midpoint is one of the ends once the interval is down to an ulp
+    const double m = (p[i].x + p[i+1].x) / 2;
+    if (split[i] && p[i+1].x - p[i].x > hMin && m != p[i].x && m != p[i+1].x) xs.push_back(m);
+  }
+  return xs;
+}
+
+// Plans a pass once the previous one is done, until a pass plans nothing
+void Sampler::State::plannerLoop() {
+  unique_lock<mutex> lock(mtx);
+  for(;;) {
+    cv.wait(lock, [&]() { return stop || (gen != 0 && !finished && !jobPending()); });
+    if (stop) return;
+    vector<double> xs = plan();
+    if (xs.empty()) {
+      finished = true;
+      continue;
+    }
+    job = make_shared<Job>(gen, move(xs));
+    cv.notify_all();
+  }
+}
+
+void Sampler::State::workerLoop(const string &expr, const string &param, const vector<pair<string, tlfloat_octuple>> &vars) {
+  OctCore c;
+  for(auto &v : vars) c.setVar(v.first, v.second);
+  Compiled f;
+  c.compile(expr, param, f);
+
+  Point buf[chunkSize];
+  unique_lock<mutex> lock(mtx);
+  for(;;) {
+    cv.wait(lock, [&]() { return stop || (job && job->next < job->xs.size()); });
+    if (stop) return;
+    shared_ptr<Job> j = job;
+    lock.unlock();
+
+    const size_t i0 = j->next.fetch_add(chunkSize), i1 = min(i0 + chunkSize, j->xs.size());
+    size_t n = 0;
+    for(size_t i=i0;i<i1;i++,n++) {
+      buf[n] = Point { j->xs[i], (double)c.evaluateAt(f, j->xs[i]) };
+    }
+
+    lock.lock();
+    for(size_t i=0;i<n;i++) points[buf[i].x] = buf[i].y;
+    evaluations += n;
+    j->done += n;
+    if (n != 0 && j->done == j->xs.size()) cv.notify_all();
+  }
+}
+
+Sampler::Sampler(const string &expr, const string &param, const vector<pair<string, tlfloat_octuple>> &vars, int nThreads) :
+  s(make_unique<State>()) {
+  {
+    OctCore c;
+    for(auto &v : vars) c.setVar(v.first, v.second);
+    Compiled f;
+    s->error = c.compile(expr, param, f);
+  }
+  if (s->error) return;
+
+  if (nThreads <= 0) nThreads = int(parallel::threadCount(0));
+  s->planner = thread([this]() { s->plannerLoop(); });
+  for(int i=0;i<nThreads;i++) s->workers.emplace_back([this, expr, param, vars]() { s->workerLoop(expr, param, vars); });
+}
+
+Sampler::~Sampler() {
+  {
+    lock_guard<mutex> lock(s->mtx);
+    s->stop = true;
+  }
+  s->cv.notify_all();
+  if (s->planner.joinable()) s->planner.join();
+  for(auto &t : s->workers) t.join();
+}
+
+const Error &Sampler::error() const { return s->error; }
+
+void Sampler::setView(const View &v) {
+  {
+    lock_guard<mutex> lock(s->mtx);
+    s->view = v;
+    s->gen++;
+    s->finished = false;
+    if (s->job) s->job->next = s->job->xs.size();
+  }
+  s->cv.notify_all();
+}
+
+bool Sampler::samples(double x0, double x1, vector<Point> &out) const {
+  out.clear();
+  lock_guard<mutex> lock(s->mtx);
+  for(auto it = s->points.lower_bound(x0);it != s->points.end() && it->first <= x1;++it) {
+    out.push_back(Point { it->first, it->second });
+  }
+  return s->finished || s->error;
+}
+
+size_t Sampler::evaluations() const { return s->evaluations; }
@@ -0,0 +1,55 @@
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include <utility>
+
+#include <tlfloat/tlfloat.h>
+
+using namespace std;
+
+namespace octcore {
+  struct Error;
+
+  // Samples a function of one variable for plotting. The points are
+  // evaluated by worker threads, each with its own context and its own
+  // compiled copy of the expression. A view is first sampled on a coarse
+  // grid, which is then refined in passes where the curve bends by more
+  // than half a pixel, or leaves its domain, down to intervals of a pixel.
+  // The grids are dyadic, so that the points of different views coincide,
+  // and the samples are kept across views, so that panning and zooming
+  // only evaluate the points that were not sampled yet.
+  class Sampler {
+  public:
+    struct View {
+      double x0, x1, y0, y1;
+      int width, height;	// In pixels
+    };
+    struct Point { double x, y; };
+
+    // The variables are copied to the contexts of the workers. Threads are
+    // started only if the expression compiles.
+    Sampler(const string &expr, const string &param, const vector<pair<string, tlfloat_octuple>> &vars, int nThreads = 0);
+    ~Sampler();
+    Sampler(const Sampler &) = delete;
+    Sampler &operator=(const Sampler &) = delete;
+
+    // The compile error, if any
+    const Error &error() const;
+
+    // Starts sampling the view, dropping the points planned for the previous one
+    void setView(const View &v);
+
+    // Replaces out with the samples in [x0, x1] in ascending order of x,
+    // which are NaN outside the domain. Returns true once the current view
+    // is fully refined.
+    bool samples(double x0, double x1, vector<Point> &out) const;
+
+    // The number of points evaluated so far
+    size_t evaluations() const;
+
+  private:
+    struct State;
+    unique_ptr<State> s;
+  };
+}
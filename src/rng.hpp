@@ -1,10 +1,16 @@
 #include <chrono>
+#include <cstdint>
+#include <cstring>
 
 using namespace std;
 
 class RNG {
   uint64_t res0 = 0, res1 = 0;
   uint32_t nBitsInRes = 0;
+protected:
+  // Drops the bits left over from the last next64(), so that the output
+  // after reseeding or jumping depends only on the new state
+  void discardBits() { res0 = res1 = 0; nBitsInRes = 0; }
 public:
   virtual uint64_t next64() = 0;
   virtual uint32_t next32() { return (uint32_t)next(32); }
@@ -25,10 +31,15 @@ public:
     return ret;
   }
 
+  // Each 64-bit output is stored in little-endian order
   void nextBytes(unsigned char *dst, size_t len) {
     while(len >= 8) {
       uint64_t u = next64();
+#if (defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__) || defined(_MSC_VER)
+      memcpy(dst, &u, 8);
+#else
       for(int i=0;i<8;i++) dst[i] = (u >> (i * 8)) & 0xff;
+#endif
       dst += 8;
       len -= 8;
     }
@@ -96,3 +107,69 @@ public:
     return u | (uint64_t(next32()) << 32);
   }
 };
+
+// xoshiro256** by Blackman and Vigna. The period is 2^256-1, and jump() and
+// longJump() advance the state by 2^128 and 2^192 steps, which gives
+// non-overlapping streams for parallel use.
+class Xoshiro256 : public RNG {
+  uint64_t s[4];
+
+  static uint64_t rotl(uint64_t x, int k) { return (x << k) | (x >> (64 - k)); }
+
+  static uint64_t splitmix64(uint64_t &x) {
+    uint64_t z = (x += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+  }
+
+  void jump(const uint64_t (&poly)[4]) {
+    uint64_t t[4] = { 0, 0, 0, 0 };
+    for(int i=0;i<4;i++) {
+      for(int b=0;b<64;b++) {
+	if (poly[i] & (uint64_t(1) << b)) for(int j=0;j<4;j++) t[j] ^= s[j];
+	next64();
+      }
+    }
+    for(int j=0;j<4;j++) s[j] = t[j];
+    discardBits();
+  }
+
+public:
+  // Seeded from the clock and the address of the object, which is not reproducible
+  Xoshiro256() {
+    seed(uint64_t(chrono::high_resolution_clock::now().time_since_epoch().count()), uint64_t(uintptr_t(this)));
+  }
+
+  explicit Xoshiro256(uint64_t lo, uint64_t hi = 0) { seed(lo, hi); }
+
+  // Different 128-bit seeds give different states
+  void seed(uint64_t lo, uint64_t hi = 0) {
+    s[0] = splitmix64(lo);
+    s[1] = splitmix64(lo);
+    s[2] = splitmix64(hi);
+    s[3] = splitmix64(hi);
+    discardBits();
+  }
+
+  uint64_t next64() {
+    const uint64_t r = rotl(s[1] * 5, 7) * 9, t = s[1] << 17;
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = rotl(s[3], 45);
+    return r;
+  }
+
+  void jump() {
+    static const uint64_t poly[4] = { 0x180ec6d33cfd0abaULL, 0xd5a61266f0c9392cULL, 0xa9582618e03fc9aaULL, 0x39abdc4529b1661cULL };
+    jump(poly);
+  }
+
+  void longJump() {
+    static const uint64_t poly[4] = { 0x76e15d3efefdcbbfULL, 0xc5004e441c522fb3ULL, 0x77710069854ee241ULL, 0x39109bb02acbe635ULL };
+    jump(poly);
+  }
+};
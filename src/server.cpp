@@ -0,0 +1,539 @@
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <cerrno>
+#include <stdexcept>
+
+#if !defined(_WIN32)
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#endif
+
+#include "octcore.hpp"
+#include "server.hpp"
+#include "numutil.hpp"
+#include "parallel.hpp"
+
+using namespace octcore;
+using namespace numutil;
+
+// Reading and writing the flat JSON objects of the protocol
+namespace {
+  void skipSpace(string_view s, size_t &i) {
+    while(i < s.size() && (s[i] == ' ' || s[i] == '\t' || s[i] == '\r' || s[i] == '\n')) i++;
+  }
+
+  int hexValue(char c) {
+    if ('0' <= c && c <= '9') return c - '0';
+    if ('a' <= c && c <= 'f') return c - 'a' + 10;
+    if ('A' <= c && c <= 'F') return c - 'A' + 10;
+    return -1;
+  }
+
+  bool parseHex4(string_view s, size_t i, uint32_t &u) {
+    if (i + 4 > s.size()) return false;
+    u = 0;
+    for(size_t j=i;j<i+4;j++) {
+      int h = hexValue(s[j]);
+      if (h < 0) return false;
+      u = u * 16 + h;
+    }
+    return true;
+  }
+
+  void appendUtf8(string &o, uint32_t c) {
+    if (c < 0x80) {
+      o += char(c);
+    } else if (c < 0x800) {
+      o += char(0xc0 | (c >> 6));
+      o += char(0x80 | (c & 0x3f));
+    } else if (c < 0x10000) {
+      o += char(0xe0 | (c >> 12));
+      o += char(0x80 | ((c >> 6) & 0x3f));
+      o += char(0x80 | (c & 0x3f));
+    } else {
+      o += char(0xf0 | (c >> 18));
+      o += char(0x80 | ((c >> 12) & 0x3f));
+      o += char(0x80 | ((c >> 6) & 0x3f));
+      o += char(0x80 | (c & 0x3f));
+    }
+  }
+
+  // s[i] is the opening quote. On success, i is past the closing quote.
+  bool parseString(string_view s, size_t &i, string &out) {
+    out.clear();
+    for(i++;i < s.size();i++) {
+      char c = s[i];
+      if (c == '"') { i++; return true; }
+      if ((unsigned char)c < 0x20) return false;
+      if (c != '\\') { out += c; continue; }
+      if (++i >= s.size()) return false;
+      switch(s[i]) {
+      case '"': out += '"'; break;
+      case '\\': out += '\\'; break;
+      case '/': out += '/'; break;
+      case 'b': out += '\b'; break;
+      case 'f': out += '\f'; break;
+      case 'n': out += '\n'; break;
+      case 'r': out += '\r'; break;
+      case 't': out += '\t'; break;
+      case 'u': {
+	uint32_t u, l;
+	if (!parseHex4(s, i+1, u)) return false;
+	i += 4;
+	if (0xd800 <= u && u < 0xdc00 && i + 2 < s.size() && s[i+1] == '\\' && s[i+2] == 'u' &&
+	    parseHex4(s, i+3, l) && 0xdc00 <= l && l < 0xe000) {
+	  u = 0x10000 + ((u - 0xd800) << 10) + (l - 0xdc00);
+	  i += 6;
+	}
+	appendUtf8(out, u);
+	break;
+      }
+      default: return false;
+      }
+    }
+    return false;
+  }
+
+  // A number, true, false or null
+  bool parseLiteral(string_view s, size_t &i) {
+    for(const char *w : { "true", "false", "null" }) {
+      if (s.substr(i, strlen(w)) == w) { i += strlen(w); return i == s.size() || !isalnum((unsigned char)s[i]); }
+    }
+    auto digits = [&]() { const size_t b = i; while(i < s.size() && isdigit_(s[i])) i++; return i > b; };
+    if (i < s.size() && s[i] == '-') i++;
+    if (i < s.size() && s[i] == '0') i++;
+    else if (!digits()) return false;
+    if (i < s.size() && s[i] == '.' && (++i, !digits())) return false;
+    if (i < s.size() && (s[i] == 'e' || s[i] == 'E')) {
+      i++;
+      if (i < s.size() && (s[i] == '+' || s[i] == '-')) i++;
+      if (!digits()) return false;
+    }
+    return i == s.size() || !isalnum((unsigned char)s[i]);
+  }
+
+  // Reads an object whose values are strings or literals. id is the JSON
+  // text of "id", so that it can be echoed back whatever its type.
+  bool parseRequest(string_view s, string &id, string &expr, bool &hasExpr, bool &hex) {
+    size_t i = 0;
+    skipSpace(s, i);
+    if (i >= s.size() || s[i] != '{') return false;
+    i++;
+    skipSpace(s, i);
+    if (i < s.size() && s[i] == '}') return true;
+    string key, str;
+    for(;;) {
+      skipSpace(s, i);
+      if (i >= s.size() || s[i] != '"' || !parseString(s, i, key)) return false;
+      skipSpace(s, i);
+      if (i >= s.size() || s[i] != ':') return false;
+      i++;
+      skipSpace(s, i);
+      const size_t b = i;
+      bool isString = i < s.size() && s[i] == '"';
+      if (isString ? !parseString(s, i, str) : !parseLiteral(s, i)) return false;
+      string_view raw = s.substr(b, i - b);
+
+      if (key == "id") id = string(raw);
+      if (key == "expr" && isString) { expr = str; hasExpr = true; }
+      if (key == "hex") hex = raw == "true";
+
+      skipSpace(s, i);
+      if (i < s.size() && s[i] == ',') { i++; continue; }
+      if (i < s.size() && s[i] == '}') break;
+      return false;
+    }
+    i++;
+    skipSpace(s, i);
+    return i == s.size();
+  }
+
+  string jsonString(string_view s) {
+    string o = "\"";
+    for(char c : s) {
+      switch(c) {
+      case '"': o += "\\\""; break;
+      case '\\': o += "\\\\"; break;
+      case '\n': o += "\\n"; break;
+      case '\r': o += "\\r"; break;
+      case '\t': o += "\\t"; break;
+      default:
+	if ((unsigned char)c < 0x20) {
+	  char buf[8];
+	  snprintf(buf, sizeof(buf), "\\u%04x", c);
+	  o += buf;
+	} else {
+	  o += c;
+	}
+      }
+    }
+    return o + "\"";
+  }
+
+  bool isBlank(string_view s) {
+    for(char c : s) if (!isspace((unsigned char)c)) return false;
+    return true;
+  }
+}
+
+string Server::respond(OctCore &core, string_view line) {
+  string id = "null", expr;
+  bool hasExpr = false, hex = false;
+  if (!parseRequest(line, id, expr, hasExpr, hex) || !hasExpr) return "{\"id\":null,\"error\":\"Malformed request\"}\n";
+
+  Result r = core.evaluate(expr);
+  const string &l = r.label;
+  string out = "{\"id\":" + id;
+  if (!r.ok()) return out + ",\"error\":" + jsonString(r.error.message()) + ",\"column\":" + to_string(r.error.column) + "}\n";
+
+  char buf[256];
+  tlfloat_snprintf(buf, sizeof(buf), hex ? "%Oa" : "%.70Og", r.value);
+  string value = buf;
+  BigInt b;
+
+  if (l.substr(0, 5) == "LVAL:") {
+    out += ",\"result\":\"LVAL\",\"var\":" + jsonString(string_view(l).substr(5));
+  } else if (l.substr(0, 5) == "TEXT:") {
+    out += ",\"result\":\"TEXT\",\"text\":" + jsonString(string_view(l).substr(5));
+  } else if (l.substr(0, 4) == "INT:" && BigInt::parse(string_view(l).substr(4), b)) {
+    out += ",\"result\":\"INT\"";
+    value = b.toString(hex ? 16 : 10);
+  } else {
+    out += ",\"result\":\"RVAL\"";
+  }
+  if (!r.profile.empty()) out += ",\"profile\":" + jsonString(r.profile);
+  return out + ",\"value\":" + jsonString(value) + "}\n";
+}
+
+#if !defined(_WIN32)
+struct Server::Session {
+  int fd;
+  OctCore core;
+  string inbuf, outbuf;
+  deque<string> requests;
+  bool scheduled = false, eof = false;
+  bool gone = false;	// The connection failed, and responses are dropped
+  explicit Session(int fd_) : fd(fd_) { core.setCacheBudget(1 << 20); }
+};
+
+namespace {
+  bool isPort(const string &addr) {
+    if (addr.empty() || addr.size() > 5) return false;
+    for(char c : addr) if (!('0' <= c && c <= '9')) return false;
+    return true;
+  }
+
+  // A socket of the address family of addr. sa is filled with the address.
+  int openSocket(const string &addr, sockaddr_storage &sa, socklen_t &len) {
+    memset(&sa, 0, sizeof(sa));
+    if (isPort(addr)) {
+      sockaddr_in &in = (sockaddr_in &)sa;
+      in.sin_family = AF_INET;
+      in.sin_port = htons((uint16_t)stoi(addr));
+      in.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+      len = sizeof(in);
+      return socket(AF_INET, SOCK_STREAM, 0);
+    }
+    sockaddr_un &un = (sockaddr_un &)sa;
+    if (addr.size() >= sizeof(un.sun_path)) throw(runtime_error("Socket path too long : " + addr));
+    un.sun_family = AF_UNIX;
+    memcpy(un.sun_path, addr.c_str(), addr.size() + 1);
+    len = sizeof(un);
+    return socket(AF_UNIX, SOCK_STREAM, 0);
+  }
+
+  // Blocking, for the client side only
+  bool sendAll(int fd, string_view s) {
+    while(!s.empty()) {
+      ssize_t n = ::send(fd, s.data(), s.size(), 0);
+      if (n < 0 && errno == EINTR) continue;
+      if (n <= 0) return false;
+      s.remove_prefix(n);
+    }
+    return true;
+  }
+}
+
+Server::Server(const string &addr, int nThreads) {
+  signal(SIGPIPE, SIG_IGN);
+
+  sockaddr_storage sa;
+  socklen_t len;
+  listenFd = openSocket(addr, sa, len);
+  if (listenFd < 0) throw(runtime_error("Cannot create a socket : " + string(strerror(errno))));
+
+  if (sa.ss_family == AF_UNIX) {
+    // A socket left behind by a server that did not exit cleanly is replaced
+    struct stat st;
+    if (stat(addr.c_str(), &st) == 0 && S_ISSOCK(st.st_mode)) unlink(addr.c_str());
+  } else {
+    int one = 1;
+    setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+  }
+
+  if (::bind(listenFd, (sockaddr *)&sa, len) != 0 || listen(listenFd, 128) != 0) {
+    string msg = "Cannot listen on " + addr + " : " + strerror(errno);
+    close(listenFd);
+    throw(runtime_error(msg));
+  }
+  if (sa.ss_family == AF_UNIX) unixPath = addr;
+
+  if (pipe(wakeFd) != 0) {
+    close(listenFd);
+    throw(runtime_error("Cannot create a pipe : " + string(strerror(errno))));
+  }
+  fcntl(wakeFd[0], F_SETFL, O_NONBLOCK);
+  fcntl(wakeFd[1], F_SETFL, O_NONBLOCK);
+
+  if (nThreads <= 0) nThreads = int(parallel::threadCount(0));
+  for(int i=0;i<nThreads;i++) workers.emplace_back([this]() { worker(); });
+}
+
+Server::~Server() {
+  stop();
+  for(auto &t : workers) t.join();
+  for(auto &s : ready) closeSession(*s);
+  close(listenFd);
+  close(wakeFd[0]);
+  close(wakeFd[1]);
+  if (!unixPath.empty()) unlink(unixPath.c_str());
+}
+
+void Server::stop() {
+  {
+    lock_guard<mutex> lk(mtx);
+    stopping = true;
+  }
+  cv.notify_all();
+  wake();
+}
+
+void Server::wake() {
+  char c = 0;
+  if (write(wakeFd[1], &c, 1) < 0) {}	// A full pipe already wakes the poll
+}
+
+// Called with mtx held
+void Server::closeSession(Session &s) {
+  if (s.fd >= 0) close(s.fd);
+  s.fd = -1;
+}
+
+// Sends as much of the queued responses as the socket takes without
+// blocking. A connection that fails is dropped with its queued requests.
+// Called with mtx held.
+void Server::flush(Session &s) {
+  while(!s.outbuf.empty() && s.fd >= 0) {
+    const ssize_t n = ::send(s.fd, s.outbuf.data(), s.outbuf.size(), 0);
+    if (n < 0 && errno == EINTR) continue;
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return;
+    if (n <= 0) {
+      s.outbuf.clear();
+      s.requests.clear();
+      s.eof = s.gone = true;
+      break;
+    }
+    s.outbuf.erase(0, size_t(n));
+  }
+  if (s.eof && !s.scheduled && s.outbuf.empty()) closeSession(s);
+}
+
+// A session is given to one worker at a time, which keeps the requests of a
+// connection in order. After each batch it goes to the back of the queue,
+// so that a busy connection does not hold a worker while others wait. The
+// responses are sent as far as the socket takes them, and the rest is left
+// to the I/O thread.
+void Server::worker() {
+  unique_lock<mutex> lk(mtx);
+  for(;;) {
+    cv.wait(lk, [this]() { return stopping || !ready.empty(); });
+    if (stopping) return;
+    shared_ptr<Session> s = ready.front();
+    ready.pop_front();
+
+    deque<string> batch;
+    batch.swap(s->requests);
+    const bool wasFull = batch.size() >= maxQueued;
+    lk.unlock();
+
+    if (wasFull) wake();
+    string out;
+    for(auto &r : batch) if (!isBlank(r)) out += respond(s->core, r);
+
+    lk.lock();
+    if (!s->gone) s->outbuf += out;
+    flush(*s);
+    if (!s->outbuf.empty()) wake();	// To be polled for POLLOUT
+    if (!s->requests.empty() && !stopping) {
+      ready.push_back(s);
+      cv.notify_one();
+    } else {
+      s->scheduled = false;
+      if ((s->eof && s->outbuf.empty()) || stopping) closeSession(*s);
+    }
+  }
+}
+
+void Server::run() {
+  vector<shared_ptr<Session>> sessions;	// Connections still being read
+  vector<pollfd> pfds;
+  vector<char> rbuf(1 << 16);
+
+  for(;;) {
+    pfds.clear();
+    pfds.push_back(pollfd { listenFd, POLLIN, 0 });
+    pfds.push_back(pollfd { wakeFd[0], POLLIN, 0 });
+    {
+      lock_guard<mutex> lk(mtx);
+      if (stopping) break;
+      for(auto &s : sessions) {
+	const bool readable = !s->eof && s->requests.size() < maxQueued && s->outbuf.size() < maxPending;
+	pfds.push_back(pollfd { s->fd, short((readable ? POLLIN : 0) | (s->outbuf.empty() ? 0 : POLLOUT)), 0 });
+      }
+    }
+
+    if (poll(pfds.data(), pfds.size(), -1) < 0) {
+      if (errno == EINTR) continue;
+      throw(runtime_error("poll failed : " + string(strerror(errno))));
+    }
+
+    if (pfds[1].revents & POLLIN) {
+      char c[64];
+      while(read(wakeFd[0], c, sizeof(c)) > 0) ;
+    }
+
+    // The sockets are non-blocking, so the lock is held over their calls,
+    // which keeps a worker from closing one meanwhile
+    for(size_t i=2;i<pfds.size();i++) {
+      const short ev = pfds[i].revents;
+      if (ev == 0) continue;
+      Session &s = *sessions[i-2];
+      lock_guard<mutex> lk(mtx);
+      if (s.fd < 0) continue;
+      if (ev & POLLOUT) flush(s);
+      if (s.eof) {
+	// Only responses are left, which cannot be sent once the connection is gone
+	if (ev & (POLLHUP | POLLERR)) {
+	  s.outbuf.clear();
+	  s.requests.clear();
+	  s.gone = true;
+	  if (!s.scheduled) closeSession(s);
+	}
+	continue;
+      }
+      if (!(ev & (POLLIN | POLLHUP | POLLERR))) continue;
+      ssize_t n = recv(s.fd, rbuf.data(), rbuf.size(), 0);
+      if (n < 0 && (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK)) continue;
+
+      if (n > 0) {
+	s.inbuf.append(rbuf.data(), n);
+	size_t b = 0;
+	for(size_t e;(e = s.inbuf.find('\n', b)) != string::npos;b = e + 1) s.requests.push_back(s.inbuf.substr(b, e - b));
+	s.inbuf.erase(0, b);
+	if (s.inbuf.size() > maxLine) { s.inbuf.clear(); s.eof = true; }	// Dropped with the connection
+      } else {
+	if (!s.inbuf.empty()) s.requests.push_back(s.inbuf);
+	s.inbuf.clear();
+	s.eof = true;
+      }
+      if (!s.requests.empty() && !s.scheduled) {
+	s.scheduled = true;
+	ready.push_back(sessions[i-2]);
+	cv.notify_one();
+      }
+      if (s.eof && !s.scheduled && s.outbuf.empty()) closeSession(s);
+    }
+
+    // Sessions are polled until they are read to the end and their responses are sent
+    {
+      lock_guard<mutex> lk(mtx);
+      size_t j = 0;
+      for(size_t i=0;i<sessions.size();i++) {
+	const Session &s = *sessions[i];
+	if (s.fd >= 0 && !s.gone && (!s.eof || s.scheduled || !s.outbuf.empty())) sessions[j++] = sessions[i];
+      }
+      sessions.resize(j);
+    }
+
+    if (pfds[0].revents & POLLIN) {
+      int fd = accept(listenFd, nullptr, nullptr);
+      if (fd >= 0) {
+	fcntl(fd, F_SETFL, O_NONBLOCK);
+	int one = 1;
+	setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));	// Fails harmlessly on Unix sockets
+	sessions.push_back(make_shared<Session>(fd));
+      }
+    }
+  }
+
+  lock_guard<mutex> lk(mtx);
+  for(auto &s : sessions) {
+    s->eof = true;
+    if (!s->scheduled) closeSession(*s);
+  }
+}
+
+Connection::Connection(const string &addr) {
+  sockaddr_storage sa;
+  socklen_t len;
+  fd = openSocket(addr, sa, len);
+  if (fd < 0 || connect(fd, (sockaddr *)&sa, len) != 0) {
+    string msg = "Cannot connect to " + addr + " : " + strerror(errno);
+    if (fd >= 0) close(fd);
+    throw(runtime_error(msg));
+  }
+  int one = 1;
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+  signal(SIGPIPE, SIG_IGN);
+}
+
+Connection::~Connection() { close(fd); }
+
+void Connection::send(string_view s) {
+  if (!sendAll(fd, s)) throw(runtime_error("send failed : " + string(strerror(errno))));
+}
+
+bool Connection::readLine(string &line) {
+  for(;;) {
+    size_t e = buf.find('\n', pos);
+    if (e != string::npos) {
+      line = buf.substr(pos, e - pos);
+      pos = e + 1;
+      if (pos == buf.size()) { buf.clear(); pos = 0; }
+      return true;
+    }
+    buf.erase(0, pos);
+    pos = 0;
+    char tmp[1 << 16];
+    ssize_t n = recv(fd, tmp, sizeof(tmp), 0);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) return false;
+    buf.append(tmp, n);
+  }
+}
+#else
+struct Server::Session {};
+
+Server::Server(const string &, int) { throw(runtime_error("The server mode is not supported on Windows")); }
+Server::~Server() {}
+void Server::run() {}
+void Server::stop() {}
+void Server::wake() {}
+void Server::worker() {}
+void Server::flush(Session &) {}
+void Server::closeSession(Session &) {}
+
+Connection::Connection(const string &) { throw(runtime_error("Connections are not supported on Windows")); }
+Connection::~Connection() {}
+void Connection::send(string_view) {}
+bool Connection::readLine(string &) { return false; }
+#endif
@@ -0,0 +1,83 @@
+#include <string>
+#include <string_view>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+using namespace std;
+
+namespace octcore {
+  // Serves OctCore evaluation over a Unix domain socket, or over a TCP port
+  // on localhost if the address is a number. The protocol is one JSON object
+  // per line in each direction:
+  //
+  //   {"id": 1, "expr": "x = sqrt(2)", "hex": false}
+  //   {"id":1,"result":"LVAL","var":"x","value":"1.4142..."}
+  //
+  // "id" is echoed back verbatim, "result" is RVAL, LVAL, TEXT or INT, and
+  // failures are reported as {"id":1,"error":"...","column":3}, with column
+  // 0 if the error has no position. Each connection has its own OctCore, so
+  // variables are private to a connection. Requests can be pipelined. They
+  // are evaluated in order on a thread pool shared by all connections, and
+  // the responses come back in the same order. Responses are queued on the
+  // connection and sent by the I/O thread as the client takes them, so that
+  // a client that does not read holds no worker.
+  class Server {
+    struct Session;
+
+    string unixPath;
+    int listenFd = -1, wakeFd[2] = { -1, -1 };
+    vector<thread> workers;
+
+    mutex mtx;
+    condition_variable cv;
+    deque<shared_ptr<Session>> ready;	// Sessions with requests and no worker
+    bool stopping = false;
+
+    void worker();
+    void wake();
+    void flush(Session &s);
+    void closeSession(Session &s);
+
+  public:
+    // Requests queued on a connection, and bytes of responses not taken by
+    // its client, before it stops being read
+    static const size_t maxQueued = 4096, maxPending = 1 << 22;
+    // Longest request line
+    static const size_t maxLine = 1 << 20;
+
+    // Starts listening. nThreads is the size of the pool, or the hardware
+    // concurrency if 0.
+    explicit Server(const string &addr, int nThreads = 0);
+    ~Server();
+    Server(const Server &) = delete;
+    Server &operator=(const Server &) = delete;
+
+    // Accepts connections and reads requests until stop() is called
+    void run();
+    // Can be called from any thread
+    void stop();
+
+    // Evaluates one request line and returns the response line
+    static string respond(class OctCore &core, string_view line);
+  };
+
+  // Client side of the protocol, used by octload and the tests
+  class Connection {
+    int fd = -1;
+    string buf;
+    size_t pos = 0;
+  public:
+    explicit Connection(const string &addr);
+    ~Connection();
+    Connection(const Connection &) = delete;
+    Connection &operator=(const Connection &) = delete;
+
+    void send(string_view s);
+    // Reads one line without the line end, returning false at the end of the stream
+    bool readLine(string &line);
+  };
+}
@@ -0,0 +1,217 @@
+#include <cstring>
+#include <cctype>
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <algorithm>
+
+#include "mappedfile.hpp"
+#include "stats.hpp"
+#include "numutil.hpp"
+#include "parallel.hpp"
+
+using namespace octcore;
+using namespace numutil;
+
+namespace {
+  // Powers of 10 that are exact in binary256, whose 237-bit significand holds 5^101
+  const int maxExactPow10 = 101;
+
+  const vector<tlfloat_octuple> &pow10() {
+    static const vector<tlfloat_octuple> p = [] {
+      vector<tlfloat_octuple> v(maxExactPow10 + 1);
+      v[0] = 1;
+      for(int i=1;i<=maxExactPow10;i++) v[i] = v[i-1] * 10;
+      return v;
+    }();
+    return p;
+  }
+
+  bool slowParse(string_view s, tlfloat_octuple &x) {
+    char buf[256];
+    if (s.empty() || s.size() >= sizeof(buf)) return false;
+    memcpy(buf, s.data(), s.size());
+    buf[s.size()] = '\0';
+    const char *end;
+    x = tlfloat_strtoo(buf, &end);
+    return end == buf + s.size() && x == x;
+  }
+
+  bool isSeparator(char c) { return c == ' ' || c == '\t' || c == ',' || c == ';'; }
+
+  // The field of the line with the index, without the quotes around it
+  bool field(string_view line, size_t column, string_view &f) {
+    const size_t n = line.size();
+    size_t i = 0;
+    for(size_t k=0;;k++) {
+      while(i < n && (line[i] == ' ' || line[i] == '\t')) i++;
+      size_t b = i, e;
+      if (i < n && line[i] == '"') {
+	b = i + 1;
+	e = min(n, line.find('"', b));
+	i = min(n, e + 1);
+      } else {
+	while(i < n && !isSeparator(line[i])) i++;
+	e = i;
+      }
+      if (k == column) { f = line.substr(b, e - b); return true; }
+      while(i < n && (line[i] == ' ' || line[i] == '\t')) i++;
+      if (i >= n) return false;
+      if (line[i] == ',' || line[i] == ';') i++;
+    }
+  }
+
+  // Sums the powers of the deviations from the first number, which are
+  // turned into central moments at the end of the chunk. The sums that
+  // the mean comes from are compensated, and the others are plain, as
+  // their rounding errors are far below those of the decimal input.
+  ColumnStats summarize(string_view text, size_t column) {
+    ColumnStats st;
+    CompensatedSum sum, s1;
+    tlfloat_octuple shift = 0, s2 = 0, s3 = 0, s4 = 0;
+    string_view line, f;
+    tlfloat_octuple x;
+    for(size_t pos = 0;pos < text.size();) {
+      const char *nl = (const char *)memchr(text.data() + pos, '\n', text.size() - pos);
+      const size_t e = nl ? size_t(nl - text.data()) : text.size();
+      line = text.substr(pos, e - pos);
+      pos = e + 1;
+
+      size_t i = 0;
+      while(i < line.size() && isspace((unsigned char)line[i])) i++;
+      if (i == line.size() || line[i] == '#') continue;
+      if (line.back() == '\r') line.remove_suffix(1);
+
+      if (!field(line, column, f) || !parseNumber(f, x)) { st.skipped++; continue; }
+      if (st.n == 0) shift = x;
+      const tlfloat_octuple d = x - shift, d2 = d * d;
+      sum.add(x);
+      s1.add(d);
+      s2 += d2;
+      s3 += d2 * d;
+      s4 += d2 * d2;
+      st.min = tlfloat_fmino(st.min, x);
+      st.max = tlfloat_fmaxo(st.max, x);
+      st.n++;
+    }
+    if (st.n == 0) return st;
+
+    const tlfloat_octuple n = fromU64(st.n), a = s1.value(), m = a / n;
+    st.sum = sum.value();
+    st.mean = shift + m;
+    st.m2 = s2 - m * a;
+    st.m3 = s3 - 3 * m * s2 + 2 * n * m * m * m;
+    st.m4 = s4 - 4 * m * s3 + 6 * m * m * s2 - 3 * n * m * m * m * m;
+    return st;
+  }
+}
+
+// Pébay's pairwise update of the central moments
+void ColumnStats::merge(const ColumnStats &o) {
+  skipped += o.skipped;
+  if (o.n == 0) return;
+  if (n == 0) {
+    const uint64_t s = skipped;
+    *this = o;
+    skipped = s;
+    return;
+  }
+  const tlfloat_octuple na = fromU64(n), nb = fromU64(o.n), d = o.mean - mean, dn = d / (na + nb);
+  m4 += o.m4 + d * dn * dn * dn * na * nb * (na * na - na * nb + nb * nb) + 6 * dn * dn * (na * na * o.m2 + nb * nb * m2) +
+    4 * dn * (na * o.m3 - nb * m3);
+  m3 += o.m3 + d * dn * dn * na * nb * (na - nb) + 3 * dn * (na * o.m2 - nb * m2);
+  m2 += o.m2 + d * dn * na * nb;
+  mean += dn * nb;
+  sum += o.sum;
+  min = tlfloat_fmino(min, o.min);
+  max = tlfloat_fmaxo(max, o.max);
+  n += o.n;
+}
+
+tlfloat_octuple ColumnStats::variance() const { return n > 1 ? m2 / fromU64(n - 1) : tlfloat_octuple(NAN); }
+
+tlfloat_octuple ColumnStats::skewness() const { return tlfloat_sqrto(fromU64(n)) * m3 / (m2 * tlfloat_sqrto(m2)); }
+
+tlfloat_octuple ColumnStats::kurtosis() const { return fromU64(n) * m4 / (m2 * m2) - 3; }
+
+bool octcore::parseNumber(string_view s, tlfloat_octuple &x) {
+  size_t i = 0;
+  const bool neg = i < s.size() && s[i] == '-';
+  if (i < s.size() && (s[i] == '-' || s[i] == '+')) i++;
+
+  uint64_t mant = 0;
+  int digits = 0, exp10 = 0;
+  bool any = false;
+  for(;i < s.size() && isdigit_(s[i]);i++, any = true) {
+    if (mant == 0 && s[i] == '0') continue;
+    if (++digits > 19) return slowParse(s, x);
+    mant = mant * 10 + (s[i] - '0');
+  }
+  if (i < s.size() && s[i] == '.') {
+    for(i++;i < s.size() && isdigit_(s[i]);i++, any = true) {
+      if (mant == 0 && s[i] == '0') { exp10--; continue; }
+      if (++digits > 19) return slowParse(s, x);
+      mant = mant * 10 + (s[i] - '0');
+      exp10--;
+    }
+  }
+  if (!any) return slowParse(s, x);
+  if (i < s.size() && (s[i] == 'e' || s[i] == 'E')) {
+    i++;
+    const bool eneg = i < s.size() && s[i] == '-';
+    if (i < s.size() && (s[i] == '-' || s[i] == '+')) i++;
+    int e = 0;
+    const size_t i0 = i;
+    for(;i < s.size() && isdigit_(s[i]);i++) {
+      if (i - i0 >= 4) return slowParse(s, x);
+      e = e * 10 + (s[i] - '0');
+    }
+    if (i == i0) return false;
+    exp10 += eneg ? -e : e;
+  }
+  if (i != s.size()) return slowParse(s, x);
+
+  if (mant == 0) {
+    x = neg ? -tlfloat_octuple(0) : tlfloat_octuple(0);
+    return true;
+  }
+  if (exp10 < -maxExactPow10 || exp10 > maxExactPow10) return slowParse(s, x);
+  const tlfloat_octuple m = fromU64(mant);
+  x = exp10 >= 0 ? m * pow10()[exp10] : m / pow10()[-exp10];
+  if (neg) x = -x;
+  return true;
+}
+
+ColumnStats octcore::columnStats(MappedFile &file, size_t column, unsigned nThreads, size_t chunkBytes) {
+  const string_view text = file.view();
+  const size_t nChunks = max<size_t>(1, (text.size() + chunkBytes - 1) / chunkBytes);
+
+  // Chunk c starts with the first line that starts at or after c * chunkBytes
+  auto start = [&](size_t c) {
+    if (c == 0) return size_t(0);
+    if (c >= nChunks) return text.size();
+    const size_t e = text.find('\n', c * chunkBytes - 1);
+    return e == string_view::npos ? text.size() : e + 1;
+  };
+
+  // The chunks summarized ahead of the first one not merged yet
+  mutex mtx;
+  map<size_t, ColumnStats> pending;
+  size_t merged = 0;
+  ColumnStats total;
+
+  parallel::parallelFor(nChunks, nThreads, [&](size_t c) {
+    const size_t b = start(c), e = start(c + 1);
+    ColumnStats s = summarize(text.substr(b, e - b), column);
+    lock_guard<mutex> lock(mtx);
+    pending.emplace(c, s);
+    while(!pending.empty() && pending.begin()->first == merged) {
+      total.merge(pending.begin()->second);
+      pending.erase(pending.begin());
+      merged++;
+      file.discard(start(merged));
+    }
+  });
+  return total;
+}
@@ -0,0 +1,44 @@
+#include <cstdint>
+#include <cmath>
+#include <string_view>
+
+#include <tlfloat/tlfloat.h>
+
+using namespace std;
+
+namespace octcore {
+  class MappedFile;
+
+  // Summary of a column of numbers, with the sums of the powers of the
+  // deviations from the mean up to the fourth
+  struct ColumnStats {
+    uint64_t n = 0;		// Numbers summarized
+    uint64_t skipped = 0;	// Lines without a number in the column, such as a header
+    tlfloat_octuple sum = 0, mean = 0, m2 = 0, m3 = 0, m4 = 0;
+    tlfloat_octuple min = INFINITY, max = -INFINITY;
+
+    // Combines the summary of another part of the data into this one
+    void merge(const ColumnStats &o);
+
+    tlfloat_octuple variance() const;	// Sample variance, with n - 1
+    tlfloat_octuple skewness() const;
+    tlfloat_octuple kurtosis() const;	// Excess kurtosis
+  };
+
+  // Parses a whole field as a number. Decimals with up to 19 significant
+  // digits and small exponents are converted with one rounding from exact
+  // operands, and the others by tlfloat_strtoo, so that all are correctly
+  // rounded. NaN is not taken as a number.
+  bool parseNumber(string_view s, tlfloat_octuple &x);
+
+  // Summarizes a column, from 0, of a text file in one pass. Fields are
+  // separated by commas, semicolons or runs of white space, and may be
+  // quoted. Blank lines and lines starting with # are ignored. The file is
+  // split at line ends into chunks of about chunkBytes, which are
+  // summarized on up to nThreads threads, or the hardware concurrency if 0,
+  // with compensated sums, and merged in order, so that the result does
+  // not depend on the number of threads. The pages of the merged chunks are
+  // given back to the OS, so that the memory used does not grow with the
+  // file size.
+  ColumnStats columnStats(MappedFile &file, size_t column, unsigned nThreads = 0, size_t chunkBytes = 1 << 24);
+}
@@ -0,0 +1,188 @@
+#include <cstring>
+#include <cmath>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <algorithm>
+
+#include "octcore.hpp"
+#include "tabulate.hpp"
+#include "parallel.hpp"
+
+using namespace octcore;
+
+namespace {
+  static_assert(sizeof(TableHeader) == 64, "TableHeader must be 64 bytes");
+  static_assert(sizeof(tlfloat_octuple) == 32, "tlfloat_octuple must be 256 bits wide");
+
+  // Rows per chunk, and chunks in flight per thread
+  const size_t chunkRows = 4096, chunksPerThread = 2;
+
+  const char magic[8] = { 'O', 'C', 'T', 'T', 'A', 'B', 'L', 'E' };
+
+  bool littleEndian() {
+    const uint32_t u = 1;
+    unsigned char c;
+    memcpy(&c, &u, 1);
+    return c == 1;
+  }
+
+  void putLE(unsigned char *p, uint64_t u, int bytes) {
+    for(int i=0;i<bytes;i++) p[i] = (u >> (8 * i)) & 0xff;
+  }
+
+  uint64_t getLE(const unsigned char *p, int bytes) {
+    uint64_t u = 0;
+    for(int i=0;i<bytes;i++) u |= uint64_t(p[i]) << (8 * i);
+    return u;
+  }
+
+  // The raw bits, least significant word first as in octcore_octuple, each word little-endian
+  void appendValue(string &s, tlfloat_octuple x) {
+    uint64_t w[4];
+    memcpy(w, &x, sizeof(w));
+    unsigned char b[32];
+    for(int i=0;i<4;i++) putLE(b + 8 * i, w[i], 8);
+    s.append((const char *)b, sizeof(b));
+  }
+
+  void appendText(string &s, tlfloat_octuple x, bool hex) {
+    char buf[128];
+    tlfloat_snprintf(buf, sizeof(buf), hex ? "%Oa" : "%.70Og", x);
+    s += buf;
+  }
+
+  // The expression as a quoted CSV field
+  string quote(const string &s) {
+    string q = "\"";
+    for(char c : s) { if (c == '"') q += '"'; q += c; }
+    return q + "\"";
+  }
+}
+
+const tlfloat_octuple *octcore::tableValues(string_view file, uint64_t &rows, uint32_t &columns) {
+  if (file.size() < sizeof(TableHeader) || memcmp(file.data(), magic, sizeof(magic)) != 0 || !littleEndian()) return nullptr;
+  const unsigned char *h = (const unsigned char *)file.data();
+  if (getLE(h + 8, 4) != 1 || getLE(h + 12, 4) != sizeof(TableHeader) || getLE(h + 16, 4) != sizeof(tlfloat_octuple)) return nullptr;
+  columns = uint32_t(getLE(h + 20, 4));
+  rows = getLE(h + 24, 8);
+  if (columns == 0 || rows > (file.size() - sizeof(TableHeader)) / sizeof(tlfloat_octuple) / columns) return nullptr;
+  const char *values = file.data() + sizeof(TableHeader);
+  if ((uintptr_t)values % alignof(tlfloat_octuple) != 0) return nullptr;
+  return (const tlfloat_octuple *)values;
+}
+
+Tabulator::Tabulator(const string &e, const string &p, const vector<pair<string, tlfloat_octuple>> &v) :
+  expr(e), param(p), vars(v), err(make_unique<Error>()) {
+  OctCore c;
+  for(auto &x : vars) c.setVar(x.first, x.second);
+  Compiled f;
+  *err = c.compile(expr, param, f);
+}
+
+Tabulator::~Tabulator() {}
+
+const Error &Tabulator::error() const { return *err; }
+
+bool Tabulator::write(FILE *fp, Format format, size_t n, const function<tlfloat_octuple(size_t)> &point) {
+  if (*err) return false;
+
+  string head;
+  if (format == BINARY) {
+    unsigned char h[sizeof(TableHeader)] = { 0 };
+    memcpy(h, magic, sizeof(magic));
+    putLE(h + 8, 1, 4);
+    putLE(h + 12, sizeof(TableHeader), 4);
+    putLE(h + 16, sizeof(tlfloat_octuple), 4);
+    putLE(h + 20, 2, 4);
+    putLE(h + 24, n, 8);
+    head.assign((const char *)h, sizeof(h));
+  } else {
+    head = quote(param) + "," + quote(expr) + "\n";
+  }
+  if (fwrite(head.data(), 1, head.size(), fp) != head.size()) return false;
+
+  const size_t nChunks = (n + chunkRows - 1) / chunkRows;
+  const size_t nThreads = parallel::threadsFor(nChunks, threads);
+  const size_t window = nThreads * chunksPerThread;
+
+  // Chunk k is formatted into bufs[k % window] once the chunks before
+  // k - window + 1 are written
+  vector<string> bufs(window);
+  vector<char> ready(window, 0);
+  mutex mtx;
+  condition_variable cv;
+  size_t written = 0;
+  atomic<bool> failed(false);
+
+  // The context of a formatting thread, set up for its first chunk
+  struct Evaluator {
+    OctCore c;
+    Compiled f;
+    bool ready = false;
+  };
+
+  // The chunks are formatted on nThreads threads started for them, while
+  // this one writes them in order
+  thread formatter([&]() {
+    parallel::parallelFor<Evaluator>(nChunks, nThreads, [&](Evaluator &w, size_t k) {
+      if (!w.ready) {
+	for(auto &x : vars) w.c.setVar(x.first, x.second);
+	w.c.compile(expr, param, w.f);
+	w.ready = true;
+      }
+      {
+	unique_lock<mutex> lock(mtx);
+	cv.wait(lock, [&]() { return failed || k < written + window; });
+	if (failed) return;
+      }
+      string &b = bufs[k % window];
+      b.clear();
+      for(size_t i=k*chunkRows;i<min(n, (k + 1) * chunkRows);i++) {
+	const tlfloat_octuple x = point(i);
+	const tlfloat_octuple y = w.c.evaluateAt(w.f, x);
+	if (format == BINARY) {
+	  appendValue(b, x);
+	  appendValue(b, y);
+	} else {
+	  appendText(b, x, format == CSV_HEX);
+	  b += ',';
+	  appendText(b, y, format == CSV_HEX);
+	  b += '\n';
+	}
+      }
+      {
+	lock_guard<mutex> lock(mtx);
+	ready[k % window] = 1;
+      }
+      cv.notify_all();
+    }, &failed);
+  });
+
+  for(size_t k=0;k<nChunks;k++) {
+    {
+      unique_lock<mutex> lock(mtx);
+      cv.wait(lock, [&]() { return ready[k % window] != 0; });
+    }
+    // The workers leave the buffer alone until it is marked as written
+    const string &b = bufs[k % window];
+    const bool ok = fwrite(b.data(), 1, b.size(), fp) == b.size();
+    {
+      lock_guard<mutex> lock(mtx);
+      ready[k % window] = 0;
+      written++;
+      if (!ok) failed = true;
+    }
+    cv.notify_all();
+    if (!ok) break;
+  }
+  formatter.join();
+  return !failed && fflush(fp) == 0;
+}
+
+bool Tabulator::writeRange(FILE *fp, Format format, tlfloat_octuple x0, tlfloat_octuple x1, size_t n) {
+  auto fromSize = [](size_t i) { return tlfloat_octuple(tlfloat_uint128_t(uint64_t(i))); };
+  const tlfloat_octuple step = n > 1 ? (x1 - x0) / fromSize(n - 1) : tlfloat_octuple(0);
+  return write(fp, format, n, [&](size_t i) { return i + 1 == n && n > 1 ? x1 : x0 + step * fromSize(i); });
+}
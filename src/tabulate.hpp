@@ -0,0 +1,68 @@
+#include <cstdio>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <utility>
+#include <functional>
+
+#include <tlfloat/tlfloat.h>
+
+using namespace std;
+
+namespace octcore {
+  struct Error;
+
+  // Binary tables start with this header, in little-endian byte order. It
+  // is followed by the rows, each with the columns as 32-byte little-endian
+  // IEEE 754 binary256 values. The values start at offset 64, so that those
+  // of a mapped file can be used in place.
+  struct TableHeader {
+    char magic[8];		// "OCTTABLE"
+    uint32_t version;		// 1
+    uint32_t headerSize;	// 64
+    uint32_t valueSize;		// 32
+    uint32_t columns;		// 2 : x, f(x)
+    uint64_t rows;
+    uint8_t reserved[32];	// 0
+  };
+
+  // The values of a binary table in the bytes of the file, in row order, or
+  // null if the bytes are not a table of this version that can be read in
+  // place on this host.
+  const tlfloat_octuple *tableValues(string_view file, uint64_t &rows, uint32_t &columns);
+
+  // Writes a table of an expression of one variable at many points. The
+  // rows are computed in chunks by worker threads, each with its own context
+  // and compiled copy of the expression, and written in order from a bounded
+  // window of chunks. Values that cannot be evaluated are NaN.
+  class Tabulator {
+    string expr, param;
+    vector<pair<string, tlfloat_octuple>> vars;
+    unique_ptr<Error> err;
+    unsigned threads = 0;
+
+  public:
+    enum Format { CSV, CSV_HEX, BINARY };
+
+    // The variables are copied to the contexts of the workers
+    Tabulator(const string &expr, const string &param, const vector<pair<string, tlfloat_octuple>> &vars = {});
+    ~Tabulator();
+    Tabulator(const Tabulator &) = delete;
+    Tabulator &operator=(const Tabulator &) = delete;
+
+    // The compile error, if any
+    const Error &error() const;
+
+    // 0 for all cores
+    void setThreads(unsigned n) { threads = n; }
+
+    // Writes the rows for the n points given by point(i), which is called
+    // from the workers. Returns false on a compile or write error.
+    bool write(FILE *fp, Format format, size_t n, const function<tlfloat_octuple(size_t)> &point);
+
+    // n evenly spaced points from x0 to x1 inclusive
+    bool writeRange(FILE *fp, Format format, tlfloat_octuple x0, tlfloat_octuple x1, size_t n);
+  };
+}